@@ -93,7 +93,34 @@ bool set_env_variable(std::string name, std::string value)
 
 #endif
 
-std::recursive_mutex global_mutex;
+Tracked_Mutex global_mutex("global_mutex");
+
+#ifndef EMU_RELEASE_BUILD
+//mutexes held by the current thread in the order they were taken, once per recursive lock
+static thread_local std::vector<Tracked_Mutex *> held_mutexes;
+
+void Tracked_Mutex::check_lock_order()
+{
+    if (std::find(held_mutexes.begin(), held_mutexes.end(), this) != held_mutexes.end()) return;
+
+    for (auto m : held_mutexes) {
+        if (m->level > level) {
+            PRINT_DEBUG("LOCK ORDER VIOLATION: taking %s (level %u) while holding %s (level %u)\n", name, level, m->name, m->level);
+        }
+    }
+}
+
+void Tracked_Mutex::push_held()
+{
+    held_mutexes.push_back(this);
+}
+
+void Tracked_Mutex::pop_held()
+{
+    auto m = std::find(held_mutexes.rbegin(), held_mutexes.rend(), this);
+    if (m != held_mutexes.rend()) held_mutexes.erase(std::next(m).base());
+}
+#endif
 
 SteamAPICall_t generate_steam_api_call_id() {
     static SteamAPICall_t a;
@@ -302,6 +329,122 @@ unsigned int file_size_(std::string full_path)
     return buffer.st_size;
 }
 
+// Received and allocated SteamNetworkingMessage_t objects are recycled instead of
+// going through new/malloc for every message. Payloads are rounded up to a power of
+// two size class and prefixed with a small header holding that class so the free
+// function knows which list to return them to. Release() can be called from any
+// thread so the pool has its own lock instead of relying on global_mutex.
+#define STEAM_MESSAGE_POOL_MIN_SHIFT 8
+#define STEAM_MESSAGE_POOL_CLASSES 10
+#define STEAM_MESSAGE_POOL_UNPOOLED 0xFFFFFFFF
+#define STEAM_MESSAGE_POOL_MAX_MESSAGES 1024
+#define STEAM_MESSAGE_POOL_MAX_BYTES (4u * 1024 * 1024)
+#define STEAM_MESSAGE_POOL_HEADER 16
+
+struct Steam_Message_Pool {
+    std::mutex mutex;
+    std::vector<SteamNetworkingMessage_t *> messages;
+    std::vector<char *> buffers[STEAM_MESSAGE_POOL_CLASSES];
+};
+
+static Steam_Message_Pool *get_steam_message_pool()
+{
+    //never freed so that messages released late during process exit still have a pool to go back to
+    static Steam_Message_Pool *pool = new Steam_Message_Pool();
+    return pool;
+}
+
+static uint32 steam_message_size_class(uint32 size)
+{
+    uint32 size_class = 0;
+    while (size_class < STEAM_MESSAGE_POOL_CLASSES && (1u << (size_class + STEAM_MESSAGE_POOL_MIN_SHIFT)) < size) {
+        ++size_class;
+    }
+
+    if (size_class == STEAM_MESSAGE_POOL_CLASSES) return STEAM_MESSAGE_POOL_UNPOOLED;
+    return size_class;
+}
+
+static void free_pooled_message_data(SteamNetworkingMessage_t *pMsg)
+{
+    if (!pMsg->m_pData) return;
+    char *block = (char *)pMsg->m_pData - STEAM_MESSAGE_POOL_HEADER;
+    pMsg->m_pData = NULL;
+
+    uint32 size_class;
+    memcpy(&size_class, block, sizeof(size_class));
+    if (size_class != STEAM_MESSAGE_POOL_UNPOOLED) {
+        Steam_Message_Pool *pool = get_steam_message_pool();
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        std::vector<char *> &buffers = pool->buffers[size_class];
+        if (buffers.size() < (STEAM_MESSAGE_POOL_MAX_BYTES >> (size_class + STEAM_MESSAGE_POOL_MIN_SHIFT))) {
+            buffers.push_back(block);
+            return;
+        }
+    }
+
+    free(block);
+}
+
+static void release_pooled_message(SteamNetworkingMessage_t *pMsg)
+{
+    if (pMsg->m_pfnFreeData) pMsg->m_pfnFreeData(pMsg);
+
+    Steam_Message_Pool *pool = get_steam_message_pool();
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (pool->messages.size() < STEAM_MESSAGE_POOL_MAX_MESSAGES) {
+            pool->messages.push_back(pMsg);
+            return;
+        }
+    }
+
+    delete pMsg;
+}
+
+SteamNetworkingMessage_t *allocate_steam_message(int data_size)
+{
+    if (data_size < 0) data_size = 0;
+
+    uint32 size_class = data_size ? steam_message_size_class(data_size) : STEAM_MESSAGE_POOL_UNPOOLED;
+    SteamNetworkingMessage_t *pMsg = NULL;
+    char *block = NULL;
+
+    Steam_Message_Pool *pool = get_steam_message_pool();
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (!pool->messages.empty()) {
+            pMsg = pool->messages.back();
+            pool->messages.pop_back();
+        }
+
+        if (size_class != STEAM_MESSAGE_POOL_UNPOOLED && !pool->buffers[size_class].empty()) {
+            block = pool->buffers[size_class].back();
+            pool->buffers[size_class].pop_back();
+        }
+    }
+
+    if (pMsg) {
+        *pMsg = SteamNetworkingMessage_t();
+    } else {
+        pMsg = new SteamNetworkingMessage_t();
+    }
+
+    pMsg->m_pfnRelease = &release_pooled_message;
+    if (!data_size) return pMsg;
+
+    if (!block) {
+        size_t block_size = size_class == STEAM_MESSAGE_POOL_UNPOOLED ? data_size : (1u << (size_class + STEAM_MESSAGE_POOL_MIN_SHIFT));
+        block = (char *)malloc(STEAM_MESSAGE_POOL_HEADER + block_size);
+        memcpy(block, &size_class, sizeof(size_class));
+    }
+
+    pMsg->m_pData = block + STEAM_MESSAGE_POOL_HEADER;
+    pMsg->m_cbSize = data_size;
+    pMsg->m_pfnFreeData = &free_pooled_message_data;
+    return pMsg;
+}
+
 static void steam_auth_ticket_callback(void *object, Common_Message *msg)
 {
     PRINT_DEBUG("steam_auth_ticket_callback\n");
@@ -22,7 +22,66 @@
 
 #define PUSH_BACK_IF_NOT_IN(vector, element) { if(std::find(vector.begin(), vector.end(), element) == vector.end()) vector.push_back(element); }
 
-extern std::recursive_mutex global_mutex;
+//Recursive mutex that keeps count of how often and how long threads had to wait for it.
+//Mutexes must be taken in increasing level order: global_mutex is level 0 and the locks owned
+//by an interface come after it. Debug builds check this on every lock and log violations.
+class Tracked_Mutex {
+    std::recursive_mutex mutex;
+
+#ifndef EMU_RELEASE_BUILD
+    void check_lock_order();
+    void push_held();
+    void pop_held();
+#endif
+
+public:
+    const char *name;
+    unsigned level;
+    std::atomic<unsigned long long> lock_count{0};
+    std::atomic<unsigned long long> contended_count{0};
+    std::atomic<unsigned long long> wait_time_us{0};
+
+    Tracked_Mutex(const char *name, unsigned level=0) : name(name), level(level) {}
+
+    void lock() {
+#ifndef EMU_RELEASE_BUILD
+        check_lock_order();
+#endif
+        if (!mutex.try_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            mutex.lock();
+            contended_count.fetch_add(1, std::memory_order_relaxed);
+            wait_time_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        }
+
+        lock_count.fetch_add(1, std::memory_order_relaxed);
+#ifndef EMU_RELEASE_BUILD
+        push_held();
+#endif
+    }
+
+    bool try_lock() {
+        if (!mutex.try_lock()) return false;
+        lock_count.fetch_add(1, std::memory_order_relaxed);
+#ifndef EMU_RELEASE_BUILD
+        push_held();
+#endif
+        return true;
+    }
+
+    void unlock() {
+#ifndef EMU_RELEASE_BUILD
+        pop_held();
+#endif
+        mutex.unlock();
+    }
+
+    void print_stats() {
+        PRINT_DEBUG("mutex %s: %llu locks, %llu contended, %llu us waited\n", name, lock_count.load(), contended_count.load(), wait_time_us.load());
+    }
+};
+
+extern Tracked_Mutex global_mutex;
 
 std::string get_env_variable(std::string name);
 bool set_env_variable(std::string name, std::string value);
@@ -48,12 +107,19 @@ public:
 
 #define STEAM_CALLRESULT_TIMEOUT 120.0
 #define STEAM_CALLRESULT_WAIT_FOR_CB 0.01
+typedef std::shared_ptr<const std::vector<char>> Steam_Call_Result_Data;
+
+static inline Steam_Call_Result_Data make_call_result_data(void *r, unsigned int s)
+{
+    if (s > 0 && r != NULL)
+        return std::make_shared<const std::vector<char>>((char *)r, (char *)r + s);
+    return std::make_shared<const std::vector<char>>(s);
+}
+
 struct Steam_Call_Result {
-    Steam_Call_Result(SteamAPICall_t a, int icb, void *r, unsigned int s, double r_in, bool run_cc_cb) {
+    Steam_Call_Result(SteamAPICall_t a, int icb, Steam_Call_Result_Data r, double r_in, bool run_cc_cb) {
         api_call = a;
-        result.resize(s);
-        if (s > 0 && r != NULL)
-            memcpy(&(result[0]), r, s);
+        result = std::move(r);
         created = std::chrono::high_resolution_clock::now();
         run_in = r_in;
         run_call_completed_cb = run_cc_cb;
@@ -83,7 +149,8 @@ struct Steam_Call_Result {
 
     SteamAPICall_t api_call;
     std::vector<class CCallbackBase *> callbacks;
-    std::vector<char> result;
+    //shared by every call result posted for the same callback
+    Steam_Call_Result_Data result;
     bool to_delete = false;
     bool reserved = false;
     std::chrono::high_resolution_clock::time_point created;
@@ -92,6 +159,14 @@ struct Steam_Call_Result {
     int iCallback;
 };
 
+//a callback that is ready to run, queued while holding global_mutex and run after it has been released
+struct Steam_Call_Result_Dispatch {
+    class CCallbackBase *cb;
+    Steam_Call_Result_Data result;
+    SteamAPICall_t api_call;
+    bool call_result;
+};
+
 int generate_random_int();
 SteamAPICall_t generate_steam_api_call_id();
 CSteamID generate_steam_id_user();
@@ -109,10 +184,50 @@ unsigned int file_size_(std::string full_path);
 
 class SteamCallResults {
     std::vector<struct Steam_Call_Result> callresults;
+    std::unordered_map<SteamAPICall_t, size_t> callresults_index;
     std::vector<class CCallbackBase *> completed_callbacks;
-    void (*cb_all)(std::vector<char> result, int callback) = nullptr;
+    void (*cb_all)(const std::vector<char> &result, int callback) = nullptr;
+
+    //filled by runCallResults and drained by dispatchCallResults, has its own lock so the
+    //callbacks themselves can run without global_mutex held
+    std::mutex dispatch_mutex;
+    std::deque<struct Steam_Call_Result_Dispatch> dispatch_queue;
+    //callbacks dispatchCallResults is running right now and the thread running them, see waitDispatch
+    std::vector<std::pair<class CCallbackBase *, std::thread::id>> dispatching;
+    std::condition_variable dispatch_done;
+
+    bool is_dispatching_elsewhere(class CCallbackBase *cb) {
+        for (auto & d : dispatching) {
+            if (d.first == cb && d.second != std::this_thread::get_id()) return true;
+        }
+
+        return false;
+    }
+
+    void cancel_dispatch(class CCallbackBase *cb, SteamAPICall_t api_call=0) {
+        std::lock_guard<std::mutex> lock(dispatch_mutex);
+        for (auto & d : dispatch_queue) {
+            if (d.cb == cb && (!api_call || d.api_call == api_call)) {
+                d.cb = NULL;
+            }
+        }
+    }
+
+    struct Steam_Call_Result *find_call_result(SteamAPICall_t api_call) {
+        auto index = callresults_index.find(api_call);
+        if (index == callresults_index.end()) return NULL;
+        return &callresults[index->second];
+    }
 
 public:
+    //Must be called without global_mutex held (the running callback might need it): once cb has been
+    //unregistered this waits for another thread that is still running it so that it can be freed.
+    //A callback unregistering itself doesn't wait.
+    void waitDispatch(class CCallbackBase *cb) {
+        std::unique_lock<std::mutex> lock(dispatch_mutex);
+        dispatch_done.wait(lock, [this, cb]() { return !is_dispatching_elsewhere(cb); });
+    }
+
     void addCallCompleted(class CCallbackBase *cb) {
         if (std::find(completed_callbacks.begin(), completed_callbacks.end(), cb) == completed_callbacks.end()) {
             completed_callbacks.push_back(cb);
@@ -124,30 +239,32 @@ public:
         if (c != completed_callbacks.end()) {
             completed_callbacks.erase(c);
         }
+
+        cancel_dispatch(cb);
     }
 
     void addCallBack(SteamAPICall_t api_call, class CCallbackBase *cb) {
-        auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-        if (cb_result != callresults.end()) {
+        struct Steam_Call_Result *cb_result = find_call_result(api_call);
+        if (cb_result) {
             cb_result->callbacks.push_back(cb);
             CCallbackMgr::SetRegister(cb, cb->GetICallback());
         }
     }
 
     bool exists(SteamAPICall_t api_call) {
-        auto cr = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-        if (cr == callresults.end()) return false;
+        struct Steam_Call_Result *cr = find_call_result(api_call);
+        if (!cr) return false;
         if (!cr->call_completed()) return false;
         return true;
     }
 
     bool callback_result(SteamAPICall_t api_call, void *copy_to, unsigned int size) {
-        auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-        if (cb_result != callresults.end()) {
+        struct Steam_Call_Result *cb_result = find_call_result(api_call);
+        if (cb_result) {
             if (!cb_result->call_completed()) return false;
-            if (cb_result->result.size() > size) return false;
+            if (cb_result->result->size() > size) return false;
 
-            memcpy(copy_to, &(cb_result->result[0]), cb_result->result.size());
+            if (cb_result->result->size()) memcpy(copy_to, cb_result->result->data(), cb_result->result->size());
             cb_result->to_delete = true;
             return true;
         } else {
@@ -156,14 +273,16 @@ public:
     }
 
     void rmCallBack(SteamAPICall_t api_call, class CCallbackBase *cb) {
-        auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-        if (cb_result != callresults.end()) {
+        struct Steam_Call_Result *cb_result = find_call_result(api_call);
+        if (cb_result) {
             auto it = std::find(cb_result->callbacks.begin(), cb_result->callbacks.end(), cb);
             if (it != cb_result->callbacks.end()) {
                 cb_result->callbacks.erase(it);
                 CCallbackMgr::SetUnregister(cb);
             }
         }
+
+        cancel_dispatch(cb, api_call);
     }
 
     void rmCallBack(class CCallbackBase *cb) {
@@ -178,22 +297,25 @@ public:
                 cr.to_delete = true;
             }
         }
+
+        cancel_dispatch(cb);
     }
 
-    SteamAPICall_t addCallResult(SteamAPICall_t api_call, int iCallback, void *result, unsigned int size, double timeout=DEFAULT_CB_TIMEOUT, bool run_call_completed_cb=true) {
-        auto cb_result = std::find_if(callresults.begin(), callresults.end(), [api_call](struct Steam_Call_Result const& item) { return item.api_call == api_call; });
-        if (cb_result != callresults.end()) {
+    SteamAPICall_t addCallResult(SteamAPICall_t api_call, int iCallback, Steam_Call_Result_Data result, double timeout=DEFAULT_CB_TIMEOUT, bool run_call_completed_cb=true) {
+        struct Steam_Call_Result *cb_result = find_call_result(api_call);
+        if (cb_result) {
             if (cb_result->reserved) {
                 std::chrono::high_resolution_clock::time_point created = cb_result->created;
-                std::vector<class CCallbackBase *> temp_cbs = cb_result->callbacks;
-                *cb_result = Steam_Call_Result(api_call, iCallback, result, size, timeout, run_call_completed_cb);
-                cb_result->callbacks = temp_cbs;
+                std::vector<class CCallbackBase *> temp_cbs;
+                temp_cbs.swap(cb_result->callbacks);
+                *cb_result = Steam_Call_Result(api_call, iCallback, std::move(result), timeout, run_call_completed_cb);
+                cb_result->callbacks.swap(temp_cbs);
                 cb_result->created = created;
                 return cb_result->api_call;
             }
         } else {
-            struct Steam_Call_Result res = Steam_Call_Result(api_call, iCallback, result, size, timeout, run_call_completed_cb);
-            callresults.push_back(res);
+            callresults_index[api_call] = callresults.size();
+            callresults.push_back(Steam_Call_Result(api_call, iCallback, std::move(result), timeout, run_call_completed_cb));
             return callresults.back().api_call;
         }
 
@@ -201,102 +323,129 @@ public:
         return 0;
     }
 
+    SteamAPICall_t addCallResult(SteamAPICall_t api_call, int iCallback, void *result, unsigned int size, double timeout=DEFAULT_CB_TIMEOUT, bool run_call_completed_cb=true) {
+        return addCallResult(api_call, iCallback, make_call_result_data(result, size), timeout, run_call_completed_cb);
+    }
+
     SteamAPICall_t reserveCallResult() {
-        struct Steam_Call_Result res = Steam_Call_Result(generate_steam_api_call_id(), 0, NULL, 0, 0.0, true);
-        res.reserved = true;
-        callresults.push_back(res);
-        return callresults.back().api_call;
+        SteamAPICall_t api_call = generate_steam_api_call_id();
+        callresults_index[api_call] = callresults.size();
+        callresults.push_back(Steam_Call_Result(api_call, 0, make_call_result_data(NULL, 0), 0.0, true));
+        callresults.back().reserved = true;
+        return api_call;
     }
 
     SteamAPICall_t addCallResult(int iCallback, void *result, unsigned int size, double timeout=DEFAULT_CB_TIMEOUT, bool run_call_completed_cb=true) {
         return addCallResult(generate_steam_api_call_id(), iCallback, result, size, timeout, run_call_completed_cb);
     }
 
-    void setCbAll(void (*cb_all)(std::vector<char> result, int callback)) {
+    void setCbAll(void (*cb_all)(const std::vector<char> &result, int callback)) {
         this->cb_all = cb_all;
     }
 
+    //Called with global_mutex held, moves every call result that is ready into the dispatch queue.
     void runCallResults() {
-        unsigned long current_size = callresults.size();
-        for (unsigned i = 0; i < current_size; ++i) {
-            unsigned index = i;
-
-            if (!callresults[index].to_delete) {
-                if (callresults[index].can_execute()) {
-                    std::vector<char> result = callresults[index].result;
-                    SteamAPICall_t api_call = callresults[index].api_call;
-                    bool run_call_completed_cb = callresults[index].run_call_completed_cb;
-                    int iCallback = callresults[index].iCallback;
+        std::vector<struct Steam_Call_Result_Dispatch> ready;
+        for (auto & cr : callresults) {
+            if (!cr.to_delete) {
+                if (cr.can_execute()) {
+                    bool run_call_completed_cb = cr.run_call_completed_cb;
                     if (run_call_completed_cb) {
-                        callresults[index].run_call_completed_cb = false;
+                        cr.run_call_completed_cb = false;
                     }
 
-                    callresults[index].to_delete = true;
-                    if (callresults[index].has_cb()) {
-                        std::vector<class CCallbackBase *> temp_cbs = callresults[index].callbacks;
-                        for (auto & cb : temp_cbs) {
-                            PRINT_DEBUG("Calling callresult %p %i\n", cb, cb->GetICallback());
-                            global_mutex.unlock();
-                            //TODO: unlock relock doesn't work if mutex was locked more than once.
-                            if (run_call_completed_cb) { //run the right function depending on if it's a callback or a call result.
-                                cb->Run(&(result[0]), false, api_call);
-                            } else {
-                                cb->Run(&(result[0]));
-                            }
-                            //COULD BE DELETED SO DON'T TOUCH CB
-                            global_mutex.lock();
-                            PRINT_DEBUG("callresult done\n");
-                        }
+                    cr.to_delete = true;
+                    for (auto & cb : cr.callbacks) {
+                        ready.push_back({cb, cr.result, cr.api_call, run_call_completed_cb});
                     }
 
+                    //the call result never runs again once to_delete is set
+                    cr.callbacks.clear();
+
                     if (run_call_completed_cb) {
-                        //can it happen that one is removed during the callback?
-                        std::vector<class CCallbackBase *> callbacks = completed_callbacks;
                         SteamAPICallCompleted_t data;
-                        data.m_hAsyncCall = api_call;
-                        data.m_iCallback = iCallback;
-                        data.m_cubParam = result.size();
-
-                        for (auto & cb: callbacks) {
-                            PRINT_DEBUG("Call complete cb %i %p %llu\n", iCallback, cb, api_call);
-                            //TODO: check if this is a problem or not.
-                            SteamAPICallCompleted_t temp = data;
-                            global_mutex.unlock();
-                            cb->Run(&temp);
-                            global_mutex.lock();
+                        data.m_hAsyncCall = cr.api_call;
+                        data.m_iCallback = cr.iCallback;
+                        data.m_cubParam = cr.result->size();
+                        Steam_Call_Result_Data completed = make_call_result_data(&data, sizeof(data));
+
+                        for (auto & cb: completed_callbacks) {
+                            PRINT_DEBUG("Call complete cb %i %p %llu\n", cr.iCallback, cb, cr.api_call);
+                            ready.push_back({cb, completed, cr.api_call, false});
                         }
 
                         if (cb_all) {
-                            std::vector<char> res;
-                            res.resize(sizeof(data));
-                            memcpy(&(res[0]), &data, sizeof(data));
-                            cb_all(res, data.k_iCallback);
+                            cb_all(*completed, data.k_iCallback);
                         }
                     } else {
                         if (cb_all) {
-                            cb_all(result, iCallback);
+                            cb_all(*cr.result, cr.iCallback);
                         }
                     }
                 } else {
-                    if (callresults[index].timed_out()) {
-                        callresults[index].to_delete = true;
+                    if (cr.timed_out()) {
+                        cr.to_delete = true;
                     }
                 }
             }
         }
 
+        if (!ready.empty()) {
+            std::lock_guard<std::mutex> lock(dispatch_mutex);
+            for (auto & d : ready) {
+                dispatch_queue.push_back(std::move(d));
+            }
+        }
+
         PRINT_DEBUG("runCallResults erase to_delete\n");
-        auto c = std::begin(callresults);
-        while (c != std::end(callresults)) {
-            if (c->to_delete) {
-                if (c->timed_out()) {
-                    c = callresults.erase(c);
-                } else {
-                    ++c;
-                }
+        //single compaction pass, surviving entries are moved down and their index updated
+        size_t write = 0;
+        for (size_t read = 0; read < callresults.size(); ++read) {
+            if (callresults[read].to_delete && callresults[read].timed_out()) {
+                callresults_index.erase(callresults[read].api_call);
+                continue;
+            }
+
+            if (write != read) {
+                callresults[write] = std::move(callresults[read]);
+                callresults_index[callresults[write].api_call] = write;
+            }
+
+            ++write;
+        }
+
+        callresults.erase(callresults.begin() + write, callresults.end());
+    }
+
+    //Must be called without global_mutex held: runs the queued callbacks, a callback unregistered
+    //in the meantime (even by one of the earlier callbacks) has been removed from the queue.
+    void dispatchCallResults() {
+        while (true) {
+            struct Steam_Call_Result_Dispatch d;
+            {
+                std::lock_guard<std::mutex> lock(dispatch_mutex);
+                if (dispatch_queue.empty()) break;
+                d = std::move(dispatch_queue.front());
+                dispatch_queue.pop_front();
+                if (d.cb) dispatching.push_back(std::make_pair(d.cb, std::this_thread::get_id()));
+            }
+
+            if (!d.cb) continue;
+            PRINT_DEBUG("Calling callresult %p %i\n", d.cb, d.cb->GetICallback());
+            if (d.call_result) { //run the right function depending on if it's a callback or a call result.
+                d.cb->Run((void *)d.result->data(), false, d.api_call);
             } else {
-                ++c;
+                d.cb->Run((void *)d.result->data());
             }
+            //COULD BE DELETED SO DON'T TOUCH CB
+            PRINT_DEBUG("callresult done\n");
+            {
+                std::lock_guard<std::mutex> lock(dispatch_mutex);
+                auto running = std::find(dispatching.begin(), dispatching.end(), std::make_pair(d.cb, std::this_thread::get_id()));
+                if (running != dispatching.end()) dispatching.erase(running);
+            }
+
+            dispatch_done.notify_all();
         }
     }
 };
@@ -304,7 +453,7 @@ public:
 
 struct Steam_Call_Back {
     std::vector<class CCallbackBase *> callbacks;
-    std::vector<std::vector<char>> results;
+    std::vector<Steam_Call_Result_Data> results;
 };
 
 class SteamCallBacks {
@@ -323,22 +472,24 @@ public:
             return;
         }
 
-        if (std::find(callbacks[iCallback].callbacks.begin(), callbacks[iCallback].callbacks.end(), cb) == callbacks[iCallback].callbacks.end()) {
-            callbacks[iCallback].callbacks.push_back(cb);
+        struct Steam_Call_Back &call_back = callbacks[iCallback];
+        if (std::find(call_back.callbacks.begin(), call_back.callbacks.end(), cb) == call_back.callbacks.end()) {
+            call_back.callbacks.push_back(cb);
             CCallbackMgr::SetRegister(cb, iCallback);
-            for (auto & res: callbacks[iCallback].results) {
+            for (auto & res: call_back.results) {
                 //TODO: timeout?
-                SteamAPICall_t api_id = results->addCallResult(iCallback, &(res[0]), res.size(), 0.0, false);
+                SteamAPICall_t api_id = results->addCallResult(generate_steam_api_call_id(), iCallback, res, 0.0, false);
                 results->addCallBack(api_id, cb);
             }
         }
     }
 
     void addCBResult(int iCallback, void *result, unsigned int size, double timeout, bool dont_post_if_already) {
+        struct Steam_Call_Back &call_back = callbacks[iCallback];
         if (dont_post_if_already) {
-            for (auto & r : callbacks[iCallback].results) {
-                if (r.size() == size) {
-                    if (memcmp(&(r[0]), result, size) == 0) {
+            for (auto & r : call_back.results) {
+                if (r->size() == size) {
+                    if (size == 0 || memcmp(r->data(), result, size) == 0) {
                         //cb already posted
                         return;
                     }
@@ -346,17 +497,16 @@ public:
             }
         }
 
-        std::vector<char> temp;
-        temp.resize(size);
-        memcpy(&(temp[0]), result, size);
-        callbacks[iCallback].results.push_back(temp);
-        for (auto cb: callbacks[iCallback].callbacks) {
-            SteamAPICall_t api_id = results->addCallResult(iCallback, result, size, timeout, false);
+        //one copy of the payload shared by every registered callback
+        Steam_Call_Result_Data data = make_call_result_data(result, size);
+        call_back.results.push_back(data);
+        for (auto cb: call_back.callbacks) {
+            SteamAPICall_t api_id = results->addCallResult(generate_steam_api_call_id(), iCallback, data, timeout, false);
             results->addCallBack(api_id, cb);
         }
 
-        if (callbacks[iCallback].callbacks.empty()) {
-            results->addCallResult(iCallback, result, size, timeout, false);
+        if (call_back.callbacks.empty()) {
+            results->addCallResult(generate_steam_api_call_id(), iCallback, data, timeout, false);
         }
     }
 
@@ -457,6 +607,8 @@ public:
     }
 };
 
+//Pooled message objects, Release() returns both the struct and its payload to the pool and is safe from any thread.
+SteamNetworkingMessage_t *allocate_steam_message(int data_size);
 void set_whitelist_ips(uint32_t *from, uint32_t *to, unsigned num_ips);
 #ifdef EMU_EXPERIMENTAL_BUILD
 bool crack_SteamAPI_RestartAppIfNecessary(uint32 unOwnAppID);
@@ -66,7 +66,7 @@
     #undef SystemFunction036
 
     #ifndef EMU_RELEASE_BUILD
-        #define PRINT_DEBUG(a, ...) do {FILE *t = fopen("STEAM_LOG.txt", "a"); fprintf(t, "%u " a, GetCurrentThreadId(), __VA_ARGS__); fclose(t); WSASetLastError(0);} while (0)
+        #define PRINT_DEBUG(a, ...) do {emu_log_print(a, __VA_ARGS__); WSASetLastError(0);} while (0)
     #endif
 
     EXTERN_C IMAGE_DOS_HEADER __ImageBase;
@@ -126,11 +126,12 @@ inline void reset_LastError()
     #include <netdb.h>
     #include <dlfcn.h>
     #include <utime.h>
+    #include <sys/epoll.h>
 
     #define PATH_MAX_STRING_SIZE 512
 
     #ifndef EMU_RELEASE_BUILD
-        #define PRINT_DEBUG(...) {FILE *t = fopen("STEAM_LOG.txt", "a"); fprintf(t, __VA_ARGS__); fclose(t);}
+        #define PRINT_DEBUG(...) {emu_log_print(__VA_ARGS__);}
     #endif
     #define PATH_SEPARATOR "/" 
 
@@ -155,13 +156,24 @@ inline void reset_LastError()
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <queue>
+#include <deque>
 #include <list>
+#include <memory>
 
 #include <thread>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <future>
+
+#ifndef EMU_RELEASE_BUILD
+//buffered STEAM_LOG.txt writer used by PRINT_DEBUG, see debug_log.cpp
+void emu_log_print(const char *format, ...);
+void emu_log_set_filter(const std::vector<std::string> &subsystems);
+#endif
 
 #include <string.h>
 #include <stdio.h>
@@ -0,0 +1,310 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include "common_includes.h"
+
+#ifndef EMU_RELEASE_BUILD
+
+#include <stdarg.h>
+
+#if !defined(STEAM_WIN32)
+#include <sys/syscall.h>
+#endif
+
+// Debug log backend used by PRINT_DEBUG.
+// Every thread formats its lines into its own ring buffer (single producer, single consumer so no
+// locks on the logging side) and a background thread appends them to STEAM_LOG.txt. Each line
+// gets the time since the first log line and the thread id. The subsystem of a line is the
+// identifier it starts with (Steam_Friends::..., Networking::...) and can be filtered at runtime.
+// A line can be printed with several calls (hex dumps), the prefix and the filter decision are
+// only done by the call that starts it.
+
+#define LOG_RING_SIZE (1 << 16)
+#define LOG_MAX_LINE 4096
+#define LOG_FLUSH_INTERVAL_MS 50
+//how long a thread waits for room in its full ring before dropping the line
+#define LOG_FULL_WAIT_MS 100
+
+struct Log_Ring {
+    char data[LOG_RING_SIZE];
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    std::atomic<bool> thread_exited{false};
+    //only used by the owning thread: a wait for room already timed out, drop lines without waiting until there is some
+    bool dropping = false;
+};
+
+struct Log_Filter {
+    std::vector<std::string> enabled;
+    std::vector<std::string> disabled;
+};
+
+struct Log_State {
+    //rings of every thread that has logged, only touched by the writer after registration
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<Log_Ring>> rings;
+
+    //held while draining rings into the file, by the writer thread or the exit flush
+    std::mutex write_mutex;
+    FILE *file = NULL;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    bool wake = false;
+
+    //lines dropped because a ring stayed full, reported in the file by the next drain
+    std::atomic<unsigned long long> dropped_lines{0};
+
+    std::atomic<const Log_Filter *> filter{NULL};
+    std::chrono::steady_clock::time_point start;
+};
+
+static Log_State *get_log_state()
+{
+    //never freed, threads can still log while the process is exiting
+    static Log_State *state = new Log_State();
+    return state;
+}
+
+static void drain_log_rings(Log_State *state, bool wait=true)
+{
+    std::unique_lock<std::mutex> lock(state->write_mutex, std::defer_lock);
+    if (wait) {
+        lock.lock();
+    } else if (!lock.try_lock()) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<Log_Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(state->rings_mutex);
+        rings = state->rings;
+    }
+
+    if (!state->file) state->file = fopen("STEAM_LOG.txt", "a");
+    if (!state->file) return;
+
+    bool wrote = false;
+    std::vector<std::shared_ptr<Log_Ring>> finished;
+    for (auto &ring : rings) {
+        bool exited = ring->thread_exited.load(std::memory_order_acquire);
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        if (head != tail) {
+            size_t start = tail % LOG_RING_SIZE;
+            size_t length = head - tail;
+            size_t first = std::min(length, (size_t)LOG_RING_SIZE - start);
+            fwrite(ring->data + start, 1, first, state->file);
+            if (length > first) fwrite(ring->data, 1, length - first, state->file);
+            ring->tail.store(head, std::memory_order_release);
+            wrote = true;
+        }
+
+        if (exited) finished.push_back(ring);
+    }
+
+    unsigned long long dropped = state->dropped_lines.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+        fprintf(state->file, "%llu log lines dropped because the log buffer was full\n", dropped);
+        wrote = true;
+    }
+
+    if (wrote) fflush(state->file);
+
+    if (!finished.empty()) {
+        std::lock_guard<std::mutex> lock(state->rings_mutex);
+        for (auto &ring : finished) {
+            state->rings.erase(std::remove(state->rings.begin(), state->rings.end(), ring), state->rings.end());
+        }
+    }
+}
+
+static void log_writer_thread(Log_State *state)
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(state->wake_mutex);
+            state->wake_cv.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS), [state]{ return state->wake; });
+            state->wake = false;
+        }
+
+        drain_log_rings(state);
+    }
+}
+
+static void wake_log_writer(Log_State *state)
+{
+    {
+        std::lock_guard<std::mutex> lock(state->wake_mutex);
+        state->wake = true;
+    }
+
+    state->wake_cv.notify_one();
+}
+
+static struct Log_Exit_Flush {
+    ~Log_Exit_Flush() {
+        //the writer thread might already have been killed while holding the lock on windows
+        drain_log_rings(get_log_state(), false);
+    }
+} log_exit_flush;
+
+//set once the ring of this thread is gone, destructors of other thread_locals can still log after that
+static thread_local bool thread_ring_destroyed = false;
+
+struct Log_Thread_Ring {
+    //shared with the writer so the ring stays valid while it is being drained after the thread exited
+    std::shared_ptr<Log_Ring> ring;
+    ~Log_Thread_Ring() {
+        //the writer drops the ring once everything in it has been written
+        if (ring) ring->thread_exited.store(true, std::memory_order_release);
+        thread_ring_destroyed = true;
+    }
+};
+
+static thread_local Log_Thread_Ring thread_ring;
+
+//if the current call starts a new line and if the line being printed passed the filter
+static thread_local bool thread_line_start = true;
+static thread_local bool thread_line_enabled = true;
+
+static Log_Ring *get_thread_log_ring(Log_State *state)
+{
+    if (thread_ring_destroyed) return NULL;
+    if (thread_ring.ring) return thread_ring.ring.get();
+
+    static std::once_flag writer_started;
+    std::call_once(writer_started, [state]() {
+        state->start = std::chrono::steady_clock::now();
+        std::thread(log_writer_thread, state).detach();
+    });
+
+    std::shared_ptr<Log_Ring> ring = std::make_shared<Log_Ring>();
+    {
+        std::lock_guard<std::mutex> lock(state->rings_mutex);
+        state->rings.push_back(ring);
+    }
+
+    thread_ring.ring = ring;
+    return ring.get();
+}
+
+static unsigned long log_thread_id()
+{
+#if defined(STEAM_WIN32)
+    return GetCurrentThreadId();
+#else
+    return syscall(SYS_gettid);
+#endif
+}
+
+static bool log_subsystem_enabled(const Log_Filter *filter, const char *line)
+{
+    size_t length = 0;
+    while (line[length] && (isalnum((unsigned char)line[length]) || line[length] == '_')) ++length;
+    std::string subsystem(line, length);
+
+    for (auto & d : filter->disabled) {
+        if (d == subsystem) return false;
+    }
+
+    if (filter->enabled.empty()) return true;
+    for (auto & e : filter->enabled) {
+        if (e == subsystem) return true;
+    }
+
+    return false;
+}
+
+void emu_log_set_filter(const std::vector<std::string> &subsystems)
+{
+    Log_Filter *filter = new Log_Filter();
+    for (auto & s : subsystems) {
+        if (s.empty()) continue;
+        if (s[0] == '-') filter->disabled.push_back(s.substr(1));
+        else filter->enabled.push_back(s);
+    }
+
+    //the old filter is leaked on purpose, another thread might still be reading it
+    get_log_state()->filter.store(filter, std::memory_order_release);
+}
+
+void emu_log_print(const char *format, ...)
+{
+    Log_State *state = get_log_state();
+    Log_Ring *ring = get_thread_log_ring(state);
+    if (!ring) return;
+
+    char line[LOG_MAX_LINE];
+    int prefix = 0;
+    if (thread_line_start) {
+        unsigned long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state->start).count();
+        prefix = snprintf(line, sizeof(line), "%llu.%03llu %lu ", ms / 1000, ms % 1000, log_thread_id());
+    }
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line + prefix, sizeof(line) - prefix, format, args);
+    va_end(args);
+    if (length <= 0) return;
+
+    size_t size = std::min((size_t)(prefix + length), sizeof(line) - 1);
+    if (size == sizeof(line) - 1) line[size - 1] = '\n';
+
+    //the rest of a line printed in parts follows whatever was decided for its start
+    if (thread_line_start) {
+        const Log_Filter *filter = state->filter.load(std::memory_order_acquire);
+        thread_line_enabled = !filter || log_subsystem_enabled(filter, line + prefix);
+    }
+
+    bool line_started = thread_line_start;
+    thread_line_start = line[size - 1] == '\n';
+    if (!thread_line_enabled) return;
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    if (LOG_RING_SIZE - (head - ring->tail.load(std::memory_order_acquire)) < size) {
+        //full: the writer thread might not be running yet (first lines logged under the loader lock)
+        //or already be gone (killed at exit on windows) so drain the rings from here when nobody
+        //else is, and drop the line if there's still no room after a while
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ring->dropping ? 0 : LOG_FULL_WAIT_MS);
+        while (true) {
+            wake_log_writer(state);
+            drain_log_rings(state, false);
+            if (LOG_RING_SIZE - (head - ring->tail.load(std::memory_order_acquire)) >= size) break;
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                ring->dropping = true;
+                if (line_started) state->dropped_lines.fetch_add(1, std::memory_order_relaxed);
+                //the rest of a line printed in parts goes with it
+                thread_line_enabled = false;
+                return;
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    ring->dropping = false;
+
+    size_t start = head % LOG_RING_SIZE;
+    size_t first = std::min(size, (size_t)LOG_RING_SIZE - start);
+    memcpy(ring->data + start, line, first);
+    if (size > first) memcpy(ring->data, line + first, size - first);
+    ring->head.store(head + size, std::memory_order_release);
+}
+
+#endif
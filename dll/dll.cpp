@@ -132,7 +132,7 @@ ISteamClient *g_pSteamClientGameServer;
 static Steam_Client *steamclient_instance;
 Steam_Client *get_steam_client()
 {
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!steamclient_instance) {
         steamclient_instance = new Steam_Client();
     }
@@ -142,7 +142,7 @@ Steam_Client *get_steam_client()
 
 void destroy_client()
 {
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (steamclient_instance) {
         delete steamclient_instance;
         steamclient_instance = NULL;
@@ -408,16 +408,21 @@ STEAMAPI_API void S_CALLTYPE SteamAPI_RunCallbacks()
 STEAMAPI_API void S_CALLTYPE SteamAPI_RegisterCallback( class CCallbackBase *pCallback, int iCallback )
 {
     PRINT_DEBUG("SteamAPI_RegisterCallback %p %u funct:%u\n", pCallback, iCallback, pCallback->GetICallback());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     get_steam_client()->RegisterCallback(pCallback, iCallback);
 }
 
 STEAMAPI_API void S_CALLTYPE SteamAPI_UnregisterCallback( class CCallbackBase *pCallback )
 {
     PRINT_DEBUG("SteamAPI_UnregisterCallback %p\n", pCallback);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    if (!steamclient_instance) return;
-    get_steam_client()->UnregisterCallback(pCallback);
+    {
+        std::lock_guard<Tracked_Mutex> lock(global_mutex);
+        if (!steamclient_instance) return;
+        get_steam_client()->UnregisterCallback(pCallback);
+    }
+
+    //the callback might be running on another thread, it must be done before the game frees it
+    get_steam_client()->waitCallbackDispatch(pCallback);
 }
 
 // Internal functions used by the utility CCallResult objects to receive async call results
@@ -764,7 +769,7 @@ struct cb_data {
 static std::queue<struct cb_data> client_cb;
 static std::queue<struct cb_data> server_cb;
 
-static void cb_add_queue_server(std::vector<char> result, int callback)
+static void cb_add_queue_server(const std::vector<char> &result, int callback)
 {
     struct cb_data cb;
     cb.cb_id = callback;
@@ -772,7 +777,7 @@ static void cb_add_queue_server(std::vector<char> result, int callback)
     server_cb.push(cb);
 }
 
-static void cb_add_queue_client(std::vector<char> result, int callback)
+static void cb_add_queue_client(const std::vector<char> &result, int callback)
 {
     struct cb_data cb;
     cb.cb_id = callback;
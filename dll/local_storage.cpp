@@ -126,6 +126,11 @@ uint64_t Local_Storage::file_timestamp(std::string folder, std::string file)
     return 0;
 }
 
+file_stamp_t Local_Storage::file_stamp(std::string folder, std::string const& file)
+{
+    return file_stamp_t();
+}
+
 bool Local_Storage::iterate_file(std::string folder, int index, char *output_filename, int32 *output_size)
 {
     return false;
@@ -151,6 +156,25 @@ bool Local_Storage::write_json_file(std::string folder, std::string const&file,
     return false;
 }
 
+bool Local_Storage::load_data_file(std::string folder, std::string const&file, std::string& data)
+{
+    return false;
+}
+
+bool Local_Storage::store_data_file_atomic(std::string folder, std::string const&file, std::string const& data)
+{
+    return false;
+}
+
+bool Local_Storage::lock_data_file(std::string folder, std::string const& file, file_lock_t &lock)
+{
+    return false;
+}
+
+void Local_Storage::unlock_data_file(file_lock_t &lock)
+{
+}
+
 std::vector<std::string> Local_Storage::get_filenames_path(std::string path)
 {
     return std::vector<std::string>();
@@ -161,6 +185,11 @@ std::vector<image_pixel_t> Local_Storage::load_image(std::string const& image_pa
     return std::vector<image_pixel_t>();
 }
 
+bool Local_Storage::load_image_file(std::string const& image_path, std::string& rgba, uint32& width, uint32& height)
+{
+    return false;
+}
+
 bool Local_Storage::save_screenshot(std::string const& image_path, uint8_t* img_ptr, int32_t width, int32_t height, int32_t channels)
 {
     return false;
@@ -272,6 +301,8 @@ static std::vector<struct File_Data> get_filenames_recursive(std::string base_pa
 
 #else
 
+#include <sys/file.h>
+
 /* recursive mkdir */
 static int mkdir_p(const char *dir, const mode_t mode) {
     char tmp[PATH_MAX_STRING_SIZE];
@@ -657,6 +688,34 @@ uint64_t Local_Storage::file_timestamp(std::string folder, std::string file)
     return buffer.st_mtime;
 }
 
+file_stamp_t Local_Storage::file_stamp(std::string folder, std::string const& file)
+{
+    if (!folder.empty() && folder.back() != *PATH_SEPARATOR) {
+        folder.append(PATH_SEPARATOR);
+    }
+
+    std::string full_path = save_directory + appid + folder + sanitize_file_name(file);
+    file_stamp_t stamp;
+
+#if defined(STEAM_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+    if (GetFileAttributesExW(utf8_decode(full_path).c_str(), GetFileExInfoStandard, &attributes)) {
+        stamp.size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+        stamp.modified = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    }
+#else
+    struct stat buffer = {};
+    if (stat(full_path.c_str(), &buffer) == 0) {
+        stamp.size = buffer.st_size;
+        stamp.modified = (uint64_t)buffer.st_mtim.tv_sec * 1000000000ull + buffer.st_mtim.tv_nsec;
+        stamp.id = buffer.st_ino;
+    }
+#endif
+
+    reset_LastError();
+    return stamp;
+}
+
 bool Local_Storage::iterate_file(std::string folder, int index, char *output_filename, int32 *output_size)
 {
     if (folder.back() != *PATH_SEPARATOR) {
@@ -766,6 +825,118 @@ bool Local_Storage::write_json_file(std::string folder, std::string const&file,
     return false;
 }
 
+bool Local_Storage::load_data_file(std::string folder, std::string const&file, std::string& data)
+{
+    if (!folder.empty() && folder.back() != *PATH_SEPARATOR) {
+        folder.append(PATH_SEPARATOR);
+    }
+
+    std::string full_path = save_directory + appid + folder + sanitize_file_name(file);
+    std::ifstream data_file(utf8_decode(full_path), std::ios::binary | std::ios::in);
+    if (!data_file) {
+        reset_LastError();
+        return false;
+    }
+
+    data_file.seekg(0, std::ios::end);
+    size_t size = data_file.tellg();
+    data.assign(size, '\0');
+    data_file.seekg(0);
+    data_file.read(&data[0], size);
+    bool ok = data_file.gcount() == (std::streamsize)size;
+    reset_LastError();
+    return ok;
+}
+
+bool Local_Storage::store_data_file_atomic(std::string folder, std::string const&file, std::string const& data)
+{
+    if (!folder.empty() && folder.back() != *PATH_SEPARATOR) {
+        folder.append(PATH_SEPARATOR);
+    }
+
+    std::string file_folder = save_directory + appid + folder;
+    std::string full_path = file_folder + sanitize_file_name(file);
+    std::string temp_path = full_path + ".tmp";
+
+    create_directory(file_folder);
+
+    {
+        std::ofstream data_file(utf8_decode(temp_path), std::ios::binary | std::ios::trunc | std::ios::out);
+        if (!data_file) {
+            PRINT_DEBUG("Couldn't open file \"%s\" to write\n", temp_path.c_str());
+            reset_LastError();
+            return false;
+        }
+
+        data_file.write(data.data(), data.size());
+        data_file.flush();
+        if (!data_file) {
+            PRINT_DEBUG("Couldn't write file \"%s\"\n", temp_path.c_str());
+            reset_LastError();
+            return false;
+        }
+    }
+
+#if defined(STEAM_WIN32)
+    bool renamed = MoveFileExW(utf8_decode(temp_path).c_str(), utf8_decode(full_path).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    bool renamed = rename(temp_path.c_str(), full_path.c_str()) == 0;
+#endif
+    if (!renamed) {
+        PRINT_DEBUG("Couldn't rename \"%s\" to \"%s\"\n", temp_path.c_str(), full_path.c_str());
+    }
+
+    reset_LastError();
+    return renamed;
+}
+
+bool Local_Storage::lock_data_file(std::string folder, std::string const& file, file_lock_t &lock)
+{
+    if (!folder.empty() && folder.back() != *PATH_SEPARATOR) {
+        folder.append(PATH_SEPARATOR);
+    }
+
+    std::string file_folder = save_directory + appid + folder;
+    std::string lock_path = file_folder + sanitize_file_name(file) + ".lock";
+
+    create_directory(file_folder);
+
+    //the lock goes away with the handle, so a crashed process never leaves it stuck
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+#if defined(STEAM_WIN32)
+        lock.handle = CreateFileW(utf8_decode(lock_path).c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (lock.handle != INVALID_HANDLE_VALUE) break;
+#else
+        if (lock.fd < 0) lock.fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (lock.fd >= 0 && flock(lock.fd, LOCK_EX | LOCK_NB) == 0) break;
+#endif
+
+        if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(FILE_LOCK_TIMEOUT_MS)) {
+            PRINT_DEBUG("Couldn't lock \"%s\"\n", lock_path.c_str());
+            unlock_data_file(lock);
+            reset_LastError();
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    reset_LastError();
+    return true;
+}
+
+void Local_Storage::unlock_data_file(file_lock_t &lock)
+{
+#if defined(STEAM_WIN32)
+    if (lock.handle != INVALID_HANDLE_VALUE) CloseHandle(lock.handle);
+    lock.handle = INVALID_HANDLE_VALUE;
+#else
+    if (lock.fd >= 0) close(lock.fd);
+    lock.fd = -1;
+#endif
+}
+
 std::vector<image_pixel_t> Local_Storage::load_image(std::string const& image_path)
 {
     std::vector<image_pixel_t> res;
@@ -783,6 +954,20 @@ std::vector<image_pixel_t> Local_Storage::load_image(std::string const& image_pa
     return res;
 }
 
+bool Local_Storage::load_image_file(std::string const& image_path, std::string& rgba, uint32& width, uint32& height)
+{
+    int w, h;
+    unsigned char* img = stbi_load(image_path.c_str(), &w, &h, nullptr, 4);
+    reset_LastError();
+    if (img == nullptr) return false;
+
+    rgba.assign((char *)img, (size_t)w * h * 4);
+    width = w;
+    height = h;
+    stbi_image_free(img);
+    return true;
+}
+
 bool Local_Storage::save_screenshot(std::string const& image_path, uint8_t* img_ptr, int32_t width, int32_t height, int32_t channels)
 {
     std::string screenshot_path = std::move(save_directory + appid + screenshots_folder + PATH_SEPARATOR); 
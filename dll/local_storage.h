@@ -21,6 +21,7 @@
 #include "base.h"
 
 #define MAX_FILENAME_LENGTH 300
+#define FILE_LOCK_TIMEOUT_MS 2000
 
 union image_pixel_t
 {
@@ -41,6 +42,27 @@ struct image_t
     std::vector<image_pixel_t> pix_map;
 };
 
+//size and modification time of a file with sub-second precision, plus the inode where there is one
+//so that a same second rewrite by another process is still noticed
+struct file_stamp_t
+{
+    uint64_t size = 0;
+    uint64_t modified = 0;
+    uint64_t id = 0;
+
+    bool operator==(file_stamp_t const& other) const { return size == other.size && modified == other.modified && id == other.id; }
+    bool operator!=(file_stamp_t const& other) const { return !(*this == other); }
+};
+
+struct file_lock_t
+{
+#if defined(STEAM_WIN32)
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+};
+
 class Local_Storage {
 public:
     static constexpr auto inventory_storage_folder = "inventory";
@@ -75,6 +97,7 @@ public:
     unsigned int file_size(std::string folder, std::string file);
     bool file_delete(std::string folder, std::string file);
     uint64_t file_timestamp(std::string folder, std::string file);
+    file_stamp_t file_stamp(std::string folder, std::string const& file);
     std::string get_global_settings_path();
     std::string get_path(std::string folder);
 
@@ -84,7 +107,16 @@ public:
     bool load_json_file(std::string folder, std::string const& file, nlohmann::json& json);
     bool write_json_file(std::string folder, std::string const& file, nlohmann::json const& json);
 
+    bool load_data_file(std::string folder, std::string const& file, std::string& data);
+    //writes to a temporary file first then renames it over the old one so a crash never leaves a half written file
+    bool store_data_file_atomic(std::string folder, std::string const& file, std::string const& data);
+    //exclusive lock on a "<file>.lock" next to the file, shared with the other processes using the same folder
+    //returns false if it couldn't be taken within FILE_LOCK_TIMEOUT_MS
+    bool lock_data_file(std::string folder, std::string const& file, file_lock_t &lock);
+    void unlock_data_file(file_lock_t &lock);
+
     std::vector<image_pixel_t> load_image(std::string const& image_path);
+    static bool load_image_file(std::string const& image_path, std::string& rgba, uint32& width, uint32& height);
     bool save_screenshot(std::string const& image_path, uint8_t* img_ptr, int32_t width, int32_t height, int32_t channels);
 };
 
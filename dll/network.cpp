@@ -25,9 +25,39 @@ static uint32_t upper_range_ips[MAX_BROADCASTS];
 
 #define BROADCAST_INTERVAL 5.0
 #define HEARTBEAT_TIMEOUT 20.0
+#define PING_RATE 2.0
 #define USER_TIMEOUT 20.0
 
-#define MAX_UDP_SIZE 16384
+//received messages are parsed into an arena that lives for one Run() (or one network thread batch)
+//Run() gives the arena a first block on the stack so a tick only allocates when it receives more than that.
+//The arena blocks are the only heap allocations made for received messages, they are counted.
+#define MESSAGE_ARENA_START_BLOCK 16384
+#define MESSAGE_ARENA_MAX_BLOCK 262144
+
+static std::atomic<uint64> message_arena_blocks;
+
+static void *message_arena_block_alloc(size_t size)
+{
+    ++message_arena_blocks;
+    return ::operator new(size);
+}
+
+static void message_arena_block_dealloc(void *block, size_t size)
+{
+    ::operator delete(block);
+}
+
+static google::protobuf::ArenaOptions message_arena_options(char *initial_block = NULL, size_t initial_block_size = 0)
+{
+    google::protobuf::ArenaOptions options;
+    options.initial_block = initial_block;
+    options.initial_block_size = initial_block_size;
+    options.start_block_size = MESSAGE_ARENA_START_BLOCK;
+    options.max_block_size = MESSAGE_ARENA_MAX_BLOCK;
+    options.block_alloc = message_arena_block_alloc;
+    options.block_dealloc = message_arena_block_dealloc;
+    return options;
+}
 
 #if defined(STEAM_WIN32)
 
@@ -315,6 +345,47 @@ static int receive_packet(sock_t sock, IP_PORT *ip_port, char *data, unsigned lo
     return -1;
 }
 
+//receives up to UDP_BATCH_SIZE packets, returns how many were received
+static int receive_packets(sock_t sock, struct UDP_Batch &batch)
+{
+    if (batch.data.empty()) batch.data.resize(UDP_BATCH_SIZE * MAX_UDP_SIZE);
+
+#if defined(__LINUX__)
+    struct mmsghdr msgs[UDP_BATCH_SIZE] = {};
+    struct iovec iovecs[UDP_BATCH_SIZE];
+    struct sockaddr_in addrs[UDP_BATCH_SIZE];
+    for (unsigned i = 0; i < UDP_BATCH_SIZE; ++i) {
+        iovecs[i].iov_base = batch.packet(i);
+        iovecs[i].iov_len = MAX_UDP_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+
+    int ret = recvmmsg(sock, msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+    if (ret <= 0) return 0;
+
+    for (int i = 0; i < ret; ++i) {
+        batch.lengths[i] = msgs[i].msg_len;
+        batch.ip_ports[i].ip = addrs[i].sin_addr.s_addr;
+        batch.ip_ports[i].port = addrs[i].sin_port;
+    }
+
+    return ret;
+#else
+    int count = 0;
+    while (count < UDP_BATCH_SIZE) {
+        int len = receive_packet(sock, &(batch.ip_ports[count]), batch.packet(count), MAX_UDP_SIZE);
+        if (len < 0) break;
+        batch.lengths[count] = len;
+        ++count;
+    }
+
+    return count;
+#endif
+}
+
 static bool send_broadcasts(sock_t sock, uint16 port, char *data, unsigned long length, std::vector<IP_PORT> *custom_broadcasts)
 {
     static std::chrono::high_resolution_clock::time_point last_get_broadcast_info;
@@ -401,37 +472,38 @@ static void connect_socket(sock_t sock, IP_PORT ip_port)
     connect(sock, (struct sockaddr *)&addr, addrsize);
 }
 
-unsigned int receive_buffer_amount(sock_t sock)
-{
-#if defined(STEAM_WIN32)
-    unsigned long count = 0;
-    ioctlsocket(sock, FIONREAD, &count);
-#else
-    int count = 0;
-    ioctl(sock, FIONREAD, &count);
-#endif
-
-    return count;
-}
 
+#define TCP_RECV_CHUNK 65536
 
 static void send_tcp_pending(struct TCP_Socket &socket)
 {
     size_t buf_size = socket.send_buffer.size();
     if (buf_size == 0) return;
 
-    int len = send(socket.sock, &(socket.send_buffer[0]), buf_size, MSG_NOSIGNAL);
+    int len = send(socket.sock, socket.send_buffer.data(), buf_size, MSG_NOSIGNAL);
     if (len <= 0) return;
 
-    socket.send_buffer.erase(socket.send_buffer.begin(), socket.send_buffer.begin() + len);
+    socket.send_buffer.consume(len);
 }
 
 static void send_buffer_tcp(struct TCP_Socket &socket, Common_Message *msg)
 {
-    uint32 size = msg->ByteSizeLong(), old_size = socket.send_buffer.size();
-    socket.send_buffer.resize(old_size + sizeof(uint32) + size);
-    memcpy(&(socket.send_buffer[old_size]), &size, sizeof(size));
-    msg->SerializeToArray(&(socket.send_buffer[old_size + sizeof(uint32)]), size);
+    uint32 size = msg->ByteSizeLong();
+    char *buf = socket.send_buffer.reserve(sizeof(uint32) + size);
+    memcpy(buf, &size, sizeof(size));
+    msg->SerializeToArray(buf + sizeof(uint32), size);
+    socket.send_buffer.commit(sizeof(uint32) + size);
+
+    send_tcp_pending(socket);
+}
+
+static void send_buffer_tcp(struct TCP_Socket &socket, const char *data, size_t size)
+{
+    uint32 length = size;
+    char *buf = socket.send_buffer.reserve(sizeof(uint32) + size);
+    memcpy(buf, &length, sizeof(length));
+    memcpy(buf + sizeof(uint32), data, size);
+    socket.send_buffer.commit(sizeof(uint32) + size);
 
     send_tcp_pending(socket);
 }
@@ -441,7 +513,7 @@ static unsigned long peek_buffer_tcp(struct TCP_Socket &socket)
     uint32 length;
     if (socket.recv_buffer.size() < sizeof(length)) return 0;
 
-    memcpy(&length, &(socket.recv_buffer[0]), sizeof(length));
+    memcpy(&length, socket.recv_buffer.data(), sizeof(length));
     if (sizeof(length) + length > socket.recv_buffer.size()) return 0;
 
     return length;
@@ -454,11 +526,11 @@ static bool unbuffer_tcp(struct TCP_Socket &socket, Common_Message *msg)
         return false;
     }
 
-    if (msg->ParseFromArray(&(socket.recv_buffer[sizeof(uint32)]), l)) {
-        socket.recv_buffer.erase(socket.recv_buffer.begin(), socket.recv_buffer.begin() + sizeof(l) + l);
+    if (msg->ParseFromArray(socket.recv_buffer.data() + sizeof(uint32), l)) {
+        socket.recv_buffer.consume(sizeof(l) + l);
         return true;
     } else {
-        PRINT_DEBUG("BAD TCP DATA %lu %zu %zu %hhu\n", l, socket.recv_buffer.size(), sizeof(uint32), *((char *)&(socket.recv_buffer[sizeof(uint32)])));
+        PRINT_DEBUG("BAD TCP DATA %lu %zu %zu %hhu\n", l, socket.recv_buffer.size(), sizeof(uint32), *(socket.recv_buffer.data() + sizeof(uint32)));
         kill_tcp_socket(socket);
     }
 
@@ -467,18 +539,22 @@ static bool unbuffer_tcp(struct TCP_Socket &socket, Common_Message *msg)
 
 static bool recv_tcp(struct TCP_Socket &socket)
 {
+    bool received = false;
     if (is_socket_valid(socket.sock)) {
-        unsigned int size = receive_buffer_amount(socket.sock), old_size = socket.recv_buffer.size();
-        int len;
-        socket.recv_buffer.resize(old_size + size);
-        if (size > 0) {
-            len = recv(socket.sock, &(socket.recv_buffer[old_size]), size, MSG_NOSIGNAL);
+        //read straight into the free space at the end of the buffer until the socket is drained
+        while (true) {
+            char *buf = socket.recv_buffer.reserve(TCP_RECV_CHUNK);
+            int len = recv(socket.sock, buf, TCP_RECV_CHUNK, MSG_NOSIGNAL);
+            if (len <= 0) break;
+
+            socket.recv_buffer.commit(len);
             socket.received_data = true;
-            return true;
+            received = true;
+            if (len < TCP_RECV_CHUNK) break;
         }
     }
 
-    return false;
+    return received;
 }
 
 static void socket_timeouts(struct TCP_Socket &socket, double extra_time)
@@ -546,6 +622,11 @@ void Networking::do_callbacks_message(Common_Message *msg)
         run_callbacks(CALLBACK_ID_LOBBY, msg);
     }
 
+    if (msg->has_lobby_delta()) {
+        PRINT_DEBUG("has_lobby_delta\n");
+        run_callbacks(CALLBACK_ID_LOBBY, msg);
+    }
+
     if (msg->has_gameserver()) {
         PRINT_DEBUG("has_gameserver\n");
         run_callbacks(CALLBACK_ID_GAMESERVER, msg);
@@ -582,8 +663,66 @@ void Networking::do_callbacks_message(Common_Message *msg)
     }
 }
 
-bool Networking::handle_tcp(Common_Message *msg, struct TCP_Socket &socket)
+static uint64 ping_time_now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Common_Message Networking::create_ping(Low_Level::Types type, uint64 time)
+{
+    Common_Message msg;
+    msg.set_source_id(main_id);
+    msg.set_allocated_low_level(new Low_Level());
+    msg.mutable_low_level()->set_type(type);
+    msg.mutable_low_level()->set_time(time);
+    return msg;
+}
+
+void Networking::send_pings(struct Connection &connection)
+{
+    Common_Message msg = create_ping(Low_Level::PING, ping_time_now());
+    if (connection.udp_pinged) {
+        char buffer[MAX_UDP_SIZE];
+        size_t size = msg.ByteSizeLong();
+        msg.SerializeToArray(buffer, size);
+        send_packet_to(udp_socket, connection.udp_ip_port, buffer, size);
+    }
+
+    if (connection.tcp_socket_incoming.received_data) {
+        send_buffer_tcp(connection.tcp_socket_incoming, &msg);
+    } else if (connection.tcp_socket_outgoing.received_data) {
+        send_buffer_tcp(connection.tcp_socket_outgoing, &msg);
+    }
+
+    connection.last_ping_sent = std::chrono::high_resolution_clock::now();
+}
+
+void Networking::send_pong(Common_Message *ping, IP_PORT ip_port)
+{
+    Common_Message pong = create_ping(Low_Level::PONG, ping->low_level().time());
+    char buffer[MAX_UDP_SIZE];
+    size_t size = pong.ByteSizeLong();
+    pong.SerializeToArray(buffer, size);
+    send_packet_to(udp_socket, ip_port, buffer, size);
+}
+
+void Networking::update_ping(struct Connection *connection, uint64 time, uint64 received_time)
 {
+    if (!connection || time > received_time) return;
+
+    double rtt = (received_time - time) / 1000.0;
+    if (connection->ping < 0) {
+        connection->ping = rtt;
+    } else {
+        connection->ping += (rtt - connection->ping) / 8.0;
+    }
+
+    PRINT_DEBUG("Networking::update_ping %f %f\n", rtt, connection->ping);
+}
+
+bool Networking::handle_tcp(Common_Message *msg, struct TCP_Socket &socket, struct Connection &connection)
+{
+    ++messages_received;
     socket.last_heartbeat_received = std::chrono::high_resolution_clock::now();
     if (msg->has_low_level()) {
         switch (msg->low_level().type()) {
@@ -593,6 +732,14 @@ bool Networking::handle_tcp(Common_Message *msg, struct TCP_Socket &socket)
             case Low_Level::HEARTBEAT:
                 //socket.last_heartbeat_received = std::chrono::high_resolution_clock::now();
                 break;
+            case Low_Level::PING: {
+                Common_Message pong = create_ping(Low_Level::PONG, msg->low_level().time());
+                send_buffer_tcp(socket, &pong);
+                return true;
+            }
+            case Low_Level::PONG:
+                update_ping(&connection, msg->low_level().time(), ping_time_now());
+                return true;
         }
     }
 
@@ -600,37 +747,52 @@ bool Networking::handle_tcp(Common_Message *msg, struct TCP_Socket &socket)
     return true;
 }
 
-struct Connection *Networking::find_connection(CSteamID search_id, uint32 appid)
+void Networking::handle_udp(Common_Message *msg, IP_PORT ip_port, uint64 received_time)
 {
-    if (appid) {
-        auto conn = std::find_if(connections.begin(), connections.end(), [&search_id, &appid](struct Connection const& conn) { 
-            if (conn.appid != appid) return false;
+    if (!msg->source_id()) return;
 
-            for (auto &id: conn.ids) {
-                if (search_id == id) {
-                    return true;
-                }
-            }
+    ++messages_received;
+    if (msg->has_announce()) {
+        handle_announce(msg, ip_port);
+    } else if (msg->has_low_level()) {
+        handle_low_level_udp(msg, ip_port, received_time);
+    } else {
+        msg->set_source_ip(ntohl(ip_port.ip));
+        msg->set_source_port(ntohs(ip_port.port));
+        do_callbacks_message(msg);
+    }
+}
 
-            return false;
-        });
+void Networking::index_connection_id(struct Connection *connection, CSteamID steam_id)
+{
+    connection_ids[steam_id.ConvertToUint64()].push_back(connection);
+}
 
-        if (connections.end() != conn)
-            return &(*conn);
-    }
+void Networking::unindex_connection_id(struct Connection *connection, CSteamID steam_id)
+{
+    auto index = connection_ids.find(steam_id.ConvertToUint64());
+    if (index == connection_ids.end()) return;
 
-    auto conn = std::find_if(connections.begin(), connections.end(), [&search_id](struct Connection const& conn) { 
-        for (auto &id: conn.ids) {
-            if (search_id == id) {
-                return true;
-            }
-        }
+    auto &conns = index->second;
+    auto c = std::find(conns.begin(), conns.end(), connection);
+    if (c != conns.end()) conns.erase(c);
+    if (conns.empty()) connection_ids.erase(index);
+}
 
-        return false;
-    });
+struct Connection *Networking::find_connection(CSteamID search_id, uint32 appid)
+{
+    auto index = connection_ids.find(search_id.ConvertToUint64());
+    if (index == connection_ids.end()) return NULL;
 
-    if (connections.end() != conn)
-        return &(*conn);
+    auto &conns = index->second;
+    if (appid) {
+        auto conn = std::find_if(conns.begin(), conns.end(), [&appid](struct Connection const *conn) { return conn->appid == appid; });
+        if (conns.end() != conn)
+            return *conn;
+    }
+
+    if (conns.size())
+        return conns.front();
 
     return NULL;
 }
@@ -644,6 +806,7 @@ bool Networking::add_id_connection(struct Connection *connection, CSteamID steam
         return false;
 
     connection->ids.push_back(steam_id);
+    index_connection_id(connection, steam_id);
     if (connection->connected) {
         run_callback_user(steam_id, true, connection->appid);
     }
@@ -662,7 +825,8 @@ struct Connection *Networking::new_connection(CSteamID search_id, uint32 appid)
     connection.last_received = std::chrono::high_resolution_clock::now();
 
     connections.push_back(connection);
-    return &(connections[connections.size() - 1]);
+    index_connection_id(&connections.back(), search_id);
+    return &connections.back();
 }
 
 bool Networking::handle_announce(Common_Message *msg, IP_PORT ip_port)
@@ -733,7 +897,7 @@ bool Networking::handle_announce(Common_Message *msg, IP_PORT ip_port)
     return true;
 }
 
-bool Networking::handle_low_level_udp(Common_Message *msg, IP_PORT ip_port)
+bool Networking::handle_low_level_udp(Common_Message *msg, IP_PORT ip_port, uint64 received_time)
 {
     //TODO: connection appid
     struct Connection *connection = find_connection((uint64)msg->source_id());
@@ -747,6 +911,12 @@ bool Networking::handle_low_level_udp(Common_Message *msg, IP_PORT ip_port)
         case Low_Level::HEARTBEAT:
             
             break;
+        case Low_Level::PING:
+            send_pong(msg, ip_port);
+            return true;
+        case Low_Level::PONG:
+            update_ping(connection, msg->low_level().time(), received_time);
+            return true;
     }
 
     return false;
@@ -845,12 +1015,15 @@ Networking::Networking(CSteamID id, uint32 appid, uint16 port, std::set<IP_PORT>
     }
 
     ids.push_back(id);
+    main_id = id.ConvertToUint64();
 
     reset_last_error();
 }
 
 Networking::~Networking()
 {
+    stopThread();
+
     for (auto &c : connections) {
         kill_tcp_socket(c.tcp_socket_incoming);
         kill_tcp_socket(c.tcp_socket_outgoing);
@@ -862,6 +1035,7 @@ Networking::~Networking()
 
     kill_socket(udp_socket);
     kill_socket(tcp_socket);
+    closeQuerySocket();
 }
 
 Common_Message Networking::create_announce(bool request)
@@ -907,7 +1081,7 @@ void Networking::send_announce_broadcasts()
 
     delete[] buffer;
     last_broadcast = std::chrono::high_resolution_clock::now();
-    PRINT_DEBUG("Networking:: sent broadcasts\n");
+    PRINT_DEBUG("Networking:: sent broadcasts, received %llu messages, %llu heap allocations for them (%f per message)\n", getMessagesReceived(), getMessageAllocations(), getMessagesReceived() ? (double)getMessageAllocations() / getMessagesReceived() : 0.0);
 }
 
 void Networking::Run()
@@ -922,40 +1096,53 @@ void Networking::Run()
 
     //PRINT_DEBUG("Networking::Run() %lf\n", time_extra);
     PRINT_DEBUG("Networking::Run()\n");
+    flush_udp();
     if (check_timedout(last_broadcast, BROADCAST_INTERVAL)) {
         send_announce_broadcasts();
     }
 
     IP_PORT ip_port;
-    char data[MAX_UDP_SIZE];
-    int len;
+    alignas(8) char arena_block[MESSAGE_ARENA_START_BLOCK];
+    google::protobuf::Arena arena(message_arena_options(arena_block, sizeof(arena_block)));
 
-    PRINT_DEBUG("RECV UDP\n");
-    while((len = receive_packet(udp_socket, &ip_port, data, sizeof(data))) >= 0) {
-        PRINT_DEBUG("recv %i %hhu.%hhu.%hhu.%hhu:%hu\n", len, ((unsigned char *)&ip_port.ip)[0], ((unsigned char *)&ip_port.ip)[1], ((unsigned char *)&ip_port.ip)[2], ((unsigned char *)&ip_port.ip)[3], htons(ip_port.port));
-        Common_Message msg;
-        if (msg.ParseFromArray(data, len)) {
-            if (msg.source_id()) {
-                if (msg.has_announce()) {
-                    handle_announce(&msg, ip_port);
-                } else
-
-                if (msg.has_low_level()) {
-                    handle_low_level_udp(&msg, ip_port);
-                } else
-
-                {
-                    msg.set_source_ip(ntohl(ip_port.ip));
-                    msg.set_source_port(ntohs(ip_port.port));
-                    do_callbacks_message(&msg);
+    {
+        PRINT_DEBUG("RECV UDP INBOUND\n");
+        std::vector<struct Inbound_Batch> inbound;
+        {
+            std::lock_guard<std::mutex> lock(inbound_mutex);
+            inbound.swap(inbound_udp);
+        }
+
+        for (auto &b: inbound) {
+            for (auto &p: b.packets) {
+                handle_udp(p.msg, p.ip_port, p.received_time);
+            }
+        }
+    }
+
+    if (!network_thread_running) {
+        int count;
+
+        PRINT_DEBUG("RECV UDP\n");
+        while((count = receive_packets(udp_socket, udp_batch)) > 0) {
+            uint64 received_time = ping_time_now();
+            for (int i = 0; i < count; ++i) {
+                int len = udp_batch.lengths[i];
+                ip_port = udp_batch.ip_ports[i];
+                PRINT_DEBUG("recv %i %hhu.%hhu.%hhu.%hhu:%hu\n", len, ((unsigned char *)&ip_port.ip)[0], ((unsigned char *)&ip_port.ip)[1], ((unsigned char *)&ip_port.ip)[2], ((unsigned char *)&ip_port.ip)[3], htons(ip_port.port));
+                Common_Message *msg = google::protobuf::Arena::CreateMessage<Common_Message>(&arena);
+                if (msg->ParseFromArray(udp_batch.packet(i), len)) {
+                    handle_udp(msg, ip_port, received_time);
                 }
             }
         }
     }
 
+    receive_queries();
+
     PRINT_DEBUG("RECV LOCAL\n");
-    std::vector<Common_Message> local_send_copy = local_send;
-    local_send.clear();
+    std::vector<Common_Message> local_send_copy;
+    local_send_copy.swap(local_send);
 
     for (auto & m: local_send_copy) {
         m.set_source_ip(ntohl(own_ip));
@@ -989,7 +1176,8 @@ void Networking::Run()
             socket.sock = sock;
             socket.received_data = true;
             socket.last_heartbeat_received = std::chrono::high_resolution_clock::now();
-            accepted.push_back(socket);
+            watch_socket(sock);
+            accepted.push_back(std::move(socket));
             PRINT_DEBUG("TCP ACCEPTED %u\n", sock);
         }
     }
@@ -1005,7 +1193,7 @@ void Networking::Run()
                 Connection *connection = find_connection((uint64)msg.source_id());
                 if (connection) {
                     kill_tcp_socket(connection->tcp_socket_incoming);
-                    connection->tcp_socket_incoming = *conn;
+                    connection->tcp_socket_incoming = std::move(*conn);
                     conn = accepted.erase(conn);
                     deleted = true;
                     PRINT_DEBUG("TCP REPLACED\n");
@@ -1041,6 +1229,7 @@ void Networking::Run()
                 PRINT_DEBUG("NEW SOCKET %u %u\n", sock, conn.tcp_socket_outgoing.sock);
                 disable_nagle(sock);
                 connect_socket(sock, conn.tcp_ip_port);
+                watch_socket(sock);
                 conn.tcp_socket_outgoing.sock = sock;
                 conn.tcp_socket_outgoing.last_heartbeat_received = std::chrono::high_resolution_clock::now();
                 Common_Message msg;
@@ -1057,14 +1246,19 @@ void Networking::Run()
             if (!conn.connected) {
                 //reconnect the connection if it has the right appid
                 if (conn.appid == this->appid || conn.appid == LOBBY_CONNECT_APPID) {
-                    for (auto &c: connections) {
-                        if (&c == &conn) continue;
-                        if (c.appid != this->appid) continue;
-                        for (auto &steam_id : conn.ids) {
-                            auto i = std::find(c.ids.begin(), c.ids.end(), steam_id);
-                            if (i != c.ids.end()) {
-                                c.ids.erase(i);
-                                run_callback_user(steam_id, false, c.appid);
+                    for (auto &steam_id : conn.ids) {
+                        auto index = connection_ids.find(steam_id.ConvertToUint64());
+                        if (index == connection_ids.end()) continue;
+
+                        std::vector<struct Connection *> others = index->second;
+                        for (auto c: others) {
+                            if (c == &conn) continue;
+                            if (c->appid != this->appid) continue;
+                            auto i = std::find(c->ids.begin(), c->ids.end(), steam_id);
+                            if (i != c->ids.end()) {
+                                c->ids.erase(i);
+                                unindex_connection_id(c, steam_id);
+                                run_callback_user(steam_id, false, c->appid);
                                 PRINT_DEBUG("REMOVE OLD CONNECTION ID\n");
                             }
                         }
@@ -1082,25 +1276,26 @@ void Networking::Run()
         send_tcp_pending(conn.tcp_socket_incoming);
 
         PRINT_DEBUG("RUN SOCKET3 %u %u\n", conn.tcp_socket_outgoing.sock, conn.tcp_socket_incoming.sock);
-        Common_Message msg;
-        while (unbuffer_tcp(conn.tcp_socket_outgoing, &msg)) {
-            PRINT_DEBUG("UNBUFFER SOCKET\n");
-            msg.set_source_ip(ntohl(conn.tcp_ip_port.ip)); //TODO: get from tcp socket
-            handle_tcp(&msg, conn.tcp_socket_outgoing);
-            conn.last_received = std::chrono::high_resolution_clock::now();
-        }
-
-        while (unbuffer_tcp(conn.tcp_socket_incoming, &msg)) {
-            PRINT_DEBUG("UNBUFFER SOCKET\n");
-            msg.set_source_ip(ntohl(conn.tcp_ip_port.ip)); //TODO: get from tcp socket
-            handle_tcp(&msg, conn.tcp_socket_incoming);
-            conn.last_received = std::chrono::high_resolution_clock::now();
+        //messages are only created when a whole one is buffered, idle connections don't touch the arena
+        for (struct TCP_Socket *socket : {&conn.tcp_socket_outgoing, &conn.tcp_socket_incoming}) {
+            while (peek_buffer_tcp(*socket)) {
+                Common_Message *msg = google::protobuf::Arena::CreateMessage<Common_Message>(&arena);
+                if (!unbuffer_tcp(*socket, msg)) break;
+                PRINT_DEBUG("UNBUFFER SOCKET\n");
+                msg->set_source_ip(ntohl(conn.tcp_ip_port.ip)); //TODO: get from tcp socket
+                handle_tcp(msg, *socket, conn);
+                conn.last_received = std::chrono::high_resolution_clock::now();
+            }
         }
 
         PRINT_DEBUG("RUN SOCKET4 %u %u\n", conn.tcp_socket_outgoing.sock, conn.tcp_socket_incoming.sock);
         socket_timeouts(conn.tcp_socket_outgoing, time_extra);
         socket_timeouts(conn.tcp_socket_incoming, time_extra);
 
+        if (conn.connected && check_timedout(conn.last_ping_sent, PING_RATE)) {
+            send_pings(conn);
+        }
+
     }
 
     {
@@ -1110,6 +1305,7 @@ void Networking::Run()
                 if (conn->connected) for (auto &steam_id : conn->ids) run_callback_user(steam_id, false, conn->appid);
                 kill_tcp_socket(conn->tcp_socket_outgoing);
                 kill_tcp_socket(conn->tcp_socket_incoming);
+                for (auto &steam_id : conn->ids) unindex_connection_id(&(*conn), steam_id);
                 conn = connections.erase(conn);
                 PRINT_DEBUG("USER TIMEOUT\n");
             } else {
@@ -1125,9 +1321,151 @@ void Networking::Run()
         }
     }
 
+    flush_udp();
     reset_last_error();
 }
 
+#define NETWORK_THREAD_WAIT_MS 100
+
+void Networking::watch_socket(sock_t sock)
+{
+#if defined(__LINUX__)
+    if (epoll_fd < 0) return;
+
+    //edge triggered so that sockets Run() leaves alone (ex: closed by the peer) don't make the thread spin
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = sock;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev);
+#endif
+}
+
+bool Networking::wait_sockets_ready(unsigned timeout_ms)
+{
+#if defined(__LINUX__)
+    struct epoll_event events[32];
+    int n = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(*events), timeout_ms);
+    return n > 0;
+#else
+    //windows xp has no WSAPoll, tcp sockets still get serviced by the other Run() callers
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(udp_socket, &read_fds);
+    FD_SET(tcp_socket, &read_fds);
+    sock_t max_socket = std::max(udp_socket, tcp_socket);
+    if (is_socket_valid(query_socket)) {
+        FD_SET(query_socket, &read_fds);
+        max_socket = std::max(max_socket, query_socket);
+    }
+
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = timeout_ms * 1000;
+    int n = select(max_socket + 1, &read_fds, NULL, NULL, &tv);
+    return n > 0;
+#endif
+}
+
+void Networking::receive_udp_inbound(struct UDP_Batch &udp)
+{
+    int count;
+
+    struct Inbound_Batch batch;
+    while((count = receive_packets(udp_socket, udp)) > 0) {
+        if (!batch.arena) batch.arena.reset(new google::protobuf::Arena(message_arena_options()));
+
+        uint64 received_time = ping_time_now();
+        for (int i = 0; i < count; ++i) {
+            struct Inbound_Packet packet;
+            packet.msg = google::protobuf::Arena::CreateMessage<Common_Message>(batch.arena.get());
+            if (packet.msg->ParseFromArray(udp.packet(i), udp.lengths[i]) && packet.msg->source_id()) {
+                //answered right away instead of waiting for global_mutex and Run()
+                if (packet.msg->has_low_level() && packet.msg->low_level().type() == Low_Level::PING) {
+                    send_pong(packet.msg, udp.ip_ports[i]);
+                    continue;
+                }
+
+                packet.ip_port = udp.ip_ports[i];
+                packet.received_time = received_time;
+                batch.packets.push_back(packet);
+            }
+        }
+    }
+
+    if (batch.packets.size()) {
+        std::lock_guard<std::mutex> lock(inbound_mutex);
+        inbound_udp.push_back(std::move(batch));
+    }
+}
+
+void Networking::network_thread_proc()
+{
+    PRINT_DEBUG("network thread starting\n");
+    struct UDP_Batch udp;
+    while (network_thread_running) {
+        //queued sends are flushed by Run() when a socket is ready, otherwise once their deadline passes
+        bool ready = wait_sockets_ready(udp_send_pending.load(std::memory_order_relaxed) ? UDP_FLUSH_DELAY_MS : NETWORK_THREAD_WAIT_MS);
+        if (!network_thread_running) break;
+        if (!ready) {
+            if (udp_send_pending.load(std::memory_order_relaxed)) {
+                global_mutex.lock();
+                flushUDPIfDue();
+                global_mutex.unlock();
+            }
+
+            continue;
+        }
+
+        receive_udp_inbound(udp);
+        global_mutex.lock();
+        Run();
+        global_mutex.unlock();
+    }
+
+    PRINT_DEBUG("network thread exit\n");
+}
+
+void Networking::startThread()
+{
+    if (!enabled || network_thread.joinable()) return;
+
+#if defined(__LINUX__)
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        PRINT_DEBUG("network thread: epoll_create1 failed\n");
+        return;
+    }
+
+    watch_socket(udp_socket);
+    watch_socket(tcp_socket);
+    if (is_socket_valid(query_socket)) watch_socket(query_socket);
+    for (auto &c : connections) {
+        if (is_tcp_socket_valid(c.tcp_socket_outgoing)) watch_socket(c.tcp_socket_outgoing.sock);
+        if (is_tcp_socket_valid(c.tcp_socket_incoming)) watch_socket(c.tcp_socket_incoming.sock);
+    }
+
+    for (auto &c : accepted) {
+        watch_socket(c.sock);
+    }
+#endif
+
+    network_thread_running = true;
+    network_thread = std::thread(&Networking::network_thread_proc, this);
+}
+
+void Networking::stopThread()
+{
+    if (!network_thread.joinable()) return;
+
+    network_thread_running = false;
+    network_thread.join();
+
+#if defined(__LINUX__)
+    close(epoll_fd);
+    epoll_fd = -1;
+#endif
+}
+
 void Networking::addListenId(CSteamID id)
 {
     if (!enabled) return;
@@ -1153,18 +1491,79 @@ bool Networking::sendToIPPort(Common_Message *msg, uint32 ip, uint16 port, bool
     uint32_t local_ip = getIP(ids.front());
     PRINT_DEBUG("sendToIPPort %X %u %X\n", ip, is_local_ip, local_ip);
     //TODO: actually send to ip/port
+    struct Fanout_Message fanout;
     for (auto &conn: connections) {
         if (ntohl(conn.tcp_ip_port.ip) == ip || (is_local_ip && ntohl(conn.tcp_ip_port.ip) == local_ip)) {
+            if (fanout.buffer.empty()) prepare_fanout(msg, fanout);
             for (auto &steam_id : conn.ids) {
                 msg->set_dest_id(steam_id.ConvertToUint64());
-                sendTo(msg, reliable, &conn);
+                send_fanout(fanout, steam_id, reliable, &conn);
             }
         }
     }
 
+    reset_last_error();
     return true;
 }
 
+bool Networking::openQuerySocket(uint16 port, void (*query_callback)(void *object, const char *data, unsigned length, uint32 ip, uint16 port, std::vector<std::string> &replies), void *object)
+{
+    if (!enabled) return false;
+    closeQuerySocket();
+
+    sock_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    PRINT_DEBUG("Query socket: %u port: %hu\n", sock, port);
+    if (!is_socket_valid(sock)) return false;
+    if (!set_socket_nonblocking(sock) || !bind_socket(sock, port)) {
+        PRINT_DEBUG("Query socket: could not bind %i\n", get_last_error());
+        kill_socket(sock);
+        reset_last_error();
+        return false;
+    }
+
+    query_socket = sock;
+    this->query_callback = query_callback;
+    query_callback_object = object;
+    watch_socket(query_socket);
+    return true;
+}
+
+void Networking::closeQuerySocket()
+{
+    if (!is_socket_valid(query_socket)) return;
+    kill_socket(query_socket);
+    query_socket = ~0;
+    query_callback = NULL;
+    query_callback_object = NULL;
+}
+
+void Networking::receive_queries()
+{
+    if (!is_socket_valid(query_socket)) return;
+
+    char data[MAX_UDP_SIZE];
+    IP_PORT ip_port;
+    int len;
+    std::vector<std::string> replies;
+    while ((len = receive_packet(query_socket, &ip_port, data, sizeof(data))) >= 0) {
+        replies.clear();
+        query_callback(query_callback_object, data, len, ntohl(ip_port.ip), ntohs(ip_port.port), replies);
+        for (auto &r : replies) {
+            send_packet_to(query_socket, ip_port, &r[0], r.size());
+        }
+    }
+}
+
+int Networking::getPing(CSteamID id)
+{
+    Connection *conn = find_connection(id, this->appid);
+    if (conn && conn->ping >= 0) {
+        return (int)(conn->ping + 0.5);
+    }
+
+    return -1;
+}
+
 uint32 Networking::getIP(CSteamID id)
 {
     Connection *conn = find_connection(id, this->appid);
@@ -1207,10 +1606,9 @@ bool Networking::sendTo(Common_Message *msg, bool reliable, Connection *conn)
                 ret = true;
             }
         } else {
-            char *buffer = new char[size];
+            char buffer[MAX_UDP_SIZE];
             msg->SerializeToArray(buffer, size);
-            send_packet_to(udp_socket, conn->udp_ip_port, buffer, size);
-            delete[] buffer;
+            send_udp(conn->udp_ip_port, buffer, size);
             ret = true;
         }
     }
@@ -1219,29 +1617,187 @@ bool Networking::sendTo(Common_Message *msg, bool reliable, Connection *conn)
     return ret;
 }
 
+#if defined(__LINUX__)
+//on linux unreliable packets are queued and sent with sendmmsg when a batch is full, by Run() or
+//by flushUDPIfDue() once the first one waited UDP_FLUSH_DELAY_MS
+void Networking::send_udp(IP_PORT ip_port, char *data, size_t length)
+{
+    if (udp_send_queue.empty()) {
+        udp_send_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(UDP_FLUSH_DELAY_MS);
+        udp_send_pending.store(true, std::memory_order_relaxed);
+        if (udp_queued_callback) udp_queued_callback(udp_queued_callback_object);
+    }
+
+    struct UDP_Queued_Packet packet;
+    packet.ip_port = ip_port;
+    packet.offset = udp_send_data.size();
+    packet.length = length;
+    udp_send_data.insert(udp_send_data.end(), data, data + length);
+    udp_send_queue.push_back(packet);
+
+    if (udp_send_queue.size() >= UDP_BATCH_SIZE) {
+        flush_udp();
+    }
+}
+
+void Networking::flush_udp()
+{
+    if (udp_send_queue.empty()) return;
+
+    struct mmsghdr msgs[UDP_BATCH_SIZE];
+    struct iovec iovecs[UDP_BATCH_SIZE];
+    struct sockaddr_in addrs[UDP_BATCH_SIZE];
+    size_t sent = 0;
+    while (sent < udp_send_queue.size()) {
+        unsigned count = std::min(udp_send_queue.size() - sent, (size_t)UDP_BATCH_SIZE);
+        memset(msgs, 0, sizeof(msgs));
+        memset(addrs, 0, sizeof(addrs));
+        for (unsigned i = 0; i < count; ++i) {
+            struct UDP_Queued_Packet &packet = udp_send_queue[sent + i];
+            addrs[i].sin_family = AF_INET;
+            addrs[i].sin_addr.s_addr = packet.ip_port.ip;
+            addrs[i].sin_port = packet.ip_port.port;
+            iovecs[i].iov_base = &(udp_send_data[packet.offset]);
+            iovecs[i].iov_len = packet.length;
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+
+        int ret = sendmmsg(udp_socket, msgs, count, MSG_NOSIGNAL);
+        PRINT_DEBUG("sendmmsg %u %i\n", count, ret);
+        //unreliable so if the socket buffer is full the rest is dropped like a failed sendto would
+        if (ret <= 0) break;
+        sent += ret;
+    }
+
+    udp_send_data.clear();
+    udp_send_queue.clear();
+    udp_send_pending.store(false, std::memory_order_relaxed);
+}
+
+int Networking::flushUDPIfDue()
+{
+    if (udp_send_queue.empty()) return -1;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < udp_send_deadline) {
+        //rounded up so that the caller doesn't wake up just before the deadline
+        return std::chrono::duration_cast<std::chrono::milliseconds>(udp_send_deadline - now).count() + 1;
+    }
+
+    flush_udp();
+    return -1;
+}
+#else
+void Networking::send_udp(IP_PORT ip_port, char *data, size_t length)
+{
+    send_packet_to(udp_socket, ip_port, data, length);
+}
+
+void Networking::flush_udp()
+{
+}
+
+int Networking::flushUDPIfDue()
+{
+    return -1;
+}
+#endif
+
+void Networking::setUDPQueuedCallback(void (*udp_queued_callback)(void *object), void *object)
+{
+    this->udp_queued_callback = udp_queued_callback;
+    this->udp_queued_callback_object = object;
+}
+
+#define FANOUT_DEST_ID_MAX_SIZE 16
+
+static size_t write_varint(char *out, uint64 value)
+{
+    size_t i = 0;
+    while (value >= 0x80) {
+        out[i++] = (char)(value | 0x80);
+        value >>= 7;
+    }
+
+    out[i++] = (char)value;
+    return i;
+}
+
+//The message is serialized once without its dest_id. Each destination gets the dest_id field appended
+//to the end of that body: protobuf keeps the last value of a scalar field so it parses like a normal message.
+void Networking::prepare_fanout(Common_Message *msg, struct Fanout_Message &fanout)
+{
+    uint64 dest_id = msg->dest_id();
+    msg->clear_dest_id();
+    fanout.body_size = msg->ByteSizeLong();
+    fanout.buffer.resize(fanout.body_size + FANOUT_DEST_ID_MAX_SIZE);
+    msg->SerializeToArray(fanout.buffer.data(), fanout.body_size);
+    msg->set_dest_id(dest_id);
+}
+
+bool Networking::send_fanout(struct Fanout_Message &fanout, CSteamID dest_id, bool reliable, Connection *conn)
+{
+    if (!enabled) return false;
+
+    char *dest = fanout.buffer.data() + fanout.body_size;
+    size_t dest_size = write_varint(dest, (Common_Message::kDestIdFieldNumber << 3) | 0);
+    dest_size += write_varint(dest + dest_size, dest_id.ConvertToUint64());
+    size_t size = fanout.body_size + dest_size;
+    if (size >= MAX_UDP_SIZE) reliable = true; //too big for UDP
+
+    bool ret = false;
+    if (reliable || !conn->udp_pinged) {
+        if (conn->tcp_socket_incoming.received_data) {
+            send_buffer_tcp(conn->tcp_socket_incoming, fanout.buffer.data(), size);
+            ret = true;
+        } else if (conn->tcp_socket_outgoing.received_data) {
+            send_buffer_tcp(conn->tcp_socket_outgoing, fanout.buffer.data(), size);
+            ret = true;
+        }
+    } else {
+        send_udp(conn->udp_ip_port, fanout.buffer.data(), size);
+        ret = true;
+    }
+
+    return ret;
+}
+
 bool Networking::sendToAllIndividuals(Common_Message *msg, bool reliable)
 {
+    if (connections.empty()) return true;
+
+    struct Fanout_Message fanout;
+    prepare_fanout(msg, fanout);
     for (auto &conn: connections) {
         for (auto &steam_id : conn.ids) {
             if (steam_id.BIndividualAccount()) {
                 msg->set_dest_id(steam_id.ConvertToUint64());
-                sendTo(msg, reliable, &conn);
+                send_fanout(fanout, steam_id, reliable, &conn);
             }
         }
     }
 
+    reset_last_error();
     return true;
 }
 
 bool Networking::sendToAll(Common_Message *msg, bool reliable)
 {
+    if (connections.empty()) return true;
+
+    struct Fanout_Message fanout;
+    prepare_fanout(msg, fanout);
     for (auto &conn: connections) {
         for (auto &steam_id : conn.ids) {
             msg->set_dest_id(steam_id.ConvertToUint64());
-            sendTo(msg, reliable, &conn);
+            send_fanout(fanout, steam_id, reliable, &conn);
         }
     }
 
+    reset_last_error();
     return true;
 }
 
@@ -1288,3 +1844,13 @@ uint32 Networking::getOwnIP()
 {
     return own_ip;
 }
+
+uint64 Networking::getMessagesReceived()
+{
+    return messages_received;
+}
+
+uint64 Networking::getMessageAllocations()
+{
+    return message_arena_blocks;
+}
@@ -29,6 +29,12 @@ inline bool protobuf_message_equal(const google::protobuf::MessageLite& msg_a,
 
 #define DEFAULT_PORT 47584
 
+#define MAX_UDP_SIZE 16384
+//number of udp packets received (recvmmsg) or sent (sendmmsg) with one call
+#define UDP_BATCH_SIZE 16
+//longest time an unreliable packet waits in the send queue for others to share its sendmmsg
+#define UDP_FLUSH_DELAY_MS 1
+
 #if defined(STEAM_WIN32)
 typedef unsigned int sock_t;
 #else
@@ -69,14 +75,82 @@ struct Network_Callback_Container {
     std::vector<struct Network_Callback> callbacks;
 };
 
+//byte buffer that is consumed from the front without moving the remaining data every time
+//the dead space at the front is only reclaimed once it is at least as big as the live data
+struct TCP_Buffer {
+    std::vector<char> buffer;
+    size_t head = 0, tail = 0;
+
+    size_t size() const { return tail - head; }
+    char *data() { return buffer.data() + head; }
+
+    char *reserve(size_t len) {
+        if (buffer.size() - tail < len) {
+            if (head && head >= size()) {
+                memmove(buffer.data(), buffer.data() + head, size());
+                tail -= head;
+                head = 0;
+            }
+
+            if (buffer.size() - tail < len) {
+                buffer.resize(std::max(buffer.size() * 2, tail + len));
+            }
+        }
+
+        return buffer.data() + tail;
+    }
+
+    void commit(size_t len) {
+        tail += len;
+    }
+
+    void consume(size_t len) {
+        head += len;
+        if (head >= tail) head = tail = 0;
+    }
+};
+
 struct TCP_Socket {
     sock_t sock = ~0;
     bool received_data = false;
-    std::vector<char> recv_buffer;
-    std::vector<char> send_buffer;
+    TCP_Buffer recv_buffer;
+    TCP_Buffer send_buffer;
     std::chrono::high_resolution_clock::time_point last_heartbeat_sent, last_heartbeat_received;
 };
 
+struct Inbound_Packet {
+    Common_Message *msg;
+    IP_PORT ip_port;
+    //when the packet was read, so that a pong handled later by Run() still measures the real round trip
+    uint64 received_time;
+};
+
+//udp packets drained by the network thread in one go, the messages live in the arena
+struct Inbound_Batch {
+    std::unique_ptr<google::protobuf::Arena> arena;
+    std::vector<struct Inbound_Packet> packets;
+};
+
+struct UDP_Batch {
+    std::vector<char> data;
+    IP_PORT ip_ports[UDP_BATCH_SIZE];
+    int lengths[UDP_BATCH_SIZE];
+
+    char *packet(unsigned index) { return &(data[index * MAX_UDP_SIZE]); }
+};
+
+struct UDP_Queued_Packet {
+    IP_PORT ip_port;
+    size_t offset;
+    size_t length;
+};
+
+//message serialized once for sending to many peers, see Networking::prepare_fanout
+struct Fanout_Message {
+    std::vector<char> buffer;
+    size_t body_size = 0;
+};
+
 struct Connection {
     struct TCP_Socket tcp_socket_outgoing, tcp_socket_incoming;
     bool connected = false;
@@ -86,6 +160,9 @@ struct Connection {
     std::vector<CSteamID> ids;
     uint32 appid;
     std::chrono::high_resolution_clock::time_point last_received;
+    std::chrono::high_resolution_clock::time_point last_ping_sent;
+    //smoothed round trip time in ms from PING/PONG over udp and tcp, negative until the first PONG
+    double ping = -1.0;
 };
 
 class Networking {
@@ -94,16 +171,29 @@ class Networking {
     sock_t udp_socket, tcp_socket;
     uint16 udp_port, tcp_port;
     uint32 own_ip;
-    std::vector<struct Connection> connections;
+    //list so that Connection pointers stay valid when other connections get removed
+    std::list<struct Connection> connections;
+    //steam id -> connections that have this id, kept in sync with Connection::ids
+    std::unordered_map<uint64, std::vector<struct Connection *>> connection_ids;
     struct Connection *find_connection(CSteamID id, uint32 appid = 0);
     struct Connection *new_connection(CSteamID id, uint32 appid);
+    void index_connection_id(struct Connection *connection, CSteamID steam_id);
+    void unindex_connection_id(struct Connection *connection, CSteamID steam_id);
 
     bool handle_announce(Common_Message *msg, IP_PORT ip_port);
-    bool handle_low_level_udp(Common_Message *msg, IP_PORT ip_port);
-    bool handle_tcp(Common_Message *msg, struct TCP_Socket &socket);
+    bool handle_low_level_udp(Common_Message *msg, IP_PORT ip_port, uint64 received_time);
+    bool handle_tcp(Common_Message *msg, struct TCP_Socket &socket, struct Connection &connection);
+    void handle_udp(Common_Message *msg, IP_PORT ip_port, uint64 received_time);
     void send_announce_broadcasts();
+    Common_Message create_ping(Low_Level::Types type, uint64 time);
+    void send_pings(struct Connection &connection);
+    //pings and pongs skip the udp send batch so that the round trip doesn't include the time until the next flush
+    void send_pong(Common_Message *ping, IP_PORT ip_port);
+    void update_ping(struct Connection *connection, uint64 time, uint64 received_time);
 
     std::vector<CSteamID> ids;
+    //ids[0], never changes so the network thread can read it without global_mutex
+    uint64 main_id;
     uint32 appid;
     std::chrono::high_resolution_clock::time_point last_broadcast;
     std::vector<IP_PORT> custom_broadcasts;
@@ -114,12 +204,48 @@ class Networking {
     struct Network_Callback_Container callbacks[CALLBACK_IDS_MAX];
     std::vector<Common_Message> local_send;
 
+    struct UDP_Batch udp_batch;
+    //unreliable packets waiting to be sent in one go by flush_udp()
+    std::vector<char> udp_send_data;
+    std::vector<struct UDP_Queued_Packet> udp_send_queue;
+    std::chrono::steady_clock::time_point udp_send_deadline;
+    //read by the network thread without global_mutex to know how long it can wait
+    std::atomic<bool> udp_send_pending{false};
+    void (*udp_queued_callback)(void *object) = NULL;
+    void *udp_queued_callback_object = NULL;
+    void send_udp(IP_PORT ip_port, char *data, size_t length);
+    void flush_udp();
+
+    //number of received messages dispatched, used with the arena block count to check allocations per message
+    uint64 messages_received = 0;
+
     bool add_id_connection(struct Connection *connection, CSteamID steam_id);
     void run_callbacks(Callback_Ids id, Common_Message *msg);
     void run_callback_user(CSteamID steam_id, bool online, uint32 appid);
     void do_callbacks_message(Common_Message *msg);
 
+    void prepare_fanout(Common_Message *msg, struct Fanout_Message &fanout);
+    bool send_fanout(struct Fanout_Message &fanout, CSteamID dest_id, bool reliable, Connection *conn);
+
     Common_Message create_announce(bool request);
+
+    //optional dedicated network thread, wakes up on socket readiness instead of waiting for Run()
+    std::thread network_thread;
+    std::atomic<bool> network_thread_running{false};
+    std::mutex inbound_mutex;
+    std::vector<struct Inbound_Batch> inbound_udp;
+#if defined(__LINUX__)
+    int epoll_fd = -1;
+#endif
+    void watch_socket(sock_t sock);
+    //udp socket for packets that are not emu messages (ex: source engine queries on a game server query port)
+    sock_t query_socket = ~0;
+    void (*query_callback)(void *object, const char *data, unsigned length, uint32 ip, uint16 port, std::vector<std::string> &replies) = NULL;
+    void *query_callback_object = NULL;
+    void receive_queries();
+    bool wait_sockets_ready(unsigned timeout_ms);
+    void receive_udp_inbound(struct UDP_Batch &batch);
+    void network_thread_proc();
 public:
     //NOTE: for all functions ips/ports are passed/returned in host byte order
     //ex: 127.0.0.1 should be passed as 0x7F000001
@@ -129,14 +255,31 @@ public:
     void addListenId(CSteamID id);
     void setAppID(uint32 appid);
     void Run();
+    void startThread();
+    void stopThread();
     bool sendTo(Common_Message *msg, bool reliable, Connection *conn = NULL);
     bool sendToAllIndividuals(Common_Message *msg, bool reliable);
     bool sendToAll(Common_Message *msg, bool reliable);
     bool sendToIPPort(Common_Message *msg, uint32 ip, uint16 port, bool reliable);
 
+    //unreliable packets are queued for up to UDP_FLUSH_DELAY_MS so that the ones sent together share a syscall.
+    //the callback is called when the first packet gets queued so that a thread can wake up to call flushUDPIfDue()
+    void setUDPQueuedCallback(void (*udp_queued_callback)(void *object), void *object);
+    //sends the queue if its deadline passed, returns the ms left until the next deadline or -1 if nothing is queued
+    int flushUDPIfDue();
+
+    //packets received on port are answered from Run() with the replies query_callback returns
+    bool openQuerySocket(uint16 port, void (*query_callback)(void *object, const char *data, unsigned length, uint32 ip, uint16 port, std::vector<std::string> &replies), void *object);
+    void closeQuerySocket();
+
     bool setCallback(Callback_Ids id, CSteamID steam_id, void (*message_callback)(void *object, Common_Message *msg), void *object);
     uint32 getIP(CSteamID id);
+    //round trip time in ms to the peer with this id, -1 if unknown
+    int getPing(CSteamID id);
     uint32 getOwnIP();
+    uint64 getMessagesReceived();
+    //heap allocations made to hold received messages (arena blocks beyond the one on the stack)
+    uint64 getMessageAllocations();
 };
 
 #endif
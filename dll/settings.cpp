@@ -108,10 +108,10 @@ void Settings::unlockAllDLC(bool value)
 
 void Settings::addDLC(AppId_t appID, std::string name, bool available)
 {
-    auto f = std::find_if(DLCs.begin(), DLCs.end(), [&appID](DLC_entry const& item) { return item.appID == appID; });
-    if (DLCs.end() != f) {
-        f->name = name;
-        f->available = available;
+    auto f = dlc_index.find(appID);
+    if (dlc_index.end() != f) {
+        DLCs[f->second].name = name;
+        DLCs[f->second].available = available;
         return;
     }
 
@@ -119,6 +119,7 @@ void Settings::addDLC(AppId_t appID, std::string name, bool available)
     new_entry.appID = appID;
     new_entry.name = name;
     new_entry.available = available;
+    dlc_index[appID] = DLCs.size();
     DLCs.push_back(new_entry);
 }
 
@@ -178,11 +179,11 @@ bool Settings::hasDLC(AppId_t appID)
 {
     if (this->unlockAllDLCs) return true;
 
-    auto f = std::find_if(DLCs.begin(), DLCs.end(), [&appID](DLC_entry const& item) { return item.appID == appID; });
-    if (DLCs.end() == f)
+    auto f = dlc_index.find(appID);
+    if (dlc_index.end() == f)
         return false;
 
-    return f->available;
+    return DLCs[f->second].available;
 }
 
 bool Settings::getDLC(unsigned int index, AppId_t &appID, bool &available, std::string &name)
@@ -224,3 +225,40 @@ int Settings::add_image(std::string data, uint32 width, uint32 height)
     images[last] = dt;
     return last;
 }
+
+int Settings::add_blank_image(uint32 width, uint32 height)
+{
+    int last = images.size() + 1;
+    struct Image_Data dt;
+    dt.width = width;
+    dt.height = height;
+    images[last] = dt;
+    return last;
+}
+
+int Settings::add_image_file(std::string path)
+{
+    int last = images.size() + 1;
+    struct Image_Data dt;
+    dt.path = path;
+    images[last] = dt;
+    return last;
+}
+
+struct Image_Data *Settings::get_image(int image)
+{
+    auto it = images.find(image);
+    if (it == images.end()) return NULL;
+
+    struct Image_Data *dt = &(it->second);
+    if (!dt->path.empty()) {
+        if (!Local_Storage::load_image_file(dt->path, dt->data, dt->width, dt->height)) {
+            PRINT_DEBUG("Settings::get_image failed to load %s\n", dt->path.c_str());
+        }
+
+        dt->path.clear();
+    }
+
+    if (!dt->width || !dt->height) return NULL;
+    return dt;
+}
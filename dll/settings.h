@@ -54,9 +54,12 @@ struct Stat_config {
 };
 
 struct Image_Data {
-    uint32 width;
-    uint32 height;
+    uint32 width = 0;
+    uint32 height = 0;
+    //RGBA pixels, empty for blank images which are all zeros
     std::string data;
+    //images added from a file are decoded the first time they are used
+    std::string path;
 };
 
 struct Controller_Settings {
@@ -73,7 +76,9 @@ class Settings {
 
     bool unlockAllDLCs;
     bool offline;
+    //DLCs keeps the order of DLC.txt for getDLC, dlc_index maps an appid to its position in it
     std::vector<struct DLC_entry> DLCs;
+    std::unordered_map<AppId_t, unsigned int> dlc_index;
     std::vector<struct Mod_entry> mods;
     std::map<AppId_t, std::string> app_paths;
     std::map<std::string, Leaderboard_config> leaderboards;
@@ -133,7 +138,7 @@ public:
     std::set<IP_PORT> custom_broadcasts;
 
     //stats
-    std::map<std::string, Stat_config> getStats() { return stats; }
+    const std::map<std::string, Stat_config> &getStats() { return stats; }
     void setStatDefiniton(std::string name, struct Stat_config stat_config) {stats[ascii_to_lowercase(name)] = stat_config; }
 
     //subscribed lobby/group ids
@@ -142,6 +147,9 @@ public:
     //images
     std::map<int, struct Image_Data> images;
     int add_image(std::string data, uint32 width, uint32 height);
+    int add_blank_image(uint32 width, uint32 height);
+    int add_image_file(std::string path);
+    struct Image_Data *get_image(int image);
 
     //controller
     struct Controller_Settings controller_settings;
@@ -149,6 +157,7 @@ public:
 
     //networking
     bool disable_networking = false;
+    bool network_thread = false;
 
     //overlay
     bool disable_overlay = false;
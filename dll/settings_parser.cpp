@@ -51,6 +51,204 @@ static void split_string(const std::string &s, char delim, Out result) {
     }
 }
 
+//reads a whole config file at once, returns false if it doesn't exist
+static bool load_config_lines(std::string path, std::vector<std::string> &lines)
+{
+    std::ifstream input( utf8_decode(path), std::ios::binary );
+    if (!input.is_open()) return false;
+
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    std::string data = buffer.str();
+
+    size_t position = 0;
+    if (data.size() >= 3 && data.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        position = 3;
+    }
+
+    while (position < data.size()) {
+        size_t end = data.find('\n', position);
+        if (end == std::string::npos) end = data.size();
+
+        std::string line = data.substr(position, end - position);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        lines.push_back(std::move(line));
+        position = end + 1;
+    }
+
+    return true;
+}
+
+static bool load_dlc_config(std::string path, std::vector<std::pair<AppId_t, std::string>> &dlcs)
+{
+    std::vector<std::string> lines;
+    if (!load_config_lines(path, lines)) return false;
+
+    for (auto &line : lines) {
+        if (!line.empty() && line.front() == '#') {
+            continue;
+        }
+
+        std::size_t deliminator = line.find("=");
+        if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
+            AppId_t appid = 0;
+            try {
+                appid = stol(line.substr(0, deliminator));
+            } catch (...) {}
+            std::string name = line.substr(deliminator + 1);
+
+            if (appid) {
+                PRINT_DEBUG("Adding DLC: %u|%s|\n", appid, name.c_str());
+                dlcs.emplace_back(appid, name);
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool load_app_paths_config(std::string config_path, std::string program_path, std::vector<std::pair<AppId_t, std::string>> &app_paths)
+{
+    std::vector<std::string> lines;
+    if (!load_config_lines(config_path, lines)) return false;
+
+    for (auto &line : lines) {
+        std::size_t deliminator = line.find("=");
+        if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
+            AppId_t appid = 0;
+            try {
+                appid = stol(line.substr(0, deliminator));
+            } catch (...) {}
+            std::string rel_path = line.substr(deliminator + 1);
+            std::string path = canonical_path(program_path + rel_path);
+
+            if (appid) {
+                if (path.size()) {
+                    PRINT_DEBUG("Adding app path: %u|%s|\n", appid, path.c_str());
+                    app_paths.emplace_back(appid, path);
+                } else {
+                    PRINT_DEBUG("Error adding app path for: %u does this path exist? |%s|\n", appid, rel_path.c_str());
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool load_leaderboards_config(std::string path, std::vector<std::pair<std::string, Leaderboard_config>> &leaderboards)
+{
+    std::vector<std::string> lines;
+    if (!load_config_lines(path, lines)) return false;
+
+    for (auto &line : lines) {
+        std::string leaderboard;
+        unsigned int sort_method = 0;
+        unsigned int display_type = 0;
+
+        std::size_t deliminator = line.find("=");
+        if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
+            leaderboard = line.substr(0, deliminator);
+            std::size_t deliminator2 = line.find("=", deliminator + 1);
+            if (deliminator2 != std::string::npos && deliminator2 != line.size()) {
+                try {
+                    sort_method = stol(line.substr(deliminator + 1, deliminator2 - (deliminator + 1)));
+                    display_type = stol(line.substr(deliminator2 + 1));
+                } catch (...) {}
+            }
+        }
+
+        if (leaderboard.size() && sort_method <= k_ELeaderboardSortMethodDescending && display_type <= k_ELeaderboardDisplayTypeTimeMilliSeconds) {
+            PRINT_DEBUG("Adding leaderboard: %s|%u|%u\n", leaderboard.c_str(), sort_method, display_type);
+            Leaderboard_config config;
+            config.sort_method = (ELeaderboardSortMethod)sort_method;
+            config.display_type = (ELeaderboardDisplayType)display_type;
+            leaderboards.emplace_back(leaderboard, config);
+        } else {
+            PRINT_DEBUG("Error adding leaderboard for: %s, are sort method %u or display type %u valid?\n", leaderboard.c_str(), sort_method, display_type);
+        }
+    }
+
+    return true;
+}
+
+static bool load_stats_config(std::string path, std::vector<std::pair<std::string, Stat_config>> &stats)
+{
+    std::vector<std::string> lines;
+    if (!load_config_lines(path, lines)) return false;
+
+    for (auto &line : lines) {
+        std::string stat_name;
+        std::string stat_type;
+        std::string stat_default_value;
+
+        std::size_t deliminator = line.find("=");
+        if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
+            stat_name = line.substr(0, deliminator);
+            std::size_t deliminator2 = line.find("=", deliminator + 1);
+
+            if (deliminator2 != std::string::npos && deliminator2 != line.size()) {
+                stat_type = line.substr(deliminator + 1, deliminator2 - (deliminator + 1));
+                stat_default_value = line.substr(deliminator2 + 1);
+            } else {
+                stat_type = line.substr(deliminator + 1);
+                stat_default_value = "0";
+            }
+        }
+
+        std::transform(stat_type.begin(), stat_type.end(), stat_type.begin(),[](unsigned char c){ return std::tolower(c); });
+        struct Stat_config config = {};
+
+        try {
+            if (stat_type == "float") {
+                config.type = Stat_Type::STAT_TYPE_FLOAT;
+                config.default_value_float = std::stof(stat_default_value);
+            } else if (stat_type == "int") {
+                config.type = Stat_Type::STAT_TYPE_INT;
+                config.default_value_int = std::stol(stat_default_value);
+            } else if (stat_type == "avgrate") {
+                config.type = Stat_Type::STAT_TYPE_AVGRATE;
+                config.default_value_float = std::stof(stat_default_value);
+            } else {
+                PRINT_DEBUG("Error adding stat %s, type %s isn't valid\n", stat_name.c_str(), stat_type.c_str());
+                continue;
+            }
+        } catch (...) {
+            PRINT_DEBUG("Error adding stat %s, default value %s isn't valid\n", stat_name.c_str(), stat_default_value.c_str());
+            continue;
+        }
+
+        if (stat_name.size()) {
+            PRINT_DEBUG("Adding stat type: %s|%u|%f|%u\n", stat_name.c_str(), config.type, config.default_value_float, config.default_value_int);
+            stats.emplace_back(stat_name, config);
+        } else {
+            PRINT_DEBUG("Error adding stat for: %s, empty name\n", stat_name.c_str());
+        }
+    }
+
+    return true;
+}
+
+//one number per line: depots.txt, subscribed_groups.txt
+static bool load_id_list_config(std::string path, std::vector<uint64> &ids)
+{
+    std::vector<std::string> lines;
+    if (!load_config_lines(path, lines)) return false;
+
+    for (auto &line : lines) {
+        try {
+            uint64 id = std::stoull(line);
+            ids.push_back(id);
+            PRINT_DEBUG("Added id %llu from %s\n", id, path.c_str());
+        } catch (...) {}
+    }
+
+    return true;
+}
+
 static void load_gamecontroller_settings(Settings *settings)
 {
     std::string path = Local_Storage::get_game_settings_path() + "controller";
@@ -117,8 +315,36 @@ static void load_gamecontroller_settings(Settings *settings)
     settings->glyphs_directory = path + (PATH_SEPARATOR "glyphs" PATH_SEPARATOR);
 }
 
+#ifndef EMU_RELEASE_BUILD
+static void load_debug_log_filter(std::string filter_filepath)
+{
+    std::ifstream input( utf8_decode(filter_filepath) );
+    if (!input.is_open()) return;
+    consume_bom(input);
+
+    std::vector<std::string> subsystems;
+    for( std::string line; std::getline( input, line ); ) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        subsystems.push_back(line);
+    }
+
+    emu_log_set_filter(subsystems);
+}
+#endif
+
 uint32 create_localstorage_settings(Settings **settings_client_out, Settings **settings_server_out, Local_Storage **local_storage_out)
 {
+#ifndef EMU_RELEASE_BUILD
+    load_debug_log_filter(Local_Storage::get_game_settings_path() + "debug_log_filter.txt");
+#endif
+
     std::string program_path = Local_Storage::get_program_path(), save_path = Local_Storage::get_user_appdata_path();;
 
     PRINT_DEBUG("Current Path %s save_path: %s\n", program_path.c_str(), save_path.c_str());
@@ -297,6 +523,7 @@ uint32 create_localstorage_settings(Settings **settings_client_out, Settings **s
 
     bool steam_offline_mode = false;
     bool disable_networking = false;
+    bool network_thread = false;
     bool disable_overlay = false;
     bool disable_lobby_creation = false;
     int build_id = 10;
@@ -313,6 +540,8 @@ uint32 create_localstorage_settings(Settings **settings_client_out, Settings **s
                 steam_offline_mode = true;
             } else if (p == "disable_networking.txt") {
                 disable_networking = true;
+            } else if (p == "network_thread.txt") {
+                network_thread = true;
             } else if (p == "disable_overlay.txt") {
                 disable_overlay = true;
             } else if (p == "disable_lobby_creation.txt") {
@@ -361,6 +590,8 @@ uint32 create_localstorage_settings(Settings **settings_client_out, Settings **s
     settings_server->custom_broadcasts = custom_broadcasts;
     settings_client->disable_networking = disable_networking;
     settings_server->disable_networking = disable_networking;
+    settings_client->network_thread = network_thread;
+    settings_server->network_thread = network_thread;
     settings_client->disable_overlay = disable_overlay;
     settings_server->disable_overlay = disable_overlay;
     settings_client->disable_lobby_creation = disable_lobby_creation;
@@ -374,249 +605,79 @@ uint32 create_localstorage_settings(Settings **settings_client_out, Settings **s
     settings_client->supported_languages = supported_languages;
     settings_server->supported_languages = supported_languages;
 
-    {
-        std::string dlc_config_path = Local_Storage::get_game_settings_path() + "DLC.txt";
-        std::ifstream input( utf8_decode(dlc_config_path) );
-        if (input.is_open()) {
-            consume_bom(input);
-            settings_client->unlockAllDLC(false);
-            settings_server->unlockAllDLC(false);
-            PRINT_DEBUG("Locking all DLC\n");
-
-            for( std::string line; std::getline( input, line ); ) {
-                if (!line.empty() && line.front() == '#') {
-                    continue;
-                }
-                if (!line.empty() && line.back() == '\n') {
-                    line.pop_back();
-                }
-
-                if (!line.empty() && line.back() == '\r') {
-                    line.pop_back();
-                }
-
-                std::size_t deliminator = line.find("=");
-                if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
-                    AppId_t appid = stol(line.substr(0, deliminator));
-                    std::string name = line.substr(deliminator + 1);
-                    bool available = true;
-
-                    if (appid) {
-                        PRINT_DEBUG("Adding DLC: %u|%s| %u\n", appid, name.c_str(), available);
-                        settings_client->addDLC(appid, name, available);
-                        settings_server->addDLC(appid, name, available);
-                    }
-                }
-            }
-        } else {
-            //unlock all DLC
-            PRINT_DEBUG("Unlocking all DLC\n");
-            settings_client->unlockAllDLC(true);
-            settings_server->unlockAllDLC(true);
+    //the config files don't depend on each other so they are all read and parsed at the same time
+    std::string settings_path = Local_Storage::get_game_settings_path();
+    std::vector<std::pair<AppId_t, std::string>> dlcs, app_paths;
+    std::vector<std::pair<std::string, Leaderboard_config>> leaderboards;
+    std::vector<std::pair<std::string, Stat_config>> stats;
+    std::vector<uint64> depots, subscribed_groups;
+    std::string mod_path = settings_path + "mods";
+    std::vector<std::string> mod_paths;
+
+    auto dlc_file = std::async(std::launch::async, load_dlc_config, settings_path + "DLC.txt", std::ref(dlcs));
+    auto app_paths_file = std::async(std::launch::async, load_app_paths_config, settings_path + "app_paths.txt", program_path, std::ref(app_paths));
+    auto leaderboards_file = std::async(std::launch::async, load_leaderboards_config, settings_path + "leaderboards.txt", std::ref(leaderboards));
+    auto stats_file = std::async(std::launch::async, load_stats_config, settings_path + "stats.txt", std::ref(stats));
+    auto depots_file = std::async(std::launch::async, load_id_list_config, settings_path + "depots.txt", std::ref(depots));
+    auto subscribed_groups_file = std::async(std::launch::async, load_id_list_config, settings_path + "subscribed_groups.txt", std::ref(subscribed_groups));
+    auto mods_folder = std::async(std::launch::async, [&mod_path, &mod_paths]() { mod_paths = Local_Storage::get_filenames_path(mod_path); });
+
+    if (dlc_file.get()) {
+        settings_client->unlockAllDLC(false);
+        settings_server->unlockAllDLC(false);
+        PRINT_DEBUG("Locking all DLC\n");
+
+        for (auto &dlc : dlcs) {
+            settings_client->addDLC(dlc.first, dlc.second, true);
+            settings_server->addDLC(dlc.first, dlc.second, true);
         }
+    } else {
+        //unlock all DLC
+        PRINT_DEBUG("Unlocking all DLC\n");
+        settings_client->unlockAllDLC(true);
+        settings_server->unlockAllDLC(true);
     }
 
-    {
-        std::string dlc_config_path = Local_Storage::get_game_settings_path() + "app_paths.txt";
-        std::ifstream input( utf8_decode(dlc_config_path) );
-
-        if (input.is_open()) {
-            consume_bom(input);
-            for( std::string line; getline( input, line ); ) {
-                if (!line.empty() && line[line.length()-1] == '\n') {
-                    line.pop_back();
-                }
-
-                if (!line.empty() && line[line.length()-1] == '\r') {
-                    line.pop_back();
-                }
-
-                std::size_t deliminator = line.find("=");
-                if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
-                    AppId_t appid = stol(line.substr(0, deliminator));
-                    std::string rel_path = line.substr(deliminator + 1);
-                    std::string path = canonical_path(program_path + rel_path);
-
-                    if (appid) {
-                        if (path.size()) {
-                            PRINT_DEBUG("Adding app path: %u|%s|\n", appid, path.c_str());
-                            settings_client->setAppInstallPath(appid, path);
-                            settings_server->setAppInstallPath(appid, path);
-                        } else {
-                            PRINT_DEBUG("Error adding app path for: %u does this path exist? |%s|\n", appid, rel_path.c_str());
-                        }
-                    }
-                }
-            }
-        }
+    app_paths_file.get();
+    for (auto &app_path : app_paths) {
+        settings_client->setAppInstallPath(app_path.first, app_path.second);
+        settings_server->setAppInstallPath(app_path.first, app_path.second);
     }
 
-    {
-        std::string dlc_config_path = Local_Storage::get_game_settings_path() + "leaderboards.txt";
-        std::ifstream input( utf8_decode(dlc_config_path) );
-        if (input.is_open()) {
-            consume_bom(input);
-            settings_client->setCreateUnknownLeaderboards(false);
-            settings_server->setCreateUnknownLeaderboards(false);
-
-            for( std::string line; getline( input, line ); ) {
-                if (!line.empty() && line[line.length()-1] == '\n') {
-                    line.pop_back();
-                }
-
-                if (!line.empty() && line[line.length()-1] == '\r') {
-                    line.pop_back();
-                }
-
-                std::string leaderboard;
-                unsigned int sort_method = 0;
-                unsigned int display_type = 0;
-
-                std::size_t deliminator = line.find("=");
-                if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
-                    leaderboard = line.substr(0, deliminator);
-                    std::size_t deliminator2 = line.find("=", deliminator + 1);
-                    if (deliminator2 != std::string::npos && deliminator2 != line.size()) {
-                        sort_method = stol(line.substr(deliminator + 1, deliminator2 - (deliminator + 1)));
-                        display_type = stol(line.substr(deliminator2 + 1));
-                    }
-                }
-
-                if (leaderboard.size() && sort_method <= k_ELeaderboardSortMethodDescending && display_type <= k_ELeaderboardDisplayTypeTimeMilliSeconds) {
-                    PRINT_DEBUG("Adding leaderboard: %s|%u|%u\n", leaderboard.c_str(), sort_method, display_type);
-                    settings_client->setLeaderboard(leaderboard, (ELeaderboardSortMethod)sort_method, (ELeaderboardDisplayType)display_type);
-                    settings_server->setLeaderboard(leaderboard, (ELeaderboardSortMethod)sort_method, (ELeaderboardDisplayType)display_type);
-                } else {
-                    PRINT_DEBUG("Error adding leaderboard for: %s, are sort method %u or display type %u valid?\n", leaderboard.c_str(), sort_method, display_type);
-                }
-            }
-        }
+    if (leaderboards_file.get()) {
+        settings_client->setCreateUnknownLeaderboards(false);
+        settings_server->setCreateUnknownLeaderboards(false);
     }
 
-    {
-        std::string stats_config_path = Local_Storage::get_game_settings_path() + "stats.txt";
-        std::ifstream input( utf8_decode(stats_config_path) );
-        if (input.is_open()) {
-            consume_bom(input);
-            for( std::string line; getline( input, line ); ) {
-                if (!line.empty() && line[line.length()-1] == '\n') {
-                    line.pop_back();
-                }
-
-                if (!line.empty() && line[line.length()-1] == '\r') {
-                    line.pop_back();
-                }
-
-                std::string stat_name;
-                std::string stat_type;
-                std::string stat_default_value;
-
-                std::size_t deliminator = line.find("=");
-                if (deliminator != 0 && deliminator != std::string::npos && deliminator != line.size()) {
-                    stat_name = line.substr(0, deliminator);
-                    std::size_t deliminator2 = line.find("=", deliminator + 1);
-
-                    if (deliminator2 != std::string::npos && deliminator2 != line.size()) {
-                        stat_type = line.substr(deliminator + 1, deliminator2 - (deliminator + 1));
-                        stat_default_value = line.substr(deliminator2 + 1);
-                    } else {
-                        stat_type = line.substr(deliminator + 1);
-                        stat_default_value = "0";
-                    }
-                }
-
-                std::transform(stat_type.begin(), stat_type.end(), stat_type.begin(),[](unsigned char c){ return std::tolower(c); });
-                struct Stat_config config = {};
-
-                try {
-                    if (stat_type == "float") {
-                        config.type = Stat_Type::STAT_TYPE_FLOAT;
-                        config.default_value_float = std::stof(stat_default_value);
-                    } else if (stat_type == "int") {
-                        config.type = Stat_Type::STAT_TYPE_INT;
-                        config.default_value_int = std::stol(stat_default_value);
-                    } else if (stat_type == "avgrate") {
-                        config.type = Stat_Type::STAT_TYPE_AVGRATE;
-                        config.default_value_float = std::stof(stat_default_value);
-                    } else {
-                        PRINT_DEBUG("Error adding stat %s, type %s isn't valid\n", stat_name.c_str(), stat_type.c_str());
-                        continue;
-                    }
-                } catch (...) {
-                    PRINT_DEBUG("Error adding stat %s, default value %s isn't valid\n", stat_name.c_str(), stat_default_value.c_str());
-                    continue;
-                }
-
-                if (stat_name.size()) {
-                    PRINT_DEBUG("Adding stat type: %s|%u|%f|%u\n", stat_name.c_str(), config.type, config.default_value_float, config.default_value_int);
-                    settings_client->setStatDefiniton(stat_name, config);
-                    settings_server->setStatDefiniton(stat_name, config);
-                } else {
-                    PRINT_DEBUG("Error adding stat for: %s, empty name\n", stat_name.c_str());
-                }
-            }
-        }
+    for (auto &leaderboard : leaderboards) {
+        settings_client->setLeaderboard(leaderboard.first, leaderboard.second.sort_method, leaderboard.second.display_type);
+        settings_server->setLeaderboard(leaderboard.first, leaderboard.second.sort_method, leaderboard.second.display_type);
     }
 
-    {
-        std::string depots_config_path = Local_Storage::get_game_settings_path() + "depots.txt";
-        std::ifstream input( utf8_decode(depots_config_path) );
-        if (input.is_open()) {
-            consume_bom(input);
-            for( std::string line; getline( input, line ); ) {
-                if (!line.empty() && line[line.length()-1] == '\n') {
-                    line.pop_back();
-                }
-
-                if (!line.empty() && line[line.length()-1] == '\r') {
-                    line.pop_back();
-                }
-
-                try {
-                    DepotId_t depot_id = std::stoul(line);
-                    settings_client->depots.push_back(depot_id);
-                    settings_server->depots.push_back(depot_id);
-                    PRINT_DEBUG("Added depot %u\n", depot_id);
-                } catch (...) {}
-            }
-        }
+    stats_file.get();
+    for (auto &stat : stats) {
+        settings_client->setStatDefiniton(stat.first, stat.second);
+        settings_server->setStatDefiniton(stat.first, stat.second);
     }
 
-    {
-        std::string depots_config_path = Local_Storage::get_game_settings_path() + "subscribed_groups.txt";
-        std::ifstream input( utf8_decode(depots_config_path) );
-        if (input.is_open()) {
-            consume_bom(input);
-            for( std::string line; getline( input, line ); ) {
-                if (!line.empty() && line[line.length()-1] == '\n') {
-                    line.pop_back();
-                }
-
-                if (!line.empty() && line[line.length()-1] == '\r') {
-                    line.pop_back();
-                }
-
-                try {
-                    uint64 source_id = std::stoull(line);
-                    settings_client->subscribed_groups.insert(source_id);
-                    settings_server->subscribed_groups.insert(source_id);
-                    PRINT_DEBUG("Added source %llu\n", source_id);
-                } catch (...) {}
-            }
-        }
+    depots_file.get();
+    for (auto &depot_id : depots) {
+        settings_client->depots.push_back(depot_id);
+        settings_server->depots.push_back(depot_id);
     }
 
-    {
-        std::string mod_path = Local_Storage::get_game_settings_path() + "mods";
-        std::vector<std::string> paths = Local_Storage::get_filenames_path(mod_path);
-        for (auto & p: paths) {
-            PRINT_DEBUG("mod directory %s\n", p.c_str());
-            try {
-                PublishedFileId_t id = std::stoull(p);
-                settings_client->addMod(id, p, mod_path + PATH_SEPARATOR + p);
-                settings_server->addMod(id, p, mod_path + PATH_SEPARATOR + p);
-            } catch (...) {}
-        }
+    subscribed_groups_file.get();
+    settings_client->subscribed_groups.insert(subscribed_groups.begin(), subscribed_groups.end());
+    settings_server->subscribed_groups.insert(subscribed_groups.begin(), subscribed_groups.end());
+
+    mods_folder.get();
+    for (auto & p: mod_paths) {
+        PRINT_DEBUG("mod directory %s\n", p.c_str());
+        try {
+            PublishedFileId_t id = std::stoull(p);
+            settings_client->addMod(id, p, mod_path + PATH_SEPARATOR + p);
+            settings_server->addMod(id, p, mod_path + PATH_SEPARATOR + p);
+        } catch (...) {}
     }
 
     load_gamecontroller_settings(settings_client);
@@ -0,0 +1,266 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#include "source_query.h"
+
+//https://developer.valvesoftware.com/wiki/Server_queries
+#define A2S_INFO 'T'
+#define A2S_PLAYER 'U'
+#define A2S_RULES 'V'
+#define A2S_SERVERQUERY_GETCHALLENGE 'W'
+
+#define S2A_INFO 'I'
+#define S2A_PLAYER 'D'
+#define S2A_RULES 'E'
+#define S2C_CHALLENGE 'A'
+
+#define A2S_INFO_PAYLOAD "Source Engine Query"
+#define SOURCE_QUERY_PROTOCOL 17
+
+#define SOURCE_QUERY_SINGLE_PACKET 0xFFFFFFFF
+#define SOURCE_QUERY_SPLIT_PACKET 0xFFFFFFFE
+#define SOURCE_QUERY_MAX_PACKET 1400
+#define SOURCE_QUERY_SPLIT_SIZE 1248
+
+#define EDF_GAMEID 0x01
+#define EDF_STEAMID 0x10
+#define EDF_KEYWORDS 0x20
+#define EDF_SPECTATOR 0x40
+#define EDF_PORT 0x80
+
+//the play time in the player reply changes so it gets rebuilt once in a while even when nothing else changed
+#define SOURCE_QUERY_PLAYERS_REFRESH 1.0
+
+//everything is little endian
+static void write_byte(std::string &out, uint8 value)
+{
+    out.push_back((char)value);
+}
+
+static void write_short(std::string &out, uint16 value)
+{
+    write_byte(out, value & 0xFF);
+    write_byte(out, value >> 8);
+}
+
+static void write_long(std::string &out, uint32 value)
+{
+    write_short(out, value & 0xFFFF);
+    write_short(out, value >> 16);
+}
+
+static void write_long_long(std::string &out, uint64 value)
+{
+    write_long(out, value & 0xFFFFFFFF);
+    write_long(out, value >> 32);
+}
+
+static void write_float(std::string &out, float value)
+{
+    uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write_long(out, bits);
+}
+
+static void write_string(std::string &out, std::string const &value)
+{
+    //strings are null terminated so they end at the first null
+    out.append(value.c_str());
+    out.push_back('\0');
+}
+
+static uint32 read_long(const unsigned char *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+Source_Query::Source_Query()
+{
+    challenge_secret = generate_random_int();
+}
+
+//challenges are derived from the address so that nothing has to be remembered for each client
+uint32 Source_Query::challenge(uint32 ip)
+{
+    uint32 value = (ip ^ challenge_secret) * 0x9E3779B1;
+    value ^= value >> 15;
+    //-1 is what clients send to ask for a challenge
+    if (value == 0xFFFFFFFF) value = 0;
+    return value;
+}
+
+void Source_Query::make_packets(std::string &reply, std::vector<std::string> &packets)
+{
+    packets.clear();
+    if (reply.size() <= SOURCE_QUERY_MAX_PACKET) {
+        packets.push_back(std::move(reply));
+        return;
+    }
+
+    ++split_id;
+    //the top bit means compressed
+    split_id &= 0x7FFFFFFF;
+    uint8 total = (reply.size() + SOURCE_QUERY_SPLIT_SIZE - 1) / SOURCE_QUERY_SPLIT_SIZE;
+    for (uint8 number = 0; number < total; ++number) {
+        std::string packet;
+        write_long(packet, SOURCE_QUERY_SPLIT_PACKET);
+        write_long(packet, split_id);
+        write_byte(packet, total);
+        write_byte(packet, number);
+        write_short(packet, SOURCE_QUERY_SPLIT_SIZE);
+        packet.append(reply, number * SOURCE_QUERY_SPLIT_SIZE, SOURCE_QUERY_SPLIT_SIZE);
+        packets.push_back(std::move(packet));
+    }
+}
+
+void Source_Query::build_info(struct Source_Query_Server const &server)
+{
+    PRINT_DEBUG("Source_Query::build_info\n");
+    const Gameserver &data = server.data;
+    std::string reply;
+    write_long(reply, SOURCE_QUERY_SINGLE_PACKET);
+    write_byte(reply, S2A_INFO);
+    write_byte(reply, SOURCE_QUERY_PROTOCOL);
+    write_string(reply, data.server_name());
+    write_string(reply, data.map_name());
+    write_string(reply, data.mod_dir());
+    write_string(reply, data.game_description());
+    write_short(reply, data.appid() & 0xFFFF);
+    write_byte(reply, std::min(server.num_players, (uint32)0xFF));
+    write_byte(reply, std::min(data.max_player_count(), (uint32)0xFF));
+    write_byte(reply, std::min(data.bot_player_count(), (uint32)0xFF));
+    write_byte(reply, data.dedicated_server() ? 'd' : 'l');
+#if defined(STEAM_WIN32)
+    write_byte(reply, 'w');
+#elif defined(__APPLE__)
+    write_byte(reply, 'm');
+#else
+    write_byte(reply, 'l');
+#endif
+    write_byte(reply, data.password_protected());
+    write_byte(reply, server.secure);
+    write_string(reply, std::to_string(data.version()));
+
+    uint8 edf = EDF_PORT | EDF_STEAMID | EDF_GAMEID;
+    if (data.spectator_port()) edf |= EDF_SPECTATOR;
+    if (data.tags().size()) edf |= EDF_KEYWORDS;
+    write_byte(reply, edf);
+    write_short(reply, data.port());
+    write_long_long(reply, data.id());
+    if (edf & EDF_SPECTATOR) {
+        write_short(reply, data.spectator_port());
+        write_string(reply, data.spectator_server_name());
+    }
+
+    if (edf & EDF_KEYWORDS) write_string(reply, data.tags());
+    write_long_long(reply, CGameID(data.appid()).ToUint64());
+
+    make_packets(reply, info_packets);
+    info_num_players = server.num_players;
+    info_dirty = false;
+}
+
+void Source_Query::build_players(struct Source_Query_Server const &server)
+{
+    PRINT_DEBUG("Source_Query::build_players\n");
+    auto now = std::chrono::high_resolution_clock::now();
+    uint8 count = std::min(server.players.size(), (size_t)0xFF);
+    std::string reply;
+    write_long(reply, SOURCE_QUERY_SINGLE_PACKET);
+    write_byte(reply, S2A_PLAYER);
+    write_byte(reply, count);
+
+    uint8 index = 0;
+    for (auto &p : server.players) {
+        if (index == count) break;
+        write_byte(reply, index);
+        write_string(reply, p.second.name);
+        write_long(reply, p.second.score);
+        write_float(reply, std::chrono::duration_cast<std::chrono::duration<float>>(now - p.second.joined).count());
+        ++index;
+    }
+
+    make_packets(reply, players_packets);
+    players_built = now;
+    players_dirty = false;
+}
+
+void Source_Query::build_rules(struct Source_Query_Server const &server)
+{
+    PRINT_DEBUG("Source_Query::build_rules\n");
+    uint16 count = std::min(server.data.values().size(), (size_t)0xFFFF);
+    std::string reply;
+    write_long(reply, SOURCE_QUERY_SINGLE_PACKET);
+    write_byte(reply, S2A_RULES);
+    write_short(reply, count);
+
+    uint16 index = 0;
+    for (auto &v : server.data.values()) {
+        if (index == count) break;
+        write_string(reply, v.first);
+        write_string(reply, v.second);
+        ++index;
+    }
+
+    make_packets(reply, rules_packets);
+    rules_dirty = false;
+}
+
+bool Source_Query::handle_query(const void *data, size_t length, uint32 ip, struct Source_Query_Server const &server, std::vector<std::string> &replies)
+{
+    const unsigned char *packet = (const unsigned char *)data;
+    if (length < 5 || read_long(packet) != SOURCE_QUERY_SINGLE_PACKET) return false;
+
+    uint8 type = packet[4];
+    const unsigned char *payload = packet + 5;
+    size_t payload_length = length - 5;
+    if (type == A2S_INFO) {
+        //the challenge comes after the null terminated payload
+        size_t string_length = sizeof(A2S_INFO_PAYLOAD);
+        if (payload_length < string_length || memcmp(payload, A2S_INFO_PAYLOAD, string_length) != 0) return false;
+        payload += string_length;
+        payload_length -= string_length;
+    } else if (type != A2S_PLAYER && type != A2S_RULES && type != A2S_SERVERQUERY_GETCHALLENGE) {
+        return false;
+    }
+
+    uint32 expected = challenge(ip);
+    if (type == A2S_SERVERQUERY_GETCHALLENGE || payload_length < 4 || read_long(payload) != expected) {
+        PRINT_DEBUG("Source_Query challenge %c\n", type);
+        std::string reply;
+        write_long(reply, SOURCE_QUERY_SINGLE_PACKET);
+        write_byte(reply, S2C_CHALLENGE);
+        write_long(reply, expected);
+        replies.push_back(std::move(reply));
+        return true;
+    }
+
+    std::vector<std::string> *packets;
+    if (type == A2S_INFO) {
+        if (info_dirty || info_num_players != server.num_players) build_info(server);
+        packets = &info_packets;
+    } else if (type == A2S_PLAYER) {
+        if (players_dirty || (server.players.size() && check_timedout(players_built, SOURCE_QUERY_PLAYERS_REFRESH))) build_players(server);
+        packets = &players_packets;
+    } else {
+        if (rules_dirty) build_rules(server);
+        packets = &rules_packets;
+    }
+
+    replies.insert(replies.end(), packets->begin(), packets->end());
+    return true;
+}
@@ -0,0 +1,67 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+#ifndef SOURCE_QUERY_INCLUDE
+#define SOURCE_QUERY_INCLUDE
+
+#include "base.h"
+
+struct Source_Query_Player {
+    std::string name;
+    uint32 score;
+    std::chrono::high_resolution_clock::time_point joined;
+};
+
+//everything the replies are made from, only references so it is cheap to build for every query
+struct Source_Query_Server {
+    const Gameserver &data;
+    const std::map<uint64, struct Source_Query_Player> &players;
+    uint32 num_players;
+    bool secure;
+};
+
+//Answers the source engine server queries (A2S_INFO, A2S_PLAYER, A2S_RULES) that come in on the query port.
+//The replies are kept serialized and only rebuilt after the server data they come from changed
+//so answering a query is just a copy of the cached packets.
+class Source_Query {
+    uint32 challenge_secret;
+    uint32 split_id = 0;
+
+    std::vector<std::string> info_packets, players_packets, rules_packets;
+    bool info_dirty = true, players_dirty = true, rules_dirty = true;
+    uint32 info_num_players = 0;
+    std::chrono::high_resolution_clock::time_point players_built;
+
+    uint32 challenge(uint32 ip);
+    void make_packets(std::string &reply, std::vector<std::string> &packets);
+    void build_info(struct Source_Query_Server const &server);
+    void build_players(struct Source_Query_Server const &server);
+    void build_rules(struct Source_Query_Server const &server);
+
+public:
+    Source_Query();
+
+    //call when the data the replies are made from changes, the rebuild happens on the next query
+    void info_changed() { info_dirty = true; }
+    void players_changed() { players_dirty = true; }
+    void rules_changed() { rules_dirty = true; }
+
+    //returns false if the packet is not a query, ip is in host byte order
+    bool handle_query(const void *data, size_t length, uint32 ip, struct Source_Query_Server const &server, std::vector<std::string> &replies);
+};
+
+#endif
@@ -69,7 +69,7 @@ STEAM_CALL_RESULT( HTML_BrowserReady_t )
 SteamAPICall_t CreateBrowser( const char *pchUserAgent, const char *pchUserCSS )
 {
     PRINT_DEBUG("Steam_HTMLsurface::CreateBrowser\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     HTML_BrowserReady_t data;
     data.unBrowserHandle = 1234869;
     //callback too?
@@ -88,7 +88,7 @@ void RemoveBrowser( HHTMLBrowser unBrowserHandle )
 void LoadURL( HHTMLBrowser unBrowserHandle, const char *pchURL, const char *pchPostData )
 {
     PRINT_DEBUG("Steam_HTMLsurface::LoadURL %s %s\n", pchURL, pchPostData);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     static char url[256];
     strncpy(url, pchURL, sizeof(url));
     static char target[] = "_self";
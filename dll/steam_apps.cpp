@@ -76,7 +76,7 @@ const char *Steam_Apps::GetAvailableGameLanguages()
 bool Steam_Apps::BIsSubscribedApp( AppId_t appID )
 {
     PRINT_DEBUG("BIsSubscribedApp %u\n", appID);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (appID == 0) return true; //I think appid 0 is always owned
     if (appID == settings->get_local_game_id().AppID()) return true;
     return settings->hasDLC(appID);
@@ -87,7 +87,7 @@ bool Steam_Apps::BIsSubscribedApp( AppId_t appID )
 bool Steam_Apps::BIsDlcInstalled( AppId_t appID )
 {
     PRINT_DEBUG("BIsDlcInstalled %u\n", appID);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (appID == 0) return true;
     return settings->hasDLC(appID);
 }
@@ -116,7 +116,7 @@ bool Steam_Apps::BIsSubscribedFromFreeWeekend()
 int Steam_Apps::GetDLCCount()
 {
     PRINT_DEBUG("GetDLCCount\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return settings->DLCCount();
 }
 
@@ -125,7 +125,7 @@ int Steam_Apps::GetDLCCount()
 bool Steam_Apps::BGetDLCDataByIndex( int iDLC, AppId_t *pAppID, bool *pbAvailable, char *pchName, int cchNameBufferSize )
 {
     PRINT_DEBUG("BGetDLCDataByIndex\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     AppId_t appid;
     bool available;
     std::string name;
@@ -197,7 +197,7 @@ uint32 Steam_Apps::GetInstalledDepots( AppId_t appID, DepotId_t *pvecDepots, uin
     PRINT_DEBUG("GetInstalledDepots %u, %u\n", appID, cMaxDepots);
     //TODO not sure about the behavior of this function, I didn't actually test this.
     if (!pvecDepots) return 0;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     unsigned int count = settings->depots.size();
     if (cMaxDepots < count) count = cMaxDepots;
     std::copy(settings->depots.begin(), settings->depots.begin() + count, pvecDepots);
@@ -214,7 +214,7 @@ uint32 Steam_Apps::GetInstalledDepots( DepotId_t *pvecDepots, uint32 cMaxDepots
 uint32 Steam_Apps::GetAppInstallDir( AppId_t appID, char *pchFolder, uint32 cchFolderBufferSize )
 {
     PRINT_DEBUG("GetAppInstallDir %u %p %u\n", appID, pchFolder, cchFolderBufferSize);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //TODO return real path instead of dll path
     std::string installed_path = settings->getAppInstallPath(appID);
 
@@ -308,7 +308,7 @@ SteamAPICall_t Steam_Apps::GetFileDetails( const char* pszFileName )
         data.m_eResult = k_EResultFileNotFound;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
 }
 
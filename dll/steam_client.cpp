@@ -21,30 +21,47 @@
 static std::mutex kill_background_thread_mutex;
 static std::condition_variable kill_background_thread_cv;
 static bool kill_background_thread;
+//set when a udp packet gets queued, the background thread then sends it at its deadline
+static bool background_thread_flush;
+static void wake_background_thread(void *object)
+{
+    std::lock_guard<std::mutex> lck(kill_background_thread_mutex);
+    background_thread_flush = true;
+    kill_background_thread_cv.notify_one();
+}
+
 static void background_thread(Steam_Client *client)
 {
     PRINT_DEBUG("background thread starting\n");
 
+    auto last_keepalive = std::chrono::high_resolution_clock::now();
+    int flush_ms = -1;
     while (1) {
         {
             std::unique_lock<std::mutex> lck(kill_background_thread_mutex);
-            if (kill_background_thread || kill_background_thread_cv.wait_for(lck, std::chrono::seconds(1)) != std::cv_status::timeout) {
-                if (kill_background_thread) {
-                    PRINT_DEBUG("background thread exit\n");
-                    return;
-                }
+            std::chrono::milliseconds timeout(flush_ms >= 0 ? flush_ms : 1000);
+            kill_background_thread_cv.wait_for(lck, timeout, []{ return kill_background_thread || background_thread_flush; });
+            if (kill_background_thread) {
+                PRINT_DEBUG("background thread exit\n");
+                return;
             }
-        }
 
-        unsigned long long time = std::chrono::duration_cast<std::chrono::duration<unsigned long long>>(std::chrono::system_clock::now().time_since_epoch()).count();
+            background_thread_flush = false;
+        }
 
-        if (time > client->last_cb_run + 1) {
-            global_mutex.lock();
-            PRINT_DEBUG("background thread run\n");
-            client->network->Run();
-            client->run_every_runcb->run();
-            global_mutex.unlock();
+        global_mutex.lock();
+        flush_ms = client->network->flushUDPIfDue();
+        if (check_timedout(last_keepalive, 1.0)) {
+            last_keepalive = std::chrono::high_resolution_clock::now();
+            unsigned long long time = std::chrono::duration_cast<std::chrono::duration<unsigned long long>>(std::chrono::system_clock::now().time_since_epoch()).count();
+            if (time > client->last_cb_run + 1) {
+                PRINT_DEBUG("background thread run\n");
+                client->network->Run();
+                client->run_every_runcb->run();
+            }
         }
+
+        global_mutex.unlock();
     }
 }
 
@@ -53,6 +70,7 @@ Steam_Client::Steam_Client()
     uint32 appid = create_localstorage_settings(&settings_client, &settings_server, &local_storage);
 
     network = new Networking(settings_server->get_local_steam_id(), appid, settings_server->get_port(), &(settings_server->custom_broadcasts), settings_server->disable_networking);
+    network->setUDPQueuedCallback(wake_background_thread, this);
 
     callback_results_client = new SteamCallResults();
     callback_results_server = new SteamCallResults();
@@ -75,7 +93,7 @@ Steam_Client::Steam_Client()
 
     steam_matchmaking = new Steam_Matchmaking(settings_client, network, callback_results_client, callbacks_client, run_every_runcb);
     steam_matchmaking_servers = new Steam_Matchmaking_Servers(settings_client, network);
-    steam_user_stats = new Steam_User_Stats(settings_client, local_storage, callback_results_client, callbacks_client, steam_overlay);
+    steam_user_stats = new Steam_User_Stats(settings_client, local_storage, callback_results_client, callbacks_client, run_every_runcb, steam_overlay);
     steam_apps = new Steam_Apps(settings_client, callback_results_client);
     steam_networking = new Steam_Networking(settings_client, network, callbacks_client, run_every_runcb);
     steam_remote_storage = new Steam_Remote_Storage(settings_client, local_storage, callback_results_client);
@@ -203,16 +221,19 @@ bool Steam_Client::IsUserLogIn()
 void Steam_Client::serverShutdown()
 {
     server_init = false;
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    network->closeQuerySocket();
 }
 
 void Steam_Client::clientShutdown()
 {
+    steam_user_stats->flush_stats();
     user_logged_in = false;
 }
 
 void Steam_Client::setAppID(uint32 appid)
 {
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (appid && !settings_client->get_local_game_id().AppID()) {
         settings_client->set_game_id(CGameID(appid));
         settings_server->set_game_id(CGameID(appid));
@@ -902,6 +923,9 @@ bool Steam_Client::BShutdownIfAllPipesClosed()
             background_keepalive.join();
         }
 
+        network->stopThread();
+        global_mutex.print_stats();
+
         PRINT_DEBUG("all pipes closed\n");
         return true;
     }
@@ -1667,7 +1691,7 @@ void Steam_Client::UnregisterCallback( class CCallbackBase *pCallback)
 void Steam_Client::RegisterCallResult( class CCallbackBase *pCallback, SteamAPICall_t hAPICall)
 {
     PRINT_DEBUG("Steam_Client::RegisterCallResult %llu %i\n", hAPICall, pCallback->GetICallback());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     callback_results_client->addCallBack(hAPICall, pCallback);
     callback_results_server->addCallBack(hAPICall, pCallback);
     
@@ -1676,38 +1700,65 @@ void Steam_Client::RegisterCallResult( class CCallbackBase *pCallback, SteamAPIC
 void Steam_Client::UnregisterCallResult( class CCallbackBase *pCallback, SteamAPICall_t hAPICall)
 {
     PRINT_DEBUG("Steam_Client::UnregisterCallResult %llu %i\n", hAPICall, pCallback->GetICallback());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    callback_results_client->rmCallBack(hAPICall, pCallback);
-    callback_results_server->rmCallBack(hAPICall, pCallback);
+    {
+        std::lock_guard<Tracked_Mutex> lock(global_mutex);
+        callback_results_client->rmCallBack(hAPICall, pCallback);
+        callback_results_server->rmCallBack(hAPICall, pCallback);
+    }
+
+    waitCallbackDispatch(pCallback);
+}
+
+void Steam_Client::waitCallbackDispatch( class CCallbackBase *pCallback)
+{
+    callback_results_client->waitDispatch(pCallback);
+    callback_results_server->waitDispatch(pCallback);
 }
 
 void Steam_Client::RunCallbacks(bool runClientCB, bool runGameserverCB)
 {
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    if (!background_keepalive.joinable()) background_keepalive = std::thread(background_thread, this);
+    {
+        std::lock_guard<Tracked_Mutex> lock(global_mutex);
+        if (!background_keepalive.joinable()) {
+            background_keepalive = std::thread(background_thread, this);
+            if (settings_client->network_thread) network->startThread();
+        }
+
+        network->Run();
+        PRINT_DEBUG("Steam_Client::RunCallbacks steam_matchmaking_servers\n");
+        steam_matchmaking_servers->RunCallbacks();
+        run_every_runcb->run();
 
-    network->Run();
-    PRINT_DEBUG("Steam_Client::RunCallbacks steam_matchmaking_servers\n");
-    steam_matchmaking_servers->RunCallbacks();
-    run_every_runcb->run();
+        steam_gameserver->RunCallbacks();
 
-    steam_gameserver->RunCallbacks();
+        if (runClientCB) {
+            PRINT_DEBUG("Steam_Client::RunCallbacks callback_results_client\n");
+            callback_results_client->runCallResults();
+        }
+
+        if (runGameserverCB) {
+            PRINT_DEBUG("Steam_Client::RunCallbacks callback_results_server\n");
+            callback_results_server->runCallResults();
+        }
+
+        PRINT_DEBUG("Steam_Client::RunCallbacks callbacks_server\n");
+        callbacks_server->runCallBacks();
+        PRINT_DEBUG("Steam_Client::RunCallbacks callbacks_client\n");
+        callbacks_client->runCallBacks();
+        last_cb_run = std::chrono::duration_cast<std::chrono::duration<unsigned long long>>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
 
+    //the callbacks run after global_mutex has been released so other threads calling into the api don't wait on game code
     if (runClientCB) {
-        PRINT_DEBUG("Steam_Client::RunCallbacks callback_results_client\n");
-        callback_results_client->runCallResults();
+        PRINT_DEBUG("Steam_Client::RunCallbacks dispatch client\n");
+        callback_results_client->dispatchCallResults();
     }
 
     if (runGameserverCB) {
-        PRINT_DEBUG("Steam_Client::RunCallbacks callback_results_server\n");
-        callback_results_server->runCallResults();
+        PRINT_DEBUG("Steam_Client::RunCallbacks dispatch server\n");
+        callback_results_server->dispatchCallResults();
     }
 
-    PRINT_DEBUG("Steam_Client::RunCallbacks callbacks_server\n");
-    callbacks_server->runCallBacks();
-    PRINT_DEBUG("Steam_Client::RunCallbacks callbacks_client\n");
-    callbacks_client->runCallBacks();
-    last_cb_run = std::chrono::duration_cast<std::chrono::duration<unsigned long long>>(std::chrono::system_clock::now().time_since_epoch()).count();
     PRINT_DEBUG("Steam_Client::RunCallbacks done\n");
 }
 
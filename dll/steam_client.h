@@ -290,6 +290,8 @@ public:
 
     void RegisterCallResult( class CCallbackBase *pCallback, SteamAPICall_t hAPICall);
     void UnregisterCallResult( class CCallbackBase *pCallback, SteamAPICall_t hAPICall);
+    //call without global_mutex held after unregistering, returns once no other thread is running the callback
+    void waitCallbackDispatch( class CCallbackBase *pCallback);
     
     void RunCallbacks(bool runClientCB, bool runGameserverCB);
     void setAppID(uint32 appid);
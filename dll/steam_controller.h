@@ -300,7 +300,7 @@ Steam_Controller(class Settings *settings, class SteamCallResults *callback_resu
 bool Init(bool bExplicitlyCallRunFrame)
 {
     PRINT_DEBUG("Steam_Controller::Init() %u\n", bExplicitlyCallRunFrame);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (disabled || initialized) {
         return true;
     }
@@ -341,7 +341,7 @@ bool Init()
 bool Shutdown()
 {
     PRINT_DEBUG("Steam_Controller::Shutdown()\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (disabled || !initialized) {
         return true;
     }
@@ -53,6 +53,10 @@ public ISteamFriends
     class RunEveryRunCB *run_every_runcb;
     class Steam_Overlay* overlay;
 
+    //guards us, friends, avatars and the other state below so that the read only friend queries don't
+    //need global_mutex. Functions that also touch settings, network or callbacks take global_mutex first,
+    //this includes reading the local user's name, game id or lobby since those are set under global_mutex.
+    Tracked_Mutex friends_mutex{"Steam_Friends", 1};
     Friend us;
     bool modified;
     std::vector<Friend> friends;
@@ -104,13 +108,9 @@ struct Avatar_Numbers add_friend_avatars(CSteamID id)
 
     //TODO: get real image data from self/other peers
     struct Avatar_Numbers avatar_numbers;
-    std::string small_avatar(32 * 32 * 4, 0);
-    std::string medium_avatar(64 * 64 * 4, 0);
-    std::string large_avatar(184 * 184 * 4, 0);
-
-    avatar_numbers.smallest = settings->add_image(small_avatar, 32, 32);
-    avatar_numbers.medium = settings->add_image(medium_avatar, 64, 64);
-    avatar_numbers.large = settings->add_image(large_avatar, 184, 184);
+    avatar_numbers.smallest = settings->add_blank_image(32, 32);
+    avatar_numbers.medium = settings->add_blank_image(64, 64);
+    avatar_numbers.large = settings->add_blank_image(184, 184);
 
     avatars[steam_id] = avatar_numbers;
     return avatar_numbers;
@@ -174,7 +174,7 @@ static bool ok_friend_flags(int iFriendFlags)
 const char *GetPersonaName()
 {
     PRINT_DEBUG("Steam_Friends::GetPersonaName\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     const char *local_name = settings->get_local_name();
     
     return local_name;
@@ -191,7 +191,7 @@ STEAM_CALL_RESULT( SetPersonaNameResponse_t )
 SteamAPICall_t SetPersonaName( const char *pchPersonaName )
 {
     PRINT_DEBUG("Steam_Friends::SetPersonaName\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     SetPersonaNameResponse_t data;
     data.m_bSuccess = true;
     data.m_bLocalSuccess = false;
@@ -221,7 +221,7 @@ EPersonaState GetPersonaState()
 int GetFriendCount( int iFriendFlags )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendCount %i\n", iFriendFlags);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     int count = 0;
     if (ok_friend_flags(iFriendFlags)) count = friends.size();
     PRINT_DEBUG("count %i\n", count);
@@ -241,7 +241,7 @@ int GetFriendCount( EFriendFlags eFriendFlags )
 CSteamID GetFriendByIndex( int iFriend, int iFriendFlags )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendByIndex\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     CSteamID id = k_steamIDNil;
     if (ok_friend_flags(iFriendFlags)) if (iFriend < friends.size()) id = CSteamID((uint64)friends[iFriend].id());
     
@@ -258,7 +258,7 @@ CSteamID GetFriendByIndex( int iFriend, EFriendFlags eFriendFlags )
 EFriendRelationship GetFriendRelationship( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendRelationship %llu\n", steamIDFriend.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     if (steamIDFriend == settings->get_local_steam_id()) return k_EFriendRelationshipNone; //Real steam behavior
     if (find_friend(steamIDFriend)) return k_EFriendRelationshipFriend;
 
@@ -271,7 +271,7 @@ EFriendRelationship GetFriendRelationship( CSteamID steamIDFriend )
 EPersonaState GetFriendPersonaState( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendPersonaState %llu\n", steamIDFriend.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     EPersonaState state = k_EPersonaStateOffline;
     if (steamIDFriend == settings->get_local_steam_id() || find_friend(steamIDFriend)) {
         state = k_EPersonaStateOnline;
@@ -289,7 +289,10 @@ EPersonaState GetFriendPersonaState( CSteamID steamIDFriend )
 const char *GetFriendPersonaName( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendPersonaName %llu\n", steamIDFriend.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    //the local user's name, game and lobby live in settings which are changed under global_mutex
+    std::unique_lock<Tracked_Mutex> lock_global(global_mutex, std::defer_lock);
+    if (steamIDFriend == settings->get_local_steam_id()) lock_global.lock();
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     const char *name = "Unknown User";
     if (steamIDFriend == settings->get_local_steam_id()) {
         name = settings->get_local_name();
@@ -306,7 +309,9 @@ const char *GetFriendPersonaName( CSteamID steamIDFriend )
 bool GetFriendGamePlayed( CSteamID steamIDFriend, STEAM_OUT_STRUCT() FriendGameInfo_t *pFriendGameInfo )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendGamePlayed %llu\n", steamIDFriend.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::unique_lock<Tracked_Mutex> lock_global(global_mutex, std::defer_lock);
+    if (steamIDFriend == settings->get_local_steam_id()) lock_global.lock();
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     bool ret = false;
 
     if (steamIDFriend == settings->get_local_steam_id()) {
@@ -342,7 +347,6 @@ bool GetFriendGamePlayed( CSteamID steamIDFriend, STEAM_OUT_STRUCT() FriendGameI
 bool GetFriendGamePlayed( CSteamID steamIDFriend, uint64 *pulGameID, uint32 *punGameIP, uint16 *pusGamePort, uint16 *pusQueryPort )
 {
 	PRINT_DEBUG("Steam_Friends::GetFriendGamePlayed old\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
 	FriendGameInfo_t info;
 	bool ret = GetFriendGamePlayed(steamIDFriend, &info);
 	if (ret) {
@@ -359,7 +363,6 @@ bool GetFriendGamePlayed( CSteamID steamIDFriend, uint64 *pulGameID, uint32 *pun
 const char *GetFriendPersonaNameHistory( CSteamID steamIDFriend, int iPersonaName )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendPersonaNameHistory\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
     const char *ret = "";
     if (iPersonaName == 0) ret = GetFriendPersonaName(steamIDFriend);
     else if (iPersonaName == 1) ret = "Some Old Name";
@@ -425,7 +428,7 @@ bool HasFriend( CSteamID steamIDFriend, int iFriendFlags )
 {
     PRINT_DEBUG("Steam_Friends::HasFriend\n");
     bool ret = false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     if (ok_friend_flags(iFriendFlags)) if (find_friend(steamIDFriend)) ret = true;
     
     return ret;
@@ -499,7 +502,9 @@ CSteamID GetFriendFromSourceByIndex( CSteamID steamIDSource, int iFriend )
 bool IsUserInSource( CSteamID steamIDUser, CSteamID steamIDSource )
 {
     PRINT_DEBUG("Steam_Friends::IsUserInSource %llu %llu\n", steamIDUser.ConvertToUint64(), steamIDSource.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::unique_lock<Tracked_Mutex> lock_global(global_mutex, std::defer_lock);
+    if (steamIDUser == settings->get_local_steam_id()) lock_global.lock();
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     if (steamIDUser == settings->get_local_steam_id()) {
         if (settings->get_lobby() == steamIDSource) {
             return true;
@@ -596,7 +601,8 @@ int GetSmallFriendAvatar( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::GetSmallFriendAvatar\n");
     //IMPORTANT NOTE: don't change friend avatar numbers for the same friend or else some games endlessly allocate stuff.
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     struct Avatar_Numbers numbers = add_friend_avatars(steamIDFriend);
     return numbers.smallest;
 }
@@ -606,7 +612,8 @@ int GetSmallFriendAvatar( CSteamID steamIDFriend )
 int GetMediumFriendAvatar( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::GetMediumFriendAvatar\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     struct Avatar_Numbers numbers = add_friend_avatars(steamIDFriend);
     return numbers.medium;
 }
@@ -617,7 +624,8 @@ int GetMediumFriendAvatar( CSteamID steamIDFriend )
 int GetLargeFriendAvatar( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::GetLargeFriendAvatar\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     struct Avatar_Numbers numbers = add_friend_avatars(steamIDFriend);
     return numbers.large;
 }
@@ -650,7 +658,7 @@ int GetFriendAvatar(CSteamID steamIDFriend)
 bool RequestUserInformation( CSteamID steamIDUser, bool bRequireNameOnly )
 {
     PRINT_DEBUG("Steam_Friends::RequestUserInformation\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //persona_change(steamIDUser, k_EPersonaChangeName);
     //We already know everything
     return false;
@@ -722,7 +730,7 @@ EUserRestriction GetUserRestrictions_old()
 bool SetRichPresence( const char *pchKey, const char *pchValue )
 {
     PRINT_DEBUG("Steam_Friends::SetRichPresence %s %s\n", pchKey, pchValue ? pchValue : "NULL");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     if (pchValue) {
         auto prev_value = (*us.mutable_rich_presence()).find(pchKey);
         if (prev_value == (*us.mutable_rich_presence()).end() || prev_value->second != pchValue) {
@@ -743,7 +751,7 @@ bool SetRichPresence( const char *pchKey, const char *pchValue )
 void ClearRichPresence()
 {
     PRINT_DEBUG("Steam_Friends::ClearRichPresence\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     us.mutable_rich_presence()->clear();
     resend_friend_data();
     
@@ -752,7 +760,9 @@ void ClearRichPresence()
 const char *GetFriendRichPresence( CSteamID steamIDFriend, const char *pchKey )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendRichPresence %llu %s\n", steamIDFriend.ConvertToUint64(), pchKey);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    //isAppIdCompatible reads the game id from settings
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     const char *value = "";
 
     Friend *f = NULL;
@@ -773,7 +783,8 @@ const char *GetFriendRichPresence( CSteamID steamIDFriend, const char *pchKey )
 int GetFriendRichPresenceKeyCount( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendRichPresenceKeyCount\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     int num = 0;
 
     Friend *f = NULL;
@@ -791,7 +802,8 @@ int GetFriendRichPresenceKeyCount( CSteamID steamIDFriend )
 const char *GetFriendRichPresenceKeyByIndex( CSteamID steamIDFriend, int iKey )
 {
     PRINT_DEBUG("Steam_Friends::GetFriendRichPresenceKeyByIndex\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     const char *key = "";
 
     Friend *f = NULL;
@@ -815,7 +827,8 @@ const char *GetFriendRichPresenceKeyByIndex( CSteamID steamIDFriend, int iKey )
 void RequestFriendRichPresence( CSteamID steamIDFriend )
 {
     PRINT_DEBUG("Steam_Friends::RequestFriendRichPresence\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     Friend *f = find_friend(steamIDFriend);
     if (f) rich_presence_updated(steamIDFriend, settings->get_local_game_id().AppID());
     
@@ -829,7 +842,8 @@ void RequestFriendRichPresence( CSteamID steamIDFriend )
 bool InviteUserToGame( CSteamID steamIDFriend, const char *pchConnectString )
 {
     PRINT_DEBUG("Steam_Friends::InviteUserToGame\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock_friends(friends_mutex);
     Friend *f = find_friend(steamIDFriend);
     if (!f) return false;
 
@@ -881,7 +895,7 @@ SteamAPICall_t JoinClanChatRoom( CSteamID steamIDClan )
 {
     PRINT_DEBUG("Steam_Friends::JoinClanChatRoom %llu\n", steamIDClan.ConvertToUint64());
     //TODO actually join a room
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     JoinClanChatRoomCompletionResult_t data;
     data.m_steamIDClanChat = steamIDClan;
     data.m_eChatRoomEnterResponse = k_EChatRoomEnterResponseSuccess;
@@ -1057,6 +1071,7 @@ uint32 GetProfileItemPropertyUint( CSteamID steamID, ECommunityProfileItemType i
 void RunCallbacks()
 {
 	PRINT_DEBUG("Steam_Friends::RunCallbacks\n");
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     if (settings->get_lobby() != lobby_id) {
         lobby_id = settings->get_lobby();
         resend_friend_data();
@@ -1079,6 +1094,7 @@ void RunCallbacks()
 
 void Callback(Common_Message *msg)
 {
+    std::lock_guard<Tracked_Mutex> lock(friends_mutex);
     if (msg->has_low_level()) {
         if (msg->low_level().type() == Low_Level::DISCONNECT) {
             PRINT_DEBUG("Steam_Friends Disconnect\n");
@@ -30,6 +30,7 @@ Steam_GameServer::Steam_GameServer(class Settings *settings, class Networking *n
 
 Steam_GameServer::~Steam_GameServer()
 {
+    network->closeQuerySocket();
     delete ticket_manager;
 }
 
@@ -42,7 +43,7 @@ Steam_GameServer::~Steam_GameServer()
 bool Steam_GameServer::InitGameServer( uint32 unIP, uint16 usGamePort, uint16 usQueryPort, uint32 unFlags, AppId_t nGameAppId, const char *pchVersionString )
 {
     PRINT_DEBUG("InitGameServer\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (logged_in) return false; // may not be changed after logged in.
     if (!pchVersionString) pchVersionString = "";
@@ -61,6 +62,7 @@ bool Steam_GameServer::InitGameServer( uint32 unIP, uint16 usGamePort, uint16 us
     server_data.set_port(usGamePort);
     server_data.set_query_port(usQueryPort);
     server_data.set_offline(false);
+    source_query.info_changed();
     if (!settings->get_local_game_id().AppID()) settings->set_game_id(CGameID(nGameAppId));
     //TODO: flags should be k_unServerFlag
     flags = unFlags;
@@ -77,7 +79,7 @@ bool Steam_GameServer::InitGameServer( uint32 unIP, uint16 usGamePort, uint16 us
 void Steam_GameServer::SetProduct( const char *pszProduct )
 {
     PRINT_DEBUG("SetProduct\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_product(pszProduct);
 }
 
@@ -87,8 +89,9 @@ void Steam_GameServer::SetProduct( const char *pszProduct )
 void Steam_GameServer::SetGameDescription( const char *pszGameDescription )
 {
     PRINT_DEBUG("SetGameDescription\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_game_description(pszGameDescription);
+    source_query.info_changed();
 }
 
 
@@ -99,8 +102,9 @@ void Steam_GameServer::SetGameDescription( const char *pszGameDescription )
 void Steam_GameServer::SetModDir( const char *pszModDir )
 {
     PRINT_DEBUG("SetModDir\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_mod_dir(pszModDir);
+    source_query.info_changed();
 }
 
 
@@ -108,8 +112,9 @@ void Steam_GameServer::SetModDir( const char *pszModDir )
 void Steam_GameServer::SetDedicatedServer( bool bDedicated )
 {
     PRINT_DEBUG("SetDedicatedServer\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_dedicated_server(bDedicated);
+    source_query.info_changed();
 }
 
 
@@ -126,9 +131,10 @@ void Steam_GameServer::SetDedicatedServer( bool bDedicated )
 void Steam_GameServer::LogOn( const char *pszToken )
 {
     PRINT_DEBUG("LogOn %s\n", pszToken);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     call_servers_connected = true;
     logged_in = true;
+    open_query_port();
 }
 
 void Steam_GameServer::LogOn(
@@ -147,9 +153,10 @@ void Steam_GameServer::LogOn(
 void Steam_GameServer::LogOnAnonymous()
 {
     PRINT_DEBUG("LogOnAnonymous\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     call_servers_connected = true;
     logged_in = true;
+    open_query_port();
 }
 
 void Steam_GameServer::LogOn()
@@ -162,12 +169,13 @@ void Steam_GameServer::LogOn()
 void Steam_GameServer::LogOff()
 {
     PRINT_DEBUG("LogOff\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (logged_in) {
         call_servers_disconnected = true;
     }
 
     logged_in = false;
+    network->closeQuerySocket();
 }
 
 
@@ -175,14 +183,14 @@ void Steam_GameServer::LogOff()
 bool Steam_GameServer::BLoggedOn()
 {
     PRINT_DEBUG("BLoggedOn\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return logged_in;
 }
 
 bool Steam_GameServer::BSecure()
 {
     PRINT_DEBUG("BSecure\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!policy_response_called) return false;
     return !!(flags & k_unServerFlagSecure);
 }
@@ -190,7 +198,7 @@ bool Steam_GameServer::BSecure()
 CSteamID Steam_GameServer::GetSteamID()
 {
     PRINT_DEBUG("Steam_GameServer::GetSteamID\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!logged_in) return k_steamIDNil;
     return settings->get_local_steam_id();
 }
@@ -201,7 +209,7 @@ CSteamID Steam_GameServer::GetSteamID()
 bool Steam_GameServer::WasRestartRequested()
 {
     PRINT_DEBUG("WasRestartRequested\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return false;
 }
 
@@ -214,8 +222,9 @@ bool Steam_GameServer::WasRestartRequested()
 void Steam_GameServer::SetMaxPlayerCount( int cPlayersMax )
 {
     PRINT_DEBUG("SetMaxPlayerCount\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_max_player_count(cPlayersMax);
+    source_query.info_changed();
 }
 
 
@@ -223,8 +232,9 @@ void Steam_GameServer::SetMaxPlayerCount( int cPlayersMax )
 void Steam_GameServer::SetBotPlayerCount( int cBotplayers )
 {
     PRINT_DEBUG("SetBotPlayerCount\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_bot_player_count(cBotplayers);
+    source_query.info_changed();
 }
 
 
@@ -234,8 +244,9 @@ void Steam_GameServer::SetBotPlayerCount( int cBotplayers )
 void Steam_GameServer::SetServerName( const char *pszServerName )
 {
     PRINT_DEBUG("SetServerName\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_server_name(pszServerName);
+    source_query.info_changed();
 }
 
 
@@ -245,8 +256,9 @@ void Steam_GameServer::SetServerName( const char *pszServerName )
 void Steam_GameServer::SetMapName( const char *pszMapName )
 {
     PRINT_DEBUG("SetMapName\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_map_name(pszMapName);
+    source_query.info_changed();
 }
 
 
@@ -254,8 +266,9 @@ void Steam_GameServer::SetMapName( const char *pszMapName )
 void Steam_GameServer::SetPasswordProtected( bool bPasswordProtected )
 {
     PRINT_DEBUG("SetPasswordProtected\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_password_protected(bPasswordProtected);
+    source_query.info_changed();
 }
 
 
@@ -264,8 +277,9 @@ void Steam_GameServer::SetPasswordProtected( bool bPasswordProtected )
 void Steam_GameServer::SetSpectatorPort( uint16 unSpectatorPort )
 {
     PRINT_DEBUG("SetSpectatorPort\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_spectator_port(unSpectatorPort);
+    source_query.info_changed();
 }
 
 
@@ -275,8 +289,9 @@ void Steam_GameServer::SetSpectatorPort( uint16 unSpectatorPort )
 void Steam_GameServer::SetSpectatorServerName( const char *pszSpectatorServerName )
 {
     PRINT_DEBUG("SetSpectatorServerName\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_spectator_server_name(pszSpectatorServerName);
+    source_query.info_changed();
 }
 
 
@@ -284,8 +299,9 @@ void Steam_GameServer::SetSpectatorServerName( const char *pszSpectatorServerNam
 void Steam_GameServer::ClearAllKeyValues()
 {
     PRINT_DEBUG("ClearAllKeyValues\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.clear_values();
+    source_query.rules_changed();
 }
 
 
@@ -293,8 +309,9 @@ void Steam_GameServer::ClearAllKeyValues()
 void Steam_GameServer::SetKeyValue( const char *pKey, const char *pValue )
 {
     PRINT_DEBUG("SetKeyValue %s %s\n", pKey, pValue);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     (*server_data.mutable_values())[std::string(pKey)] = std::string(pValue);
+    source_query.rules_changed();
 }
 
 
@@ -305,8 +322,9 @@ void Steam_GameServer::SetKeyValue( const char *pKey, const char *pValue )
 void Steam_GameServer::SetGameTags( const char *pchGameTags )
 {
     PRINT_DEBUG("SetGameTags\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_tags(pchGameTags);
+    source_query.info_changed();
 }
 
 
@@ -319,7 +337,7 @@ void Steam_GameServer::SetGameTags( const char *pchGameTags )
 void Steam_GameServer::SetGameData( const char *pchGameData )
 {
     PRINT_DEBUG("SetGameData\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_gamedata(pchGameData);
 }
 
@@ -328,7 +346,7 @@ void Steam_GameServer::SetGameData( const char *pchGameData )
 void Steam_GameServer::SetRegion( const char *pszRegion )
 {
     PRINT_DEBUG("SetRegion\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_region(pszRegion);
 }
 
@@ -349,7 +367,7 @@ void Steam_GameServer::SetRegion( const char *pszRegion )
 bool Steam_GameServer::SendUserConnectAndAuthenticate( uint32 unIPClient, const void *pvAuthBlob, uint32 cubAuthBlobSize, CSteamID *pSteamIDUser )
 {
     PRINT_DEBUG("SendUserConnectAndAuthenticate %u %u\n", unIPClient, cubAuthBlobSize);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     return ticket_manager->SendUserConnectAndAuthenticate(unIPClient, pvAuthBlob, cubAuthBlobSize, pSteamIDUser);
 }
@@ -366,7 +384,7 @@ void Steam_GameServer::SendUserConnectAndAuthenticate( CSteamID steamIDUser, uin
 CSteamID Steam_GameServer::CreateUnauthenticatedUserConnection()
 {
     PRINT_DEBUG("CreateUnauthenticatedUserConnection\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     return ticket_manager->fakeUser();
 }
@@ -378,9 +396,10 @@ CSteamID Steam_GameServer::CreateUnauthenticatedUserConnection()
 void Steam_GameServer::SendUserDisconnect( CSteamID steamIDUser )
 {
     PRINT_DEBUG("SendUserDisconnect\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     ticket_manager->endAuth(steamIDUser);
+    if (players.erase(steamIDUser.ConvertToUint64())) source_query.players_changed();
 }
 
 
@@ -392,6 +411,16 @@ void Steam_GameServer::SendUserDisconnect( CSteamID steamIDUser )
 bool Steam_GameServer::BUpdateUserData( CSteamID steamIDUser, const char *pchPlayerName, uint32 uScore )
 {
     PRINT_DEBUG("BUpdateUserData %llu %s %u\n", steamIDUser.ConvertToUint64(), pchPlayerName, uScore);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    auto player = players.find(steamIDUser.ConvertToUint64());
+    if (player == players.end()) {
+        player = players.emplace(steamIDUser.ConvertToUint64(), Source_Query_Player()).first;
+        player->second.joined = std::chrono::high_resolution_clock::now();
+    }
+
+    player->second.name = pchPlayerName ? pchPlayerName : "";
+    player->second.score = uScore;
+    source_query.players_changed();
     return true;
 }
 
@@ -415,7 +444,7 @@ bool Steam_GameServer::BSetServerType( uint32 unServerFlags, uint32 unGameIP, ui
                             uint16 unSpectatorPort, uint16 usQueryPort, const char *pchGameDir, const char *pchVersion, bool bLANMode )
 {
     PRINT_DEBUG("BSetServerType\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_ip(unGameIP);
     server_data.set_port(unGamePort);
     server_data.set_query_port(usQueryPort);
@@ -426,6 +455,7 @@ bool Steam_GameServer::BSetServerType( uint32 unServerFlags, uint32 unGameIP, ui
     version.erase(std::remove(version.begin(), version.end(), '.'), version.end());
     server_data.set_version(stoi(version));
     flags = unServerFlags;
+    source_query.info_changed();
 
     //TODO?
     return true;
@@ -443,13 +473,14 @@ void Steam_GameServer::UpdateServerStatus( int cPlayers, int cPlayersMax, int cB
                                     const char *pchMapName )
 {
     PRINT_DEBUG("UpdateServerStatus\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     server_data.set_num_players(cPlayers);
     server_data.set_max_player_count(cPlayersMax);
     server_data.set_bot_player_count(cBotPlayers);
     server_data.set_server_name(pchServerName);
     server_data.set_spectator_server_name(pSpectatorServerName);
     server_data.set_map_name(pchMapName);
+    source_query.info_changed();
 }
 
 // This can be called if spectator goes away or comes back (passing 0 means there is no spectator server now).
@@ -464,14 +495,14 @@ void Steam_GameServer::UpdateSpectatorPort( uint16 unSpectatorPort )
 void Steam_GameServer::SetGameType( const char *pchGameType )
 {
     PRINT_DEBUG("SetGameType\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 }
 
 // Ask if a user has a specific achievement for this game, will get a callback on reply
 bool Steam_GameServer::BGetUserAchievementStatus( CSteamID steamID, const char *pchAchievementName )
 {
     PRINT_DEBUG("BGetUserAchievementStatus\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return false;
 }
 
@@ -490,7 +521,7 @@ HAuthTicket Steam_GameServer::GetAuthSessionTicket( void *pTicket, int cbMaxTick
 HAuthTicket Steam_GameServer::GetAuthSessionTicket( void *pTicket, int cbMaxTicket, uint32 *pcbTicket, const SteamNetworkingIdentity *pSnid )
 {
     PRINT_DEBUG("Steam_GameServer::GetAuthSessionTicket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     return ticket_manager->getTicket(pTicket, cbMaxTicket, pcbTicket);
 }
@@ -501,7 +532,7 @@ HAuthTicket Steam_GameServer::GetAuthSessionTicket( void *pTicket, int cbMaxTick
 EBeginAuthSessionResult Steam_GameServer::BeginAuthSession( const void *pAuthTicket, int cbAuthTicket, CSteamID steamID )
 {
     PRINT_DEBUG("Steam_GameServer::BeginAuthSession %i %llu\n", cbAuthTicket, steamID.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     return ticket_manager->beginAuth(pAuthTicket, cbAuthTicket, steamID );
 }
@@ -511,7 +542,7 @@ EBeginAuthSessionResult Steam_GameServer::BeginAuthSession( const void *pAuthTic
 void Steam_GameServer::EndAuthSession( CSteamID steamID )
 {
     PRINT_DEBUG("Steam_GameServer::EndAuthSession %llu\n", steamID.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     ticket_manager->endAuth(steamID);
 }
@@ -521,7 +552,7 @@ void Steam_GameServer::EndAuthSession( CSteamID steamID )
 void Steam_GameServer::CancelAuthTicket( HAuthTicket hAuthTicket )
 {
     PRINT_DEBUG("Steam_GameServer::CancelAuthTicket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     ticket_manager->cancelTicket(hAuthTicket);
 }
@@ -541,7 +572,7 @@ EUserHasLicenseForAppResult Steam_GameServer::UserHasLicenseForApp( CSteamID ste
 bool Steam_GameServer::RequestUserGroupStatus( CSteamID steamIDUser, CSteamID steamIDGroup )
 {
     PRINT_DEBUG("RequestUserGroupStatus\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return true;
 }
 
@@ -558,7 +589,7 @@ STEAM_CALL_RESULT( GSReputation_t )
 SteamAPICall_t Steam_GameServer::GetServerReputation()
 {
     PRINT_DEBUG("GetServerReputation\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return 0;
 }
 
@@ -569,7 +600,7 @@ SteamAPICall_t Steam_GameServer::GetServerReputation()
 uint32 Steam_GameServer::GetPublicIP_old()
 {
     PRINT_DEBUG("GetPublicIP_old\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     uint32 ip = network->getOwnIP();
     PRINT_DEBUG("%X\n", ip);
     return ip;
@@ -607,7 +638,21 @@ void Steam_GameServer::GetPublicIP_fix(SteamIPAddress_t *out)
 bool Steam_GameServer::HandleIncomingPacket( const void *pData, int cbData, uint32 srcIP, uint16 srcPort )
 {
     PRINT_DEBUG("HandleIncomingPacket %i %X %i\n", cbData, srcIP, srcPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    if (!pData || cbData <= 0) return false;
+
+    std::vector<std::string> replies;
+    if (!answer_query(pData, cbData, srcIP, replies)) return false;
+
+    //GetNextOutgoingPacket takes them from the back
+    for (auto r = replies.rbegin(); r != replies.rend(); ++r) {
+        struct Gameserver_Outgoing_Packet packet;
+        packet.data = std::move(*r);
+        packet.ip = srcIP;
+        packet.port = srcPort;
+        outgoing_packets.insert(outgoing_packets.begin(), std::move(packet));
+    }
+
     return true;
 }
 
@@ -619,7 +664,7 @@ bool Steam_GameServer::HandleIncomingPacket( const void *pData, int cbData, uint
 int Steam_GameServer::GetNextOutgoingPacket( void *pOut, int cbMaxOut, uint32 *pNetAdr, uint16 *pPort )
 {
     PRINT_DEBUG("GetNextOutgoingPacket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (outgoing_packets.size() == 0) return 0;
 
     if (outgoing_packets.back().data.size() < cbMaxOut) cbMaxOut = outgoing_packets.back().data.size();
@@ -687,7 +732,7 @@ STEAM_CALL_RESULT( AssociateWithClanResult_t )
 SteamAPICall_t Steam_GameServer::AssociateWithClan( CSteamID steamIDClan )
 {
     PRINT_DEBUG("AssociateWithClan\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return 0;
 }
 
@@ -697,10 +742,38 @@ STEAM_CALL_RESULT( ComputeNewPlayerCompatibilityResult_t )
 SteamAPICall_t Steam_GameServer::ComputeNewPlayerCompatibility( CSteamID steamIDNewPlayer )
 {
     PRINT_DEBUG("ComputeNewPlayerCompatibility\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return 0;
 }
 
+bool Steam_GameServer::answer_query(const void *data, size_t length, uint32 ip, std::vector<std::string> &replies)
+{
+    uint32 appid = settings->get_local_game_id().AppID();
+    if (server_data.appid() != appid) {
+        server_data.set_appid(appid);
+        source_query.info_changed();
+    }
+
+    struct Source_Query_Server server = {server_data, players, ticket_manager->countInboundAuth(), !!(flags & k_unServerFlagSecure)};
+    return source_query.handle_query(data, length, ip, server, replies);
+}
+
+void Steam_GameServer::query_callback(void *object, const char *data, unsigned length, uint32 ip, uint16 port, std::vector<std::string> &replies)
+{
+    Steam_GameServer *steam_gameserver = (Steam_GameServer *)object;
+    steam_gameserver->answer_query(data, length, ip, replies);
+}
+
+//when the game doesn't share its socket for the queries the emu answers them on the query port itself
+void Steam_GameServer::open_query_port()
+{
+    uint16 port = server_data.query_port();
+    if (port == 0 || port == STEAMGAMESERVER_QUERY_PORT_SHARED) return;
+    if (!network->openQuerySocket(port, &Steam_GameServer::query_callback, this)) {
+        PRINT_DEBUG("Steam_GameServer could not open query port %hu\n", port);
+    }
+}
+
 void Steam_GameServer::RunCallbacks()
 {
     bool temp_call_servers_connected = call_servers_connected;
@@ -16,6 +16,7 @@
    <http://www.gnu.org/licenses/>.  */
 
 #include "base.h"
+#include "source_query.h"
  
 //-----------------------------------------------------------------------------
 // Purpose: Functions for authenticating users via Steam to play on a game server
@@ -58,6 +59,13 @@ public ISteamGameServer
     Auth_Ticket_Manager *ticket_manager;
 
     std::vector<struct Gameserver_Outgoing_Packet> outgoing_packets;
+
+    Source_Query source_query;
+    //players set with BUpdateUserData, listed in the A2S_PLAYER replies
+    std::map<uint64, struct Source_Query_Player> players;
+    bool answer_query(const void *data, size_t length, uint32 ip, std::vector<std::string> &replies);
+    void open_query_port();
+    static void query_callback(void *object, const char *data, unsigned length, uint32 ip, uint16 port, std::vector<std::string> &replies);
 public:
 
     Steam_GameServer(class Settings *settings, class Networking *network, class SteamCallBacks *callbacks);
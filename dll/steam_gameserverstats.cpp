@@ -34,7 +34,7 @@ STEAM_CALL_RESULT( GSStatsReceived_t )
 SteamAPICall_t Steam_GameServerStats::RequestUserStats( CSteamID steamIDUser )
 {
     PRINT_DEBUG("RequestUserStats\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     GSStatsReceived_t data;
     data.m_eResult = k_EResultFail;//k_EResultOK;
@@ -109,7 +109,7 @@ STEAM_CALL_RESULT( GSStatsStored_t )
 SteamAPICall_t Steam_GameServerStats::StoreUserStats( CSteamID steamIDUser )
 {
     PRINT_DEBUG("StoreUserStats\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     GSStatsStored_t data;
     data.m_eResult = k_EResultOK;
@@ -157,7 +157,7 @@ STEAM_METHOD_DESC(Find out the status of an asynchronous inventory result handle
 EResult GetResultStatus( SteamInventoryResult_t resultHandle )
 {
     PRINT_DEBUG("GetResultStatus\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests *request = get_inventory_result(resultHandle);
     if (!request) return k_EResultInvalidParam;
     if (!request->result_done()) return k_EResultPending;
@@ -173,7 +173,7 @@ bool GetResultItems( SteamInventoryResult_t resultHandle,
                             uint32 *punOutItemsArraySize )
 {
     PRINT_DEBUG("GetResultItems\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests *request = get_inventory_result(resultHandle);
     if (!request) return false;
     if (!request->result_done()) return false;
@@ -269,7 +269,7 @@ STEAM_METHOD_DESC(Returns the server time at which the result was generated. Com
 uint32 GetResultTimestamp( SteamInventoryResult_t resultHandle )
 {
     PRINT_DEBUG("GetResultTimestamp\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests *request = get_inventory_result(resultHandle);
     if (!request || !request->result_done()) return 0;
     return request->timestamp();
@@ -293,7 +293,7 @@ STEAM_METHOD_DESC(Destroys a result handle and frees all associated memory.)
 void DestroyResult( SteamInventoryResult_t resultHandle )
 {
     PRINT_DEBUG("DestroyResult\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto request = std::find_if(inventory_requests.begin(), inventory_requests.end(), [&resultHandle](struct Steam_Inventory_Requests const& item) { return item.inventory_result == resultHandle; });
     if (inventory_requests.end() == request)
         return;
@@ -317,7 +317,7 @@ STEAM_METHOD_DESC(Captures the entire state of the current users Steam inventory
 bool GetAllItems( SteamInventoryResult_t *pResultHandle )
 {
     PRINT_DEBUG("GetAllItems\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests* request = new_inventory_result();
 
     if (pResultHandle != nullptr)
@@ -339,7 +339,7 @@ STEAM_METHOD_DESC(Captures the state of a subset of the current users Steam inve
 bool GetItemsByID( SteamInventoryResult_t *pResultHandle, STEAM_ARRAY_COUNT( unCountInstanceIDs ) const SteamItemInstanceID_t *pInstanceIDs, uint32 unCountInstanceIDs )
 {
     PRINT_DEBUG("GetItemsByID\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (pResultHandle) {
         struct Steam_Inventory_Requests *request = new_inventory_result(false, pInstanceIDs, unCountInstanceIDs);
         *pResultHandle = request->inventory_result;
@@ -369,7 +369,7 @@ bool GetItemsByID( SteamInventoryResult_t *pResultHandle, STEAM_ARRAY_COUNT( unC
 bool SerializeResult( SteamInventoryResult_t resultHandle, STEAM_OUT_BUFFER_COUNT(punOutBufferSize) void *pOutBuffer, uint32 *punOutBufferSize )
 {
     PRINT_DEBUG("SerializeResult %i\n", resultHandle);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //TODO
     struct Steam_Inventory_Requests *request = get_inventory_result(resultHandle);
     if (!request) return false;
@@ -415,7 +415,7 @@ bool SerializeResult( SteamInventoryResult_t resultHandle, STEAM_OUT_BUFFER_COUN
 bool DeserializeResult( SteamInventoryResult_t *pOutResultHandle, STEAM_BUFFER_COUNT(punOutBufferSize) const void *pBuffer, uint32 unBufferSize, bool bRESERVED_MUST_BE_FALSE)
 {
     PRINT_DEBUG("DeserializeResult\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //TODO
     if (pOutResultHandle) {
         struct Steam_Inventory_Requests *request = new_inventory_result(false);
@@ -452,7 +452,7 @@ STEAM_METHOD_DESC(GrantPromoItems() checks the list of promotional items for whi
 bool GrantPromoItems( SteamInventoryResult_t *pResultHandle )
 {
     PRINT_DEBUG("GrantPromoItems\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests* request = new_inventory_result(false);
 
     if (pResultHandle != nullptr)
@@ -469,7 +469,7 @@ bool AddPromoItem( SteamInventoryResult_t *pResultHandle, SteamItemDef_t itemDef
 {
     PRINT_DEBUG("AddPromoItem\n");
     //TODO
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests* request = new_inventory_result(false);
 
     if (pResultHandle != nullptr)
@@ -481,7 +481,7 @@ bool AddPromoItems( SteamInventoryResult_t *pResultHandle, STEAM_ARRAY_COUNT(unA
 {
     PRINT_DEBUG("AddPromoItems\n");
     //TODO
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests* request = new_inventory_result(false);
 
     if (pResultHandle != nullptr)
@@ -497,7 +497,7 @@ STEAM_METHOD_DESC(ConsumeItem() removes items from the inventory permanently.)
 bool ConsumeItem( SteamInventoryResult_t *pResultHandle, SteamItemInstanceID_t itemConsume, uint32 unQuantity )
 {
     PRINT_DEBUG("ConsumeItem %llu %u\n", itemConsume, unQuantity);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto it = user_items.find(std::to_string(itemConsume));
     if (it != user_items.end()) {
@@ -583,7 +583,7 @@ bool TriggerItemDrop( SteamInventoryResult_t *pResultHandle, SteamItemDef_t drop
 {
     PRINT_DEBUG("TriggerItemDrop %p %i\n", pResultHandle, dropListDefinition);
     //TODO: if gameserver return false
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Inventory_Requests* request = new_inventory_result(false);
 
     if (pResultHandle != nullptr)
@@ -622,7 +622,7 @@ STEAM_METHOD_DESC(LoadItemDefinitions triggers the automatic load and refresh of
 bool LoadItemDefinitions()
 {
     PRINT_DEBUG("LoadItemDefinitions\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (!item_definitions_loaded)  {
         call_definition_update = true;
@@ -644,7 +644,7 @@ bool GetItemDefinitionIDs(
             STEAM_DESC(Size of array is passed in and actual size used is returned in this param) uint32 *punItemDefIDsArraySize )
 {
     PRINT_DEBUG("GetItemDefinitionIDs %p\n", pItemDefIDs);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!punItemDefIDsArraySize)
         return false;
 
@@ -682,7 +682,7 @@ bool GetItemDefinitionProperty( SteamItemDef_t iDefinition, const char *pchPrope
     STEAM_OUT_STRING_COUNT(punValueBufferSizeOut) char *pchValueBuffer, uint32 *punValueBufferSizeOut )
 {
     PRINT_DEBUG("GetItemDefinitionProperty %i %s\n", iDefinition, pchPropertyName);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto item = defined_items.find(std::to_string(iDefinition));
     if (item != defined_items.end())
@@ -21,6 +21,7 @@
 
 #define PENDING_JOIN_TIMEOUT 10.0
 #define REQUEST_LOBBY_DATA_TIMEOUT 6.0
+#define LOBBY_SNAPSHOT_REQUEST_RATE 1.0
 #define LOBBY_DELETED_TIMEOUT 2
 
 struct Pending_Joins {
@@ -50,6 +51,31 @@ struct Filter_Values {
 	ELobbyComparison eComparisonType;
 };
 
+struct Near_Filter_Value {
+    std::string key;
+    int value;
+};
+
+//the filters of a RequestLobbyList call, compiled once so each lobby is checked in a single pass over its values
+struct Lobby_Search_Key {
+    std::vector<unsigned> filters;
+    std::vector<unsigned> near_filters;
+};
+
+struct Lobby_Search {
+    std::vector<struct Filter_Values> filters;
+    std::vector<int> near_values;
+    //lowercase key -> filters and near values on that key
+    std::unordered_map<std::string, struct Lobby_Search_Key> keys;
+    unsigned slots_available;
+    unsigned max_results;
+};
+
+struct Lobby_Search_Result {
+    CSteamID id;
+    std::vector<uint64> near_distance;
+};
+
 struct Chat_Entry {
     std::string message;
     EChatEntryType type;
@@ -81,9 +107,11 @@ public ISteamMatchmaking
     std::vector<struct Pending_Creates> pending_creates;
 
     std::vector<struct Filter_Values> filter_values;
+    std::vector<struct Near_Filter_Value> filter_near_values;
+    int filter_slots_available;
     int filter_max_results;
-    std::vector<struct Filter_Values> filter_values_copy;
-    int filter_max_results_copy;
+    struct Lobby_Search lobby_search;
+    bool lobby_search_checked;
     std::vector<CSteamID> filtered_lobbies;
     std::chrono::high_resolution_clock::time_point lobby_last_search;
     SteamAPICall_t search_call_api_id;
@@ -93,6 +121,10 @@ public ISteamMatchmaking
     std::vector<struct Data_Requested> data_requested;
 
     std::map<uint64, ::google::protobuf::Map<std::string, std::string>> self_lobby_member_data;
+
+    //lobbies we own: the state the other peers have, changes are sent as deltas against it
+    std::map<uint64, Lobby> sent_lobbies;
+    std::map<uint64, std::chrono::high_resolution_clock::time_point> lobby_snapshot_requests;
 google::protobuf::Map<std::string,std::string>::const_iterator caseinsensitive_find(const ::google::protobuf::Map< ::std::string, ::std::string >& map, std::string key)
 {
     auto x = map.begin();
@@ -121,6 +153,224 @@ Lobby *get_lobby(CSteamID id)
     return &(*lobby);
 }
 
+static bool lobby_values_delta(const ::google::protobuf::Map<std::string, std::string> &old_values, const ::google::protobuf::Map<std::string, std::string> &values,
+                               ::google::protobuf::Map<std::string, std::string> *changed, ::google::protobuf::RepeatedPtrField<std::string> *removed)
+{
+    bool ret = false;
+    for (auto const &v : values) {
+        auto old = old_values.find(v.first);
+        if (old == old_values.end() || old->second != v.second) {
+            (*changed)[v.first] = v.second;
+            ret = true;
+        }
+    }
+
+    for (auto const &v : old_values) {
+        if (values.find(v.first) == values.end()) {
+            *removed->Add() = v.first;
+            ret = true;
+        }
+    }
+
+    return ret;
+}
+
+static Lobby lobby_header(const Lobby &lobby)
+{
+    Lobby header(lobby);
+    header.clear_values();
+    header.clear_members();
+    header.clear_revision();
+    return header;
+}
+
+//returns false if the peers can't get from old to lobby with a delta
+static bool make_lobby_delta(const Lobby &old, const Lobby &lobby, Lobby_Delta *delta, bool *changed)
+{
+    //members are only ever appended or removed, anything else breaks the member order
+    std::vector<uint64> old_order, new_order;
+    for (auto const &m : old.members()) {
+        if (get_lobby_member((Lobby *)&lobby, (uint64)m.id())) old_order.push_back(m.id());
+    }
+
+    for (auto const &m : lobby.members()) {
+        Lobby_Member *old_member = get_lobby_member((Lobby *)&old, (uint64)m.id());
+        if (old_member) {
+            new_order.push_back(m.id());
+            Lobby_Delta_Member member;
+            member.set_id(m.id());
+            if (lobby_values_delta(old_member->values(), m.values(), member.mutable_values(), member.mutable_removed_values())) {
+                *delta->add_members() = member;
+            }
+        } else {
+            Lobby_Delta_Member *member = delta->add_members();
+            member->set_id(m.id());
+            member->set_added(true);
+            *member->mutable_values() = m.values();
+        }
+    }
+
+    if (old_order != new_order) return false;
+
+    for (auto const &m : old.members()) {
+        if (!get_lobby_member((Lobby *)&lobby, (uint64)m.id())) delta->add_removed_members(m.id());
+    }
+
+    bool values_changed = lobby_values_delta(old.values(), lobby.values(), delta->mutable_values(), delta->mutable_removed_values());
+    *delta->mutable_header() = lobby_header(lobby);
+    *changed = values_changed || delta->members_size() || delta->removed_members_size() || !protobuf_message_equal(delta->header(), lobby_header(old));
+    return true;
+}
+
+static void lobby_hash_add(uint64 *hash, const std::string &data)
+{
+    //FNV-1a, the length goes in too so that moving bytes between fields changes the hash
+    uint64 length = data.size();
+    for (unsigned i = 0; i < sizeof(length); ++i) {
+        *hash = (*hash ^ ((length >> (i * 8)) & 0xFF)) * 0x100000001B3ULL;
+    }
+
+    for (unsigned char c : data) {
+        *hash = (*hash ^ c) * 0x100000001B3ULL;
+    }
+}
+
+static void lobby_hash_values(uint64 *hash, const ::google::protobuf::Map<std::string, std::string> &values)
+{
+    //map iteration order isn't the same on every peer
+    std::map<std::string, std::string> sorted(values.begin(), values.end());
+    lobby_hash_add(hash, std::to_string(sorted.size()));
+    for (auto const &v : sorted) {
+        lobby_hash_add(hash, v.first);
+        lobby_hash_add(hash, v.second);
+    }
+}
+
+//hash of everything in the lobby except the revision, the same on every peer that has the same lobby
+static uint64 lobby_hash(const Lobby &lobby)
+{
+    uint64 hash = 0xCBF29CE484222325ULL;
+    lobby_hash_add(&hash, lobby_header(lobby).SerializeAsString());
+    lobby_hash_values(&hash, lobby.values());
+    for (auto const &m : lobby.members()) {
+        lobby_hash_add(&hash, std::to_string(m.id()));
+        lobby_hash_values(&hash, m.values());
+    }
+
+    return hash;
+}
+
+//returns false if the delta changes a member the lobby doesn't have
+static bool apply_lobby_delta(Lobby *lobby, const Lobby_Delta &delta)
+{
+    Lobby header(delta.header());
+    header.set_revision(delta.revision());
+    *header.mutable_values() = lobby->values();
+    *header.mutable_members() = lobby->members();
+
+    for (auto const &key : delta.removed_values()) {
+        header.mutable_values()->erase(key);
+    }
+
+    for (auto const &v : delta.values()) {
+        (*header.mutable_values())[v.first] = v.second;
+    }
+
+    for (auto const &id : delta.removed_members()) {
+        leave_lobby(&header, (uint64)id);
+    }
+
+    for (auto const &m : delta.members()) {
+        Lobby_Member *member = get_lobby_member(&header, (uint64)m.id());
+        if (m.added()) {
+            if (!member) {
+                member = header.add_members();
+                member->set_id(m.id());
+            }
+
+            member->clear_values();
+        } else if (!member) {
+            //only the changed values were sent, adding the member back with them would be missing the rest
+            return false;
+        }
+
+        for (auto const &key : m.removed_values()) {
+            member->mutable_values()->erase(key);
+        }
+
+        for (auto const &v : m.values()) {
+            (*member->mutable_values())[v.first] = v.second;
+        }
+    }
+
+    *lobby = header;
+    return true;
+}
+
+void send_lobby_snapshot(Lobby *l, uint64 dest_id=0)
+{
+    PRINT_DEBUG("Sending lobby snapshot %llu %llu revision %llu\n", l->room_id(), dest_id, l->revision());
+    Common_Message msg = Common_Message();
+    msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
+    msg.set_allocated_lobby(new Lobby(*l));
+    if (dest_id) {
+        msg.set_dest_id(dest_id);
+        network->sendTo(&msg, true);
+    } else {
+        network->sendToAllIndividuals(&msg, true);
+    }
+}
+
+//sends what changed in a lobby we own since the last time it was sent, heartbeat sends the revision even if nothing changed
+void send_lobby_changes(Lobby *l, bool heartbeat=false)
+{
+    auto sent = sent_lobbies.find(l->room_id());
+    Lobby_Delta *delta = new Lobby_Delta();
+    bool changed = false;
+    if (sent == sent_lobbies.end() || !make_lobby_delta(sent->second, *l, delta, &changed)) {
+        delete delta;
+        if (sent != sent_lobbies.end()) l->set_revision(l->revision() + 1);
+        send_lobby_snapshot(l);
+        sent_lobbies[l->room_id()] = *l;
+        return;
+    }
+
+    if (!changed && !heartbeat) {
+        delete delta;
+        return;
+    }
+
+    delta->set_room_id(l->room_id());
+    delta->set_base_revision(sent->second.revision());
+    if (changed) l->set_revision(l->revision() + 1);
+    delta->set_revision(l->revision());
+    delta->set_hash(lobby_hash(*l));
+    PRINT_DEBUG("Sending lobby delta %llu revision %llu -> %llu\n", l->room_id(), delta->base_revision(), delta->revision());
+
+    Common_Message msg = Common_Message();
+    msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
+    msg.set_allocated_lobby_delta(delta);
+    network->sendToAllIndividuals(&msg, true);
+    sent->second = *l;
+}
+
+void request_lobby_snapshot(uint64 room_id, uint64 owner)
+{
+    auto requested = lobby_snapshot_requests.find(room_id);
+    if (requested != lobby_snapshot_requests.end() && !check_timedout(requested->second, LOBBY_SNAPSHOT_REQUEST_RATE)) return;
+    lobby_snapshot_requests[room_id] = std::chrono::high_resolution_clock::now();
+
+    PRINT_DEBUG("Requesting lobby snapshot %llu from %llu\n", room_id, owner);
+    Common_Message msg = Common_Message();
+    Lobby_Messages *message = new Lobby_Messages();
+    message->set_type(Lobby_Messages::REQUEST_LOBBY);
+    message->set_id(room_id);
+    msg.set_allocated_lobby_messages(message);
+    msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
+    msg.set_dest_id(owner);
+    network->sendTo(&msg, true);
+}
+
 void send_lobby_data()
 {
     PRINT_DEBUG("Sending lobbies %zu\n", lobbies.size());
@@ -128,10 +378,17 @@ void send_lobby_data()
     for(auto & l: lobbies) {
         if (get_lobby_member(&l, settings->get_local_steam_id()) && l.owner() == settings->get_local_steam_id().ConvertToUint64() && !l.deleted()) {
             PRINT_DEBUG("Sending lobby %llu\n", l.room_id());
-            Common_Message msg = Common_Message();
-            msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
-            msg.set_allocated_lobby(new Lobby(l));
-            network->sendToAllIndividuals(&msg, true);
+            send_lobby_changes(&l, true);
+        }
+    }
+
+    auto s = std::begin(sent_lobbies);
+    while (s != std::end(sent_lobbies)) {
+        Lobby *l = get_lobby((uint64)s->first);
+        if (!l || l->owner() != settings->get_local_steam_id().ConvertToUint64()) {
+            s = sent_lobbies.erase(s);
+        } else {
+            ++s;
         }
     }
 }
@@ -156,10 +413,7 @@ void trigger_lobby_dataupdate(CSteamID lobby, CSteamID member, bool success, dou
     Lobby *l = get_lobby(lobby);
     if (l && l->owner() == settings->get_local_steam_id().ConvertToUint64()) {
         if (send_changed_lobby) {
-            Common_Message msg = Common_Message();
-            msg.set_source_id(settings->get_local_steam_id().ConvertToUint64());
-            msg.set_allocated_lobby(new Lobby(*l));
-            network->sendToAllIndividuals(&msg, true);
+            send_lobby_changes(l);
         }
     }
 }
@@ -266,6 +520,8 @@ void remove_lobbies()
         if (g->members().size() == 0 || (g->deleted() && (g->time_deleted() + LOBBY_DELETED_TIMEOUT < current_time))) {
             PRINT_DEBUG("REMOVING LOBBY %llu\n", g->room_id());
             self_lobby_member_data.erase(g->room_id());
+            sent_lobbies.erase(g->room_id());
+            lobby_snapshot_requests.erase(g->room_id());
             g = lobbies.erase(g);
         } else {
             ++g;
@@ -315,6 +571,7 @@ Steam_Matchmaking(class Settings *settings, class Networking *network, class Ste
     this->callback_results = callback_results;
     this->callbacks = callbacks;
     this->filter_max_results = FILTER_MAX_DEFAULT;
+    this->filter_slots_available = 0;
     search_call_api_id = 0;
     searching = false;
 }
@@ -405,18 +662,148 @@ bool RemoveFavoriteGame( AppId_t nAppID, uint32 nIP, uint16 nConnPort, uint16 nQ
 */
 // 
 #define LOBBY_SEARCH_TIMEOUT 0.2 //Tested on real steam
+
+static std::string lobby_key_lower(const std::string &key)
+{
+    std::string lower(key);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    return lower;
+}
+
+//same as std::stoll(value, 0, 0) used to be: empty is 0, something that doesn't start with a number never matches
+static bool parse_lobby_number(const std::string &value, long long *number)
+{
+    if (value.empty()) {
+        *number = 0;
+        return true;
+    }
+
+    const char *start = value.c_str();
+    char *end = NULL;
+    errno = 0;
+    *number = strtoll(start, &end, 0);
+    return end != start && errno != ERANGE;
+}
+
+template<typename T>
+static bool lobby_compare(const T &lobby_value, const T &value, ELobbyComparison eComparisonType)
+{
+    switch (eComparisonType) {
+        case k_ELobbyComparisonEqualToOrLessThan: return lobby_value <= value;
+        case k_ELobbyComparisonLessThan: return lobby_value < value;
+        case k_ELobbyComparisonEqual: return lobby_value == value;
+        case k_ELobbyComparisonGreaterThan: return lobby_value > value;
+        case k_ELobbyComparisonEqualToOrGreaterThan: return lobby_value >= value;
+        case k_ELobbyComparisonNotEqual: return lobby_value != value;
+    }
+
+    return false;
+}
+
+void compile_lobby_search()
+{
+    lobby_search.filters = filter_values;
+    lobby_search.near_values.clear();
+    lobby_search.keys.clear();
+    for (unsigned i = 0; i < lobby_search.filters.size(); ++i) {
+        lobby_search.keys[lobby_key_lower(lobby_search.filters[i].key)].filters.push_back(i);
+    }
+
+    for (auto & n : filter_near_values) {
+        lobby_search.keys[lobby_key_lower(n.key)].near_filters.push_back(lobby_search.near_values.size());
+        lobby_search.near_values.push_back(n.value);
+    }
+
+    lobby_search.slots_available = filter_slots_available > 0 ? filter_slots_available : 0;
+    lobby_search.max_results = filter_max_results < 0 ? FILTER_MAX_DEFAULT : filter_max_results;
+}
+
+bool lobby_search_matches(const Lobby &l, struct Lobby_Search_Result *result)
+{
+    if (!l.joinable() || !(l.type() == k_ELobbyTypePublic || l.type() == k_ELobbyTypeInvisible || l.type() == k_ELobbyTypeFriendsOnly) || l.deleted()) return false;
+    if (lobby_search.slots_available && l.member_limit() && l.member_limit() < l.members_size() + lobby_search.slots_available) return false;
+
+    std::vector<bool> found(lobby_search.filters.size(), false);
+    result->near_distance.assign(lobby_search.near_values.size(), UINT64_MAX);
+    if (!lobby_search.keys.empty()) {
+        for (auto const &v : l.values()) {
+            auto key = lobby_search.keys.find(lobby_key_lower(v.first));
+            if (key == lobby_search.keys.end()) continue;
+
+            long long number = 0;
+            bool is_number = parse_lobby_number(v.second, &number);
+            for (auto i : key->second.filters) {
+                const struct Filter_Values &f = lobby_search.filters[i];
+                found[i] = true;
+                bool match;
+                if (f.is_int) {
+                    match = is_number && lobby_compare(number, (long long)f.value_int, f.eComparisonType);
+                } else {
+                    match = lobby_compare(v.second, f.value_string, f.eComparisonType);
+                }
+
+                if (!match) return false;
+            }
+
+            for (auto i : key->second.near_filters) {
+                long long near_value = lobby_search.near_values[i];
+                if (is_number) result->near_distance[i] = number > near_value ? (uint64)number - (uint64)near_value : (uint64)near_value - (uint64)number;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < found.size(); ++i) {
+        //a lobby without the key only matches a not equal filter
+        if (!found[i] && lobby_search.filters[i].eComparisonType != k_ELobbyComparisonNotEqual) return false;
+    }
+
+    result->id = (uint64)l.room_id();
+    return true;
+}
+
+//done is false when called right after the search started, it only completes then if it already has enough lobbies
+void find_lobbies(bool done)
+{
+    std::vector<struct Lobby_Search_Result> results;
+    struct Lobby_Search_Result result;
+    for (auto & l : lobbies) {
+        if (lobby_search_matches(l, &result)) results.push_back(result);
+    }
+
+    PRINT_DEBUG("Lobby search %zu lobbies, %zu filters, %zu near, %zu matches\n", lobbies.size(), lobby_search.filters.size(), lobby_search.near_values.size(), results.size());
+    if (!done && (!lobby_search.near_values.empty() || results.size() < lobby_search.max_results)) return;
+
+    if (!lobby_search.near_values.empty()) {
+        std::stable_sort(results.begin(), results.end(), [](struct Lobby_Search_Result const& a, struct Lobby_Search_Result const& b) { return a.near_distance < b.near_distance; });
+    }
+
+    if (results.size() > lobby_search.max_results) results.resize(lobby_search.max_results);
+    filtered_lobbies.clear();
+    for (auto & r : results) {
+        filtered_lobbies.push_back(r.id);
+    }
+
+    LobbyMatchList_t data;
+    data.m_nLobbiesMatching = filtered_lobbies.size();
+    callback_results->addCallResult(search_call_api_id, data.k_iCallback, &data, sizeof(data));
+    callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
+    searching = false;
+    search_call_api_id = 0;
+}
 STEAM_CALL_RESULT( LobbyMatchList_t )
 SteamAPICall_t RequestLobbyList()
 {
     PRINT_DEBUG("RequestLobbyList\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     filtered_lobbies.clear();
     lobby_last_search = std::chrono::high_resolution_clock::now();
-    filter_values_copy = filter_values;
-    filter_max_results_copy = filter_max_results;
+    compile_lobby_search();
     filter_values.clear();
+    filter_near_values.clear();
+    filter_slots_available = 0;
     filter_max_results = FILTER_MAX_DEFAULT;
     searching = true;
+    lobby_search_checked = false;
     if (search_call_api_id) callback_results->rmCallBack(search_call_api_id, NULL);
     search_call_api_id = callback_results->reserveCallResult();
 
@@ -439,7 +826,7 @@ void AddRequestLobbyListStringFilter( const char *pchKeyToMatch, const char *pch
     PRINT_DEBUG("AddRequestLobbyListStringFilter %s %s %i\n", pchKeyToMatch, pchValueToMatch, eComparisonType);
     if (!pchValueToMatch) return;
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Filter_Values fv;
     fv.key = std::string(pchKeyToMatch);
     fv.value_string = std::string(pchValueToMatch);
@@ -453,7 +840,7 @@ void AddRequestLobbyListStringFilter( const char *pchKeyToMatch, const char *pch
 void AddRequestLobbyListNumericalFilter( const char *pchKeyToMatch, int nValueToMatch, ELobbyComparison eComparisonType )
 {
     PRINT_DEBUG("AddRequestLobbyListNumericalFilter %s %i %i\n", pchKeyToMatch, nValueToMatch, eComparisonType);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Filter_Values fv;
     fv.key = std::string(pchKeyToMatch);
     fv.value_int = nValueToMatch;
@@ -467,34 +854,35 @@ void AddRequestLobbyListNumericalFilter( const char *pchKeyToMatch, int nValueTo
 void AddRequestLobbyListNearValueFilter( const char *pchKeyToMatch, int nValueToBeCloseTo )
 {
     PRINT_DEBUG("AddRequestLobbyListNearValueFilter %s %u\n", pchKeyToMatch, nValueToBeCloseTo);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    if (!pchKeyToMatch) return;
 
-    
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    struct Near_Filter_Value near_filter;
+    near_filter.key = std::string(pchKeyToMatch);
+    near_filter.value = nValueToBeCloseTo;
+    filter_near_values.push_back(near_filter);
 }
 
 // returns only lobbies with the specified number of slots available
 void AddRequestLobbyListFilterSlotsAvailable( int nSlotsAvailable )
 {
     PRINT_DEBUG("AddRequestLobbyListFilterSlotsAvailable %i\n", nSlotsAvailable);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-
-    
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    filter_slots_available = nSlotsAvailable;
 }
 
 // sets the distance for which we should search for lobbies (based on users IP address to location map on the Steam backed)
 void AddRequestLobbyListDistanceFilter( ELobbyDistanceFilter eLobbyDistanceFilter )
 {
     PRINT_DEBUG("AddRequestLobbyListDistanceFilter %i\n", eLobbyDistanceFilter);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-
-    
+    //every lobby we can see is on the LAN so even k_ELobbyDistanceFilterClose matches all of them
 }
 
 // sets how many results to return, the lower the count the faster it is to download the lobby results & details to the client
 void AddRequestLobbyListResultCountFilter( int cMaxResults )
 {
     PRINT_DEBUG("AddRequestLobbyListResultCountFilter %i\n", cMaxResults);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     filter_max_results = cMaxResults;
     
 }
@@ -503,7 +891,7 @@ void AddRequestLobbyListResultCountFilter( int cMaxResults )
 void AddRequestLobbyListCompatibleMembersFilter( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("AddRequestLobbyListCompatibleMembersFilter\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     
 }
@@ -520,7 +908,7 @@ void AddRequestLobbyListNumericalFilter( const char *pchKeyToMatch, int nValueTo
 
 void AddRequestLobbyListSlotsAvailableFilter()
 {
-    
+    AddRequestLobbyListFilterSlotsAvailable(1);
 }
 
 // returns the CSteamID of a lobby, as retrieved by a RequestLobbyList call
@@ -530,7 +918,7 @@ void AddRequestLobbyListSlotsAvailableFilter()
 CSteamID GetLobbyByIndex( int iLobby )
 {
     PRINT_DEBUG("GetLobbyByIndex %i\n", iLobby);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     CSteamID id = k_steamIDNil;
     if (0 <= iLobby && iLobby < filtered_lobbies.size()) id = filtered_lobbies[iLobby];
     PRINT_DEBUG("Lobby %llu\n", id.ConvertToUint64());
@@ -622,7 +1010,7 @@ STEAM_CALL_RESULT( LobbyCreated_t )
 SteamAPICall_t CreateLobby( ELobbyType eLobbyType, int cMaxMembers )
 {
     PRINT_DEBUG("CreateLobby type: %i max_members: %i\n", eLobbyType, cMaxMembers);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Pending_Creates p_c;
     p_c.api_id = callback_results->reserveCallResult();
     p_c.eLobbyType = eLobbyType;
@@ -655,7 +1043,7 @@ STEAM_CALL_RESULT( LobbyEnter_t )
 SteamAPICall_t JoinLobby( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("JoinLobby %llu\n", steamIDLobby.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto pj = std::find_if(pending_joins.begin(), pending_joins.end(), [&steamIDLobby](Pending_Joins const& item) {return item.lobby_id == steamIDLobby;});
     if (pj != pending_joins.end()) return pj->api_id;
@@ -683,7 +1071,7 @@ void JoinLobby_OLD( CSteamID steamIDLobby )
 void LeaveLobby( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("LeaveLobby\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     PRINT_DEBUG("LeaveLobby pass mutex\n");
     Lobby *lobby = get_lobby(steamIDLobby);
     if (lobby) {
@@ -728,7 +1116,7 @@ void LeaveLobby( CSteamID steamIDLobby )
 bool InviteUserToLobby( CSteamID steamIDLobby, CSteamID steamIDInvitee )
 {
     PRINT_DEBUG("InviteUserToLobby\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby) return false;
 
@@ -752,7 +1140,7 @@ bool InviteUserToLobby( CSteamID steamIDLobby, CSteamID steamIDInvitee )
 int GetNumLobbyMembers( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("GetNumLobbyMembers %llu\n", steamIDLobby.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     int ret = 0;
     if (lobby) ret = lobby->members().size();
@@ -767,7 +1155,7 @@ int GetNumLobbyMembers( CSteamID steamIDLobby )
 CSteamID GetLobbyMemberByIndex( CSteamID steamIDLobby, int iMember )
 {
     PRINT_DEBUG("GetLobbyMemberByIndex %llu %i\n", steamIDLobby.ConvertToUint64(), iMember);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     CSteamID id = k_steamIDNil;
     if (lobby && !lobby->deleted() && lobby->members().size() > iMember && iMember >= 0) id = (uint64)lobby->members(iMember).id();
@@ -783,7 +1171,7 @@ const char *GetLobbyData( CSteamID steamIDLobby, const char *pchKey )
 {
     PRINT_DEBUG("GetLobbyData %llu %s\n", steamIDLobby.ConvertToUint64(), pchKey);
     if (!pchKey) return "";
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     const char *ret = "";
     if (lobby) {
@@ -806,7 +1194,7 @@ bool SetLobbyData( CSteamID steamIDLobby, const char *pchKey, const char *pchVal
     if (!pchKey) return false;
     char empty_string[] = "";
     if (!pchValue) pchValue = empty_string;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->deleted()) {
@@ -836,7 +1224,7 @@ bool SetLobbyData( CSteamID steamIDLobby, const char *pchKey, const char *pchVal
 int GetLobbyDataCount( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("GetLobbyDataCount\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     int size = 0;
     if (lobby) size = lobby->values().size();
@@ -850,7 +1238,7 @@ int GetLobbyDataCount( CSteamID steamIDLobby )
 bool GetLobbyDataByIndex( CSteamID steamIDLobby, int iLobbyData, char *pchKey, int cchKeyBufferSize, char *pchValue, int cchValueBufferSize )
 {
     PRINT_DEBUG("GetLobbyDataByIndex\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     bool ret = false;
 
@@ -876,7 +1264,7 @@ bool GetLobbyDataByIndex( CSteamID steamIDLobby, int iLobbyData, char *pchKey, i
 bool DeleteLobbyData( CSteamID steamIDLobby, const char *pchKey )
 {
     PRINT_DEBUG("DeleteLobbyData\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->owner() != settings->get_local_steam_id().ConvertToUint64() || lobby->deleted()) {
         return false;
@@ -894,7 +1282,7 @@ const char *GetLobbyMemberData( CSteamID steamIDLobby, CSteamID steamIDUser, con
 {
     PRINT_DEBUG("GetLobbyMemberData %s %llu %llu\n", pchKey, steamIDLobby.ConvertToUint64(), steamIDUser.ConvertToUint64());
     if (!pchKey) return "";
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Lobby_Member *member = get_lobby_member(get_lobby(steamIDLobby), steamIDUser);
     const char *ret = "";
     if (member) {
@@ -925,7 +1313,7 @@ void SetLobbyMemberData( CSteamID steamIDLobby, const char *pchKey, const char *
     char empty_string[] = "";
     if (!pchValue) pchValue = empty_string;
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->deleted()) return;
 
@@ -971,7 +1359,7 @@ void SetLobbyMemberData( CSteamID steamIDLobby, const char *pchKey, const char *
 bool SendLobbyChatMsg( CSteamID steamIDLobby, const void *pvMsgBody, int cubMsgBody )
 {
     PRINT_DEBUG("SendLobbyChatMsg %i\n", cubMsgBody);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->deleted()) return false;
 
@@ -989,7 +1377,7 @@ bool SendLobbyChatMsg( CSteamID steamIDLobby, const void *pvMsgBody, int cubMsgB
 int GetLobbyChatEntry( CSteamID steamIDLobby, int iChatID, STEAM_OUT_STRUCT() CSteamID *pSteamIDUser, void *pvData, int cubData, EChatEntryType *peChatEntryType )
 {
     PRINT_DEBUG("GetLobbyChatEntry %llu %i %p %p %i %p\n", steamIDLobby.ConvertToUint64(), iChatID, pSteamIDUser, pvData, cubData, peChatEntryType);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (iChatID >= chat_entries.size() || iChatID < 0 || cubData < 0) return 0;
     if (chat_entries[iChatID].lobby_id != steamIDLobby) return 0;
     if (pSteamIDUser) *pSteamIDUser = chat_entries[iChatID].user_id;
@@ -1017,7 +1405,7 @@ int GetLobbyChatEntry( CSteamID steamIDLobby, int iChatID, STEAM_OUT_STRUCT() CS
 bool RequestLobbyData( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("RequestLobbyData\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Data_Requested requested;
     requested.lobby_id = steamIDLobby;
     requested.requested = std::chrono::high_resolution_clock::now();
@@ -1031,7 +1419,7 @@ bool RequestLobbyData( CSteamID steamIDLobby )
 void SetLobbyGameServer( CSteamID steamIDLobby, uint32 unGameServerIP, uint16 unGameServerPort, CSteamID steamIDGameServer )
 {
     PRINT_DEBUG("SetLobbyGameServer %llu %llu %hhu.%hhu.%hhu.%hhu:%hu\n", steamIDLobby.ConvertToUint64(), steamIDGameServer.ConvertToUint64(), ((unsigned char *)&unGameServerIP)[3], ((unsigned char *)&unGameServerIP)[2], ((unsigned char *)&unGameServerIP)[1], ((unsigned char *)&unGameServerIP)[0], unGameServerPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (lobby) {
         if (lobby->deleted()) return;
@@ -1052,7 +1440,7 @@ void SetLobbyGameServer( CSteamID steamIDLobby, uint32 unGameServerIP, uint16 un
 bool GetLobbyGameServer( CSteamID steamIDLobby, uint32 *punGameServerIP, uint16 *punGameServerPort, STEAM_OUT_STRUCT() CSteamID *psteamIDGameServer )
 {
     PRINT_DEBUG("GetLobbyGameServer\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby) {
         
@@ -1077,7 +1465,7 @@ bool GetLobbyGameServer( CSteamID steamIDLobby, uint32 *punGameServerIP, uint16
 bool SetLobbyMemberLimit( CSteamID steamIDLobby, int cMaxMembers )
 {
     PRINT_DEBUG("SetLobbyMemberLimit\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->owner() != settings->get_local_steam_id().ConvertToUint64() || lobby->deleted()) {
         
@@ -1094,7 +1482,7 @@ bool SetLobbyMemberLimit( CSteamID steamIDLobby, int cMaxMembers )
 int GetLobbyMemberLimit( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("GetLobbyMemberLimit\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     int limit = 0;
     if (lobby) limit = lobby->member_limit();
@@ -1113,7 +1501,7 @@ void SetLobbyVoiceEnabled( CSteamID steamIDLobby, bool bVoiceEnabled )
 bool SetLobbyType( CSteamID steamIDLobby, ELobbyType eLobbyType )
 {
     PRINT_DEBUG("SetLobbyType %i\n", eLobbyType);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->owner() != settings->get_local_steam_id().ConvertToUint64() || lobby->deleted()) {
         return false;
@@ -1137,7 +1525,7 @@ bool SetLobbyType( CSteamID steamIDLobby, ELobbyType eLobbyType )
 bool SetLobbyJoinable( CSteamID steamIDLobby, bool bLobbyJoinable )
 {
     PRINT_DEBUG("SetLobbyJoinable %u\n", bLobbyJoinable);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->owner() != settings->get_local_steam_id().ConvertToUint64() || lobby->deleted()) {
         return false;
@@ -1159,7 +1547,7 @@ bool SetLobbyJoinable( CSteamID steamIDLobby, bool bLobbyJoinable )
 CSteamID GetLobbyOwner( CSteamID steamIDLobby )
 {
     PRINT_DEBUG("GetLobbyOwner %llu\n", steamIDLobby.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->deleted()) return k_steamIDNil;
 
@@ -1191,7 +1579,7 @@ float GetLobbyDistance( CSteamID steamIDLobby )
 bool SetLobbyOwner( CSteamID steamIDLobby, CSteamID steamIDNewOwner )
 {
     PRINT_DEBUG("SetLobbyOwner\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Lobby *lobby = get_lobby(steamIDLobby);
     if (!lobby || lobby->owner() != settings->get_local_steam_id().ConvertToUint64() || lobby->deleted()) return false;
     Lobby_Member *member = get_lobby_member(lobby, steamIDNewOwner);
@@ -1231,82 +1619,15 @@ void RunCallbacks()
     RunBackground();
 
     if (searching) {
-        PRINT_DEBUG("Searching for lobbies %zu\n", lobbies.size());
-        for(auto & l: lobbies) {
-            bool use = l.joinable() && (l.type() == k_ELobbyTypePublic || l.type() == k_ELobbyTypeInvisible || l.type() == k_ELobbyTypeFriendsOnly) && !l.deleted();
-            PRINT_DEBUG("use lobby: %u, filters: %zu, joinable: %u, type: %u, deleted: %u\n", use, filter_values_copy.size(), l.joinable(), l.type(), l.deleted());
-            for (auto & f : filter_values_copy) {
-                PRINT_DEBUG("%s:%s/%i %u %i\n", f.key.c_str(), f.value_string.c_str(), f.value_int, f.is_int, f.eComparisonType);
-                auto value = caseinsensitive_find(l.values(), f.key);
-                if (value != l.values().end()) {
-                    //TODO: eComparisonType
-                    if (!f.is_int) {
-                        PRINT_DEBUG("Compare Values %s %s\n", value->second.c_str(), f.value_string.c_str());
-                        if (f.eComparisonType == k_ELobbyComparisonEqual) {
-                            if (value->second == f.value_string) {
-                                PRINT_DEBUG("Equal\n");
-                                //use = use;
-                            } else {
-                                PRINT_DEBUG("Not Equal\n");
-                                use = false;
-                            }
-                        }
-                    } else {
-                        try {
-                            PRINT_DEBUG("%s\n", value->second.c_str());
-                            int compare_to = 0;
-                            //TODO: check if this is how real steam behaves
-                            if (value->second.size()) {
-                                compare_to = std::stoll(value->second, 0, 0);
-                            }
-                            PRINT_DEBUG("Compare Values %i %i\n", compare_to, f.value_int);
-                            if (f.eComparisonType == k_ELobbyComparisonEqual) {
-                                if (compare_to == f.value_int) {
-                                    PRINT_DEBUG("Equal\n");
-                                    //use = use;
-                                } else {
-                                    PRINT_DEBUG("Not Equal\n");
-                                    use = false;
-                                }
-                            }
-                        } catch (...) {
-                            //Same case as if the key is not in the lobby?
-                            use = false;
-                        }
-                        //TODO: add more comparisons
-                    }
-                } else {
-                    PRINT_DEBUG("Compare Key not in lobby\n");
-                    if (f.eComparisonType == k_ELobbyComparisonEqual) {
-                        //If the key is not in the lobby do we take it into account?
-                        use = false;
-                    }
-                }
-            }
-
-            PRINT_DEBUG("Lobby %llu use %u\n", l.room_id(), use);
-            if (use) PUSH_BACK_IF_NOT_IN(filtered_lobbies, (uint64)l.room_id());
-            if (filtered_lobbies.size() >= filter_max_results_copy) {
-                searching = false;
-                LobbyMatchList_t data;
-                data.m_nLobbiesMatching = filtered_lobbies.size();
-                callback_results->addCallResult(search_call_api_id, data.k_iCallback, &data, sizeof(data));
-                callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
-                search_call_api_id = 0;
-            }
+        if (!lobby_search_checked) {
+            lobby_search_checked = true;
+            find_lobbies(false);
+        } else if (check_timedout(lobby_last_search, LOBBY_SEARCH_TIMEOUT)) {
+            PRINT_DEBUG("LOBBY_SEARCH_TIMEOUT\n");
+            find_lobbies(true);
         }
     }
 
-    if (searching && check_timedout(lobby_last_search, LOBBY_SEARCH_TIMEOUT)) {
-        PRINT_DEBUG("LOBBY_SEARCH_TIMEOUT %zu\n", filtered_lobbies.size());
-        LobbyMatchList_t data;
-        data.m_nLobbiesMatching = filtered_lobbies.size();
-        callback_results->addCallResult(search_call_api_id, data.k_iCallback, &data, sizeof(data));
-        callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
-        searching = false;
-        search_call_api_id = 0;
-    }
-
     auto g = std::begin(pending_joins);
     while (g != std::end(pending_joins)) {
         if (!g->message_sent) {
@@ -1376,90 +1697,122 @@ void RunCallbacks()
 
 
 
-void Callback(Common_Message *msg)
+//applies a full lobby received from its owner and sends the callbacks for what changed
+void update_lobby(Lobby *new_lobby)
 {
-    if (msg->has_lobby()) {
-        PRINT_DEBUG("GOT A LOBBY appid: %lu\n", msg->lobby().appid());
-        if (msg->lobby().owner() != settings->get_local_steam_id().ConvertToUint64() && msg->lobby().appid() == settings->get_local_game_id().AppID()) {
-            Lobby *lobby = get_lobby((uint64)msg->lobby().room_id());
-            if (!lobby) {
-                size_t old_size = lobbies.size();
-                lobbies.resize(old_size + 1);
-                lobbies[old_size].set_room_id(msg->lobby().room_id());
-                lobby = &(lobbies[old_size]);
-            }
+    Lobby *lobby = get_lobby((uint64)new_lobby->room_id());
+    if (!lobby) {
+        size_t old_size = lobbies.size();
+        lobbies.resize(old_size + 1);
+        lobbies[old_size].set_room_id(new_lobby->room_id());
+        lobby = &(lobbies[old_size]);
+    }
 
-            if (!lobby->deleted()) {
-                if (!protobuf_message_equal(*lobby, msg->lobby())) {
-                    bool we_are_in_lobby = !!get_lobby_member(lobby, settings->get_local_steam_id());
-                    if (we_are_in_lobby) trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
+    if (!lobby->deleted()) {
+        if (!protobuf_message_equal(*lobby, *new_lobby)) {
+            bool we_are_in_lobby = !!get_lobby_member(lobby, settings->get_local_steam_id());
+            if (we_are_in_lobby) trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
 
-                    for (auto & m : lobby->members()) {
-                        int count = 0;
-                        Lobby_Member *member = get_lobby_member(msg->mutable_lobby(), (uint64)m.id());
+            for (auto & m : lobby->members()) {
+                int count = 0;
+                Lobby_Member *member = get_lobby_member(new_lobby, (uint64)m.id());
 
-                        if (we_are_in_lobby) {
-                            if (!member) {
-                                trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), true, true, 0.2);
-                            } else if (!protobuf_message_equal(*member, m)) {
-                                trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
-                            }
-                        }
+                if (we_are_in_lobby) {
+                    if (!member) {
+                        trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), true, true, 0.2);
+                    } else if (!protobuf_message_equal(*member, m)) {
+                        trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
                     }
+                }
+            }
 
-                    bool joined = false;
-                    for (auto & m : msg->lobby().members()) {
-                        Lobby_Member *member = get_lobby_member(lobby, (uint64)m.id());
-                        if (!member) {
-                            if (m.id() == settings->get_local_steam_id().ConvertToUint64()) {
-                                CSteamID id((uint64)lobby->room_id());
-                                auto pd = pending_joins.begin();
-                                while (pd != pending_joins.end()) {
-                                    if (pd->lobby_id == id) {
-                                        bool success = true;
-                                        LobbyEnter_t data;
-                                        data.m_ulSteamIDLobby = lobby->room_id();
-                                        data.m_rgfChatPermissions = 0; //Unused - Always 0
-                                        data.m_bLocked = false;
-                                        data.m_EChatRoomEnterResponse = success ? k_EChatRoomEnterResponseSuccess : k_EChatRoomEnterResponseError;
-                                        callback_results->addCallResult(pd->api_id, data.k_iCallback, &data, sizeof(data));
-                                        callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
-                                        pd = pending_joins.erase(pd);
-                                        joined = true;
-                                    } else {
-                                        ++pd;
-                                    }
-                                }
-                                if (joined) {
-                                    on_self_enter_leave_lobby((uint64)lobby->room_id(), lobby->type(), false);
-                                    trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
-                                }
+            bool joined = false;
+            for (auto & m : new_lobby->members()) {
+                Lobby_Member *member = get_lobby_member(lobby, (uint64)m.id());
+                if (!member) {
+                    if (m.id() == settings->get_local_steam_id().ConvertToUint64()) {
+                        CSteamID id((uint64)lobby->room_id());
+                        auto pd = pending_joins.begin();
+                        while (pd != pending_joins.end()) {
+                            if (pd->lobby_id == id) {
+                                bool success = true;
+                                LobbyEnter_t data;
+                                data.m_ulSteamIDLobby = lobby->room_id();
+                                data.m_rgfChatPermissions = 0; //Unused - Always 0
+                                data.m_bLocked = false;
+                                data.m_EChatRoomEnterResponse = success ? k_EChatRoomEnterResponseSuccess : k_EChatRoomEnterResponseError;
+                                callback_results->addCallResult(pd->api_id, data.k_iCallback, &data, sizeof(data));
+                                callbacks->addCBResult(data.k_iCallback, &data, sizeof(data));
+                                pd = pending_joins.erase(pd);
+                                joined = true;
                             } else {
-                                if (we_are_in_lobby) trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
+                                ++pd;
                             }
                         }
+                        if (joined) {
+                            on_self_enter_leave_lobby((uint64)lobby->room_id(), lobby->type(), false);
+                            trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
+                        }
+                    } else {
+                        if (we_are_in_lobby) trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
                     }
+                }
+            }
 
-                    if (joined) {
-                        for (auto & m : msg->lobby().members()) {
-                            if (m.id() != settings->get_local_steam_id().ConvertToUint64()) {
-                                //TODO: is this good?
-                                //trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
-                                if (m.values().size()) {
-                                    //TODO: check if this is what steam does
-                                    //trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
-                                }
-                            }
+            if (joined) {
+                for (auto & m : new_lobby->members()) {
+                    if (m.id() != settings->get_local_steam_id().ConvertToUint64()) {
+                        //TODO: is this good?
+                        //trigger_lobby_member_join_leave((uint64)lobby->room_id(), (uint64)m.id(), false, true);
+                        if (m.values().size()) {
+                            //TODO: check if this is what steam does
+                            //trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)m.id(), true);
                         }
                     }
+                }
+            }
 
-                    if ((joined && msg->lobby().gameserver().num_update()) || (we_are_in_lobby && (lobby->gameserver().num_update() != msg->lobby().gameserver().num_update()))) {
-                        send_gameservercreated_cb(lobby->room_id(), msg->lobby().gameserver().id(), msg->lobby().gameserver().ip(), msg->lobby().gameserver().port());
-                        trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
-                    }
+            if ((joined && new_lobby->gameserver().num_update()) || (we_are_in_lobby && (lobby->gameserver().num_update() != new_lobby->gameserver().num_update()))) {
+                send_gameservercreated_cb(lobby->room_id(), new_lobby->gameserver().id(), new_lobby->gameserver().ip(), new_lobby->gameserver().port());
+                trigger_lobby_dataupdate((uint64)lobby->room_id(), (uint64)lobby->room_id(), true);
+            }
+
+            *lobby = *new_lobby;
+        }
+    }
+}
 
-                    *lobby = msg->lobby();
+void Callback(Common_Message *msg)
+{
+    if (msg->has_lobby()) {
+        PRINT_DEBUG("GOT A LOBBY appid: %lu\n", msg->lobby().appid());
+        if (msg->lobby().owner() != settings->get_local_steam_id().ConvertToUint64() && msg->lobby().appid() == settings->get_local_game_id().AppID()) {
+            lobby_snapshot_requests.erase(msg->lobby().room_id());
+            update_lobby(msg->mutable_lobby());
+        }
+    }
+
+    if (msg->has_lobby_delta()) {
+        const Lobby_Delta &delta = msg->lobby_delta();
+        PRINT_DEBUG("GOT A LOBBY DELTA %llu revision %llu -> %llu\n", delta.room_id(), delta.base_revision(), delta.revision());
+        if (delta.header().owner() != settings->get_local_steam_id().ConvertToUint64() && delta.header().appid() == settings->get_local_game_id().AppID()) {
+            Lobby *lobby = get_lobby((uint64)delta.room_id());
+            if (!lobby || lobby->revision() != delta.base_revision()) {
+                //missed some changes or never got the lobby, ask the owner for all of it
+                request_lobby_snapshot(delta.room_id(), delta.header().owner());
+            } else if (delta.revision() != delta.base_revision()) {
+                Lobby new_lobby(*lobby);
+                if (apply_lobby_delta(&new_lobby, delta) && lobby_hash(new_lobby) == delta.hash()) {
+                    update_lobby(&new_lobby);
+                } else {
+                    //our copy was changed locally (leave, disconnect, owner change) in a way the owner didn't
+                    PRINT_DEBUG("lobby delta doesn't match %llu\n", delta.room_id());
+                    request_lobby_snapshot(delta.room_id(), delta.header().owner());
                 }
+            } else if (lobby_hash(*lobby) != delta.hash()) {
+                //heartbeat, the owner didn't change anything but our copy is different
+                PRINT_DEBUG("lobby heartbeat doesn't match %llu\n", delta.room_id());
+                request_lobby_snapshot(delta.room_id(), delta.header().owner());
             }
         }
     }
@@ -1471,6 +1824,11 @@ void Callback(Common_Message *msg)
         if (lobby && !lobby->deleted()) {
             bool we_are_in_lobby = !!get_lobby_member(lobby, settings->get_local_steam_id());
             if (lobby->owner() == settings->get_local_steam_id().ConvertToUint64()) {
+                if (msg->lobby_messages().type() == Lobby_Messages::REQUEST_LOBBY) {
+                    PRINT_DEBUG("LOBBY MESSAGE: REQUEST_LOBBY\n");
+                    send_lobby_snapshot(lobby, msg->source_id());
+                }
+
                 if (msg->lobby_messages().type() == Lobby_Messages::JOIN) {
                     PRINT_DEBUG("LOBBY MESSAGE: JOIN\n");
                     if (enter_lobby(lobby, (uint64)msg->source_id())) {
@@ -35,6 +35,200 @@ Steam_Matchmaking_Servers::Steam_Matchmaking_Servers(class Settings *settings, c
 
 static int server_list_request;
 
+static std::vector<std::string> split_filter_list(const std::string &list)
+{
+    std::vector<std::string> values;
+    std::stringstream ss(list);
+    std::string value;
+    while (std::getline(ss, value, ',')) {
+        if (!value.empty()) values.push_back(value);
+    }
+
+    return values;
+}
+
+static bool parse_filter_address(const std::string &address, uint32 *ip, uint16 *port)
+{
+    unsigned int a, b, c, d, p = 0;
+    int count = sscanf(address.c_str(), "%u.%u.%u.%u:%u", &a, &b, &c, &d, &p);
+    if (count < 4 || a > 255 || b > 255 || c > 255 || d > 255 || p > 0xFFFF) return false;
+    *ip = (a << 24) | (b << 16) | (c << 8) | d;
+    *port = p;
+    return true;
+}
+
+static std::vector<struct Steam_Matchmaking_Server_Filter> compile_server_filters(MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters)
+{
+    static const std::map<std::string, Steam_Matchmaking_Server_Filter::Types> filter_types = {
+        {"and", Steam_Matchmaking_Server_Filter::AND},
+        {"or", Steam_Matchmaking_Server_Filter::OR},
+        {"nand", Steam_Matchmaking_Server_Filter::NAND},
+        {"nor", Steam_Matchmaking_Server_Filter::NOR},
+        {"map", Steam_Matchmaking_Server_Filter::MAP},
+        {"gamedataand", Steam_Matchmaking_Server_Filter::GAMEDATA_AND},
+        {"gamedataor", Steam_Matchmaking_Server_Filter::GAMEDATA_OR},
+        {"gamedatanor", Steam_Matchmaking_Server_Filter::GAMEDATA_NOR},
+        {"gametagsand", Steam_Matchmaking_Server_Filter::GAMETAGS_AND},
+        {"gametagsnor", Steam_Matchmaking_Server_Filter::GAMETAGS_NOR},
+        {"addr", Steam_Matchmaking_Server_Filter::ADDR},
+        {"gameaddr", Steam_Matchmaking_Server_Filter::GAMEADDR},
+        {"dedicated", Steam_Matchmaking_Server_Filter::DEDICATED},
+        {"secure", Steam_Matchmaking_Server_Filter::SECURE},
+        {"notfull", Steam_Matchmaking_Server_Filter::NOT_FULL},
+        {"hasplayers", Steam_Matchmaking_Server_Filter::HAS_PLAYERS},
+        {"noplayers", Steam_Matchmaking_Server_Filter::NO_PLAYERS},
+        {"linux", Steam_Matchmaking_Server_Filter::LINUX},
+    };
+
+    std::vector<struct Steam_Matchmaking_Server_Filter> filters;
+    //the filters are one contiguous array, *ppchFilters points to its first element
+    if (!ppchFilters || !*ppchFilters) return filters;
+
+    for (uint32 i = 0; i < nFilters; ++i) {
+        std::string key((*ppchFilters)[i].m_szKey);
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        struct Steam_Matchmaking_Server_Filter filter = {};
+        auto type = filter_types.find(key);
+        filter.type = type == filter_types.end() ? Steam_Matchmaking_Server_Filter::UNKNOWN : type->second;
+        filter.value = (*ppchFilters)[i].m_szValue;
+        PRINT_DEBUG("server list filter %s %s\n", key.c_str(), filter.value.c_str());
+
+        switch (filter.type) {
+            case Steam_Matchmaking_Server_Filter::AND:
+            case Steam_Matchmaking_Server_Filter::OR:
+            case Steam_Matchmaking_Server_Filter::NAND:
+            case Steam_Matchmaking_Server_Filter::NOR:
+                filter.size = strtoul(filter.value.c_str(), NULL, 10);
+                break;
+
+            case Steam_Matchmaking_Server_Filter::GAMEDATA_AND:
+            case Steam_Matchmaking_Server_Filter::GAMEDATA_OR:
+            case Steam_Matchmaking_Server_Filter::GAMEDATA_NOR:
+            case Steam_Matchmaking_Server_Filter::GAMETAGS_AND:
+            case Steam_Matchmaking_Server_Filter::GAMETAGS_NOR:
+                filter.values = split_filter_list(filter.value);
+                break;
+
+            case Steam_Matchmaking_Server_Filter::ADDR:
+            case Steam_Matchmaking_Server_Filter::GAMEADDR:
+                //an address that can't be parsed matches nothing
+                if (!parse_filter_address(filter.value, &filter.ip, &filter.port)) filter.type = Steam_Matchmaking_Server_Filter::NAND;
+                break;
+
+            default:
+                break;
+        }
+
+        filters.push_back(filter);
+    }
+
+    return filters;
+}
+
+static bool contains_all(const std::set<std::string> &set, const std::vector<std::string> &values)
+{
+    for (auto &v : values) {
+        if (!set.count(v)) return false;
+    }
+
+    return true;
+}
+
+static bool contains_any(const std::set<std::string> &set, const std::vector<std::string> &values)
+{
+    for (auto &v : values) {
+        if (set.count(v)) return true;
+    }
+
+    return false;
+}
+
+//evaluates the filter at index and the ones it applies to, index is moved past them
+static bool server_filter_matches(const std::vector<struct Steam_Matchmaking_Server_Filter> &filters, size_t &index, const struct Steam_Matchmaking_Servers_Gameserver &gs)
+{
+    const struct Steam_Matchmaking_Server_Filter &f = filters[index];
+    const Gameserver *g = gs.server.get();
+    ++index;
+
+    switch (f.type) {
+        case Steam_Matchmaking_Server_Filter::AND:
+        case Steam_Matchmaking_Server_Filter::OR:
+        case Steam_Matchmaking_Server_Filter::NAND:
+        case Steam_Matchmaking_Server_Filter::NOR: {
+            bool is_and = f.type == Steam_Matchmaking_Server_Filter::AND || f.type == Steam_Matchmaking_Server_Filter::NAND;
+            bool result = is_and;
+            size_t end = std::min(index + f.size, filters.size());
+            while (index < end) {
+                //no short circuit, the operands still have to be skipped
+                bool operand = server_filter_matches(filters, index, gs);
+                if (is_and) result = result && operand;
+                else result = result || operand;
+            }
+
+            index = std::max(index, end);
+            if (f.type == Steam_Matchmaking_Server_Filter::NAND || f.type == Steam_Matchmaking_Server_Filter::NOR) return !result;
+            return result;
+        }
+
+        case Steam_Matchmaking_Server_Filter::MAP:
+            return g->map_name().size() == f.value.size() && std::equal(f.value.begin(), f.value.end(), g->map_name().begin(), [](char a, char b) { return tolower(a) == tolower(b); });
+
+        case Steam_Matchmaking_Server_Filter::GAMEDATA_AND:
+            return contains_all(gs.gamedata, f.values);
+        case Steam_Matchmaking_Server_Filter::GAMEDATA_OR:
+            return contains_any(gs.gamedata, f.values);
+        case Steam_Matchmaking_Server_Filter::GAMEDATA_NOR:
+            return !contains_any(gs.gamedata, f.values);
+        case Steam_Matchmaking_Server_Filter::GAMETAGS_AND:
+            return contains_all(gs.tags, f.values);
+        case Steam_Matchmaking_Server_Filter::GAMETAGS_NOR:
+            return !contains_any(gs.tags, f.values);
+
+        case Steam_Matchmaking_Server_Filter::ADDR: {
+            uint16 query_port = g->query_port() == 0xFFFF ? g->port() : g->query_port();
+            return g->ip() == f.ip && (!f.port || f.port == query_port);
+        }
+
+        case Steam_Matchmaking_Server_Filter::GAMEADDR:
+            return g->ip() == f.ip && (!f.port || f.port == g->port());
+
+        case Steam_Matchmaking_Server_Filter::DEDICATED:
+            return g->dedicated_server();
+        case Steam_Matchmaking_Server_Filter::SECURE:
+            return g->secure();
+        case Steam_Matchmaking_Server_Filter::NOT_FULL:
+            return g->num_players() < g->max_player_count();
+        case Steam_Matchmaking_Server_Filter::HAS_PLAYERS:
+            return g->num_players() > 0;
+        case Steam_Matchmaking_Server_Filter::NO_PLAYERS:
+            return g->num_players() == 0;
+
+        case Steam_Matchmaking_Server_Filter::LINUX:
+        case Steam_Matchmaking_Server_Filter::UNKNOWN:
+        default:
+            //servers don't send their os, unknown filters don't filter anything
+            return true;
+    }
+}
+
+static bool server_matches(const struct Steam_Matchmaking_Request &r, const struct Steam_Matchmaking_Servers_Gameserver &gs)
+{
+    size_t index = 0;
+    while (index < r.filters.size()) {
+        if (!server_filter_matches(r.filters, index, gs)) return false;
+    }
+
+    return true;
+}
+
+struct Steam_Matchmaking_Request *Steam_Matchmaking_Servers::get_request(HServerListRequest hRequest)
+{
+    auto r = std::find_if(requests.begin(), requests.end(), [&hRequest](struct Steam_Matchmaking_Request const& item) { return item.id == hRequest; });
+    if (r == requests.end()) return NULL;
+    return &(*r);
+}
+
 // Request a new list of servers of a particular type.  These calls each correspond to one of the EMatchMakingType values.
 // Each call allocates a new asynchronous request object.
 // Request object must be released by calling ReleaseRequest( hServerListRequest )
@@ -42,20 +236,30 @@ HServerListRequest Steam_Matchmaking_Servers::RequestInternetServerList( AppId_t
 {
     PRINT_DEBUG("RequestInternetServerList\n");
     //TODO
-    return RequestLANServerList(iApp, pRequestServersResponse);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestLANServerList( AppId_t iApp, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG("RequestLANServerList %u\n", iApp);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    return RequestServerList(iApp, NULL, 0, pRequestServersResponse);
+}
+
+HServerListRequest Steam_Matchmaking_Servers::RequestServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse)
+{
+    PRINT_DEBUG("RequestServerList %u %u\n", iApp, nFilters);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Matchmaking_Request request;
     request.appid = iApp;
     request.callbacks = pRequestServersResponse;
     request.old_callbacks = NULL;
     request.cancelled = false;
     request.completed = false;
-    requests.push_back(request);
+    request.released = false;
+    request.listed = false;
+    request.created = std::chrono::high_resolution_clock::now();
+    request.filters = compile_server_filters(ppchFilters, nFilters);
+    requests.push_back(std::move(request));
     ++server_list_request;
     requests[requests.size() - 1].id = (void *)server_list_request;
     HServerListRequest id = requests[requests.size() - 1].id;
@@ -67,34 +271,34 @@ HServerListRequest Steam_Matchmaking_Servers::RequestFriendsServerList( AppId_t
 {
     PRINT_DEBUG("RequestFriendsServerList\n");
     //TODO
-    return RequestLANServerList(iApp, pRequestServersResponse);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestFavoritesServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG("RequestFavoritesServerList\n");
     //TODO
-    return RequestLANServerList(iApp, pRequestServersResponse);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestHistoryServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG("RequestHistoryServerList\n");
     //TODO
-    return RequestLANServerList(iApp, pRequestServersResponse);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse);
 }
 
 HServerListRequest Steam_Matchmaking_Servers::RequestSpectatorServerList( AppId_t iApp, STEAM_ARRAY_COUNT(nFilters) MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse )
 {
     PRINT_DEBUG("RequestSpectatorServerList\n");
     //TODO
-    return RequestLANServerList(iApp, pRequestServersResponse);
+    return RequestServerList(iApp, ppchFilters, nFilters, pRequestServersResponse);
 }
 
-void Steam_Matchmaking_Servers::RequestOldServerList(AppId_t iApp, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type)
+void Steam_Matchmaking_Servers::RequestOldServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type)
 {
     PRINT_DEBUG("RequestOldServerList %u\n", iApp);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto g = std::begin(requests);
     while (g != std::end(requests)) {
         if (g->id == ((void *)type)) {
@@ -110,7 +314,11 @@ void Steam_Matchmaking_Servers::RequestOldServerList(AppId_t iApp, ISteamMatchma
     request.old_callbacks = pRequestServersResponse;
     request.cancelled = false;
     request.completed = false;
-    requests.push_back(request);
+    request.released = false;
+    request.listed = false;
+    request.created = std::chrono::high_resolution_clock::now();
+    request.filters = compile_server_filters(ppchFilters, nFilters);
+    requests.push_back(std::move(request));
     requests[requests.size() - 1].id = (void *)type;
 }
 
@@ -118,42 +326,42 @@ void Steam_Matchmaking_Servers::RequestInternetServerList( AppId_t iApp, MatchMa
 {
     PRINT_DEBUG("%s old\n", __FUNCTION__);
     //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eInternetServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eInternetServer);
 }
 
 void Steam_Matchmaking_Servers::RequestLANServerList( AppId_t iApp, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("%s old\n", __FUNCTION__);
     //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eLANServer);
+    RequestOldServerList(iApp, NULL, 0, pRequestServersResponse, eLANServer);
 }
 
 void Steam_Matchmaking_Servers::RequestFriendsServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("%s old\n", __FUNCTION__);
     //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eFriendsServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eFriendsServer);
 }
 
 void Steam_Matchmaking_Servers::RequestFavoritesServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("%s old\n", __FUNCTION__);
     //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eFavoritesServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eFavoritesServer);
 }
 
 void Steam_Matchmaking_Servers::RequestHistoryServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("%s old\n", __FUNCTION__);
     //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eHistoryServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eHistoryServer);
 }
 
 void Steam_Matchmaking_Servers::RequestSpectatorServerList( AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse )
 {
     PRINT_DEBUG("%s old\n", __FUNCTION__);
     //TODO
-    RequestOldServerList(iApp, pRequestServersResponse, eSpectatorServer);
+    RequestOldServerList(iApp, ppchFilters, nFilters, pRequestServersResponse, eSpectatorServer);
 }
 
 
@@ -256,7 +464,8 @@ void Steam_Matchmaking_Servers::server_details(Gameserver *g, gameserveritem_t *
     }
 
     server->m_NetAdr.Init(g->ip(), query_port, g->port());
-    server->m_nPing = 10; //TODO
+    int ping = network->getPing((uint64)g->id());
+    server->m_nPing = ping < 0 ? 10 : ping;
     server->m_bHadSuccessfulResponse = true;
     server->m_bDoNotRefresh = false;
     strncpy(server->m_szGameDir, g->mod_dir().c_str(), k_cbMaxGameServerGameDir - 1);
@@ -289,30 +498,19 @@ void Steam_Matchmaking_Servers::server_details(Gameserver *g, gameserveritem_t *
 gameserveritem_t *Steam_Matchmaking_Servers::GetServerDetails( HServerListRequest hRequest, int iServer )
 {
     PRINT_DEBUG("GetServerDetails %p %i\n", hRequest, iServer);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-
-    std::vector <struct Steam_Matchmaking_Servers_Gameserver> gameservers_filtered;
-    auto g = std::begin(requests);
-    while (g != std::end(requests)) {
-        PRINT_DEBUG("equal? %p %p\n", hRequest, g->id);
-        if (g->id == hRequest) {
-            gameservers_filtered = g->gameservers_filtered;
-            PRINT_DEBUG("found %u\n", gameservers_filtered.size());
-            break;
-        }
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
-        ++g;
-    }
-
-    if (iServer >= gameservers_filtered.size() || iServer < 0) {
+    struct Steam_Matchmaking_Request *request = get_request(hRequest);
+    if (!request || iServer < 0 || (size_t)iServer >= request->gameservers_filtered.size()) {
         return NULL;
     }
 
-    Gameserver *gs = &gameservers_filtered[iServer].server;
-    gameserveritem_t *server = new gameserveritem_t(); //TODO: is the new here ok?
-    server_details(gs, server);
+    //the returned pointer stays valid as long as the request
+    struct Steam_Matchmaking_Servers_Result &result = request->gameservers_filtered[iServer];
+    if (!result.details) result.details.reset(new gameserveritem_t());
+    server_details(result.server.get(), result.details.get());
     PRINT_DEBUG("Returned server details\n");
-    return server;
+    return result.details.get();
 }
 
 
@@ -351,7 +549,9 @@ void Steam_Matchmaking_Servers::RefreshQuery( HServerListRequest hRequest )
 bool Steam_Matchmaking_Servers::IsRefreshing( HServerListRequest hRequest )
 {
     PRINT_DEBUG("IsRefreshing %p\n", hRequest);
-    return false;
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    struct Steam_Matchmaking_Request *request = get_request(hRequest);
+    return request && !request->cancelled && !request->completed;
 }
  
 
@@ -359,19 +559,10 @@ bool Steam_Matchmaking_Servers::IsRefreshing( HServerListRequest hRequest )
 int Steam_Matchmaking_Servers::GetServerCount( HServerListRequest hRequest )
 {
     PRINT_DEBUG("GetServerCount %p\n", hRequest);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    int size = 0;
-    auto g = std::begin(requests);
-    while (g != std::end(requests)) {
-        if (g->id == hRequest) {
-            size = g->gameservers_filtered.size();
-            break;
-        }
-
-        ++g;
-    }
-
-    return size;
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    struct Steam_Matchmaking_Request *request = get_request(hRequest);
+    if (!request) return 0;
+    return request->gameservers_filtered.size();
 }
 
 
@@ -398,7 +589,7 @@ static HServerQuery new_server_query()
 HServerQuery Steam_Matchmaking_Servers::PingServer( uint32 unIP, uint16 usPort, ISteamMatchmakingPingResponse *pRequestServersResponse )
 {
     PRINT_DEBUG("PingServer %hhu.%hhu.%hhu.%hhu:%hu\n", ((unsigned char *)&unIP)[3], ((unsigned char *)&unIP)[2], ((unsigned char *)&unIP)[1], ((unsigned char *)&unIP)[0], usPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Steam_Matchmaking_Servers_Direct_IP_Request r;
     r.id = new_server_query();
     r.ip = unIP;
@@ -413,7 +604,7 @@ HServerQuery Steam_Matchmaking_Servers::PingServer( uint32 unIP, uint16 usPort,
 HServerQuery Steam_Matchmaking_Servers::PlayerDetails( uint32 unIP, uint16 usPort, ISteamMatchmakingPlayersResponse *pRequestServersResponse )
 {
     PRINT_DEBUG("PlayerDetails %hhu.%hhu.%hhu.%hhu:%hu\n", ((unsigned char *)&unIP)[3], ((unsigned char *)&unIP)[2], ((unsigned char *)&unIP)[1], ((unsigned char *)&unIP)[0], usPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Steam_Matchmaking_Servers_Direct_IP_Request r;
     r.id = new_server_query();
     r.ip = unIP;
@@ -429,7 +620,7 @@ HServerQuery Steam_Matchmaking_Servers::PlayerDetails( uint32 unIP, uint16 usPor
 HServerQuery Steam_Matchmaking_Servers::ServerRules( uint32 unIP, uint16 usPort, ISteamMatchmakingRulesResponse *pRequestServersResponse )
 {
     PRINT_DEBUG("ServerRules %hhu.%hhu.%hhu.%hhu:%hu\n", ((unsigned char *)&unIP)[3], ((unsigned char *)&unIP)[2], ((unsigned char *)&unIP)[1], ((unsigned char *)&unIP)[0], usPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     Steam_Matchmaking_Servers_Direct_IP_Request r;
     r.id = new_server_query();
     r.ip = unIP;
@@ -447,12 +638,54 @@ HServerQuery Steam_Matchmaking_Servers::ServerRules( uint32 unIP, uint16 usPort,
 void Steam_Matchmaking_Servers::CancelServerQuery( HServerQuery hServerQuery )
 {
     PRINT_DEBUG("CancelServerQuery\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto r = std::find_if(direct_ip_requests.begin(), direct_ip_requests.end(), [&hServerQuery](Steam_Matchmaking_Servers_Direct_IP_Request const& item) { return item.id == hServerQuery; });
     if (direct_ip_requests.end() == r) return;
     direct_ip_requests.erase(r);
 }
 
+void Steam_Matchmaking_Servers::remove_gameserver(std::map<uint64, struct Steam_Matchmaking_Servers_Gameserver>::iterator g)
+{
+    auto appid = gameservers_by_appid.find(g->second.server->appid());
+    if (appid != gameservers_by_appid.end()) {
+        appid->second.erase(g->first);
+        if (appid->second.empty()) gameservers_by_appid.erase(appid);
+    }
+
+    gameservers.erase(g);
+}
+
+struct Server_List_Event {
+    HServerListRequest id;
+    int server;
+    bool complete;
+    EMatchMakingServerResponse response;
+};
+
+static void add_server_to_list(struct Steam_Matchmaking_Request &r, const struct Steam_Matchmaking_Servers_Gameserver &gs, std::vector<struct Server_List_Event> &events)
+{
+    uint64 id = gs.server->id();
+    auto listed = r.gameserver_ids.find(id);
+    if (listed != r.gameserver_ids.end()) {
+        //already in the list, just show the new details
+        r.gameservers_filtered[listed->second].server = gs.server;
+        return;
+    }
+
+    if (!server_matches(r, gs)) return;
+
+    PRINT_DEBUG("REQUESTS server found %llu\n", id);
+    struct Steam_Matchmaking_Servers_Result result;
+    result.server = gs.server;
+    r.gameserver_ids[id] = r.gameservers_filtered.size();
+    r.gameservers_filtered.push_back(std::move(result));
+
+    struct Server_List_Event event = {};
+    event.id = r.id;
+    event.server = r.gameservers_filtered.size() - 1;
+    events.push_back(event);
+}
+
 void Steam_Matchmaking_Servers::RunCallbacks()
 {
     PRINT_DEBUG("Steam_Matchmaking_Servers::RunCallbacks\n");
@@ -460,8 +693,8 @@ void Steam_Matchmaking_Servers::RunCallbacks()
     {
         auto g = std::begin(gameservers);
         while (g != std::end(gameservers)) {
-            if (check_timedout(g->last_recv, SERVER_TIMEOUT)) {
-                g = gameservers.erase(g);
+            if (check_timedout(g->second.last_recv, SERVER_TIMEOUT)) {
+                remove_gameserver(g++);
                 PRINT_DEBUG("SERVER TIMEOUT\n");
             } else {
                 ++g;
@@ -469,57 +702,58 @@ void Steam_Matchmaking_Servers::RunCallbacks()
         }
     }
 
-    PRINT_DEBUG("REQUESTS %zu gs: %zu\n", requests.size(), gameservers.size());
+    PRINT_DEBUG("REQUESTS %zu gs: %zu updated: %zu\n", requests.size(), gameservers.size(), updated_gameservers.size());
 
+    //only servers with the right appid are checked against the filters: everything that was known when the list
+    //was requested, then the servers that show up or change while it's still refreshing
+    std::vector<struct Server_List_Event> events;
     for (auto &r : requests) {
         if (r.cancelled || r.completed) continue;
 
-        r.gameservers_filtered.clear();
-        for (auto &g : gameservers) {
-            PRINT_DEBUG("game_server_check %u %u\n", g.server.appid(), r.appid);
-            if (g.server.appid() == r.appid) {
-                PRINT_DEBUG("REQUESTS server found\n");
-                r.gameservers_filtered.push_back(g);
+        if (!r.listed) {
+            r.listed = true;
+            auto ids = gameservers_by_appid.find(r.appid);
+            if (ids != gameservers_by_appid.end()) {
+                for (auto id : ids->second) {
+                    add_server_to_list(r, gameservers[id], events);
+                }
+            }
+        } else {
+            for (auto id : updated_gameservers) {
+                auto g = gameservers.find(id);
+                if (g != gameservers.end() && g->second.server->appid() == r.appid) {
+                    add_server_to_list(r, g->second, events);
+                }
             }
         }
-    }
 
-    std::vector <struct Steam_Matchmaking_Request> requests_temp(requests);
-    PRINT_DEBUG("REQUESTS_TEMP %zu\n", requests_temp.size());
-    for (auto &r : requests) {
-        r.completed = true;
+        if (check_timedout(r.created, SERVER_LIST_REFRESH_TIME)) {
+            r.completed = true;
+            struct Server_List_Event event = {};
+            event.id = r.id;
+            event.complete = true;
+            event.response = r.gameservers_filtered.size() ? eServerResponded : eNoServersListedOnMasterServer;
+            events.push_back(event);
+        }
     }
 
-    for (auto &r : requests_temp) {
-        if (r.cancelled || r.completed) continue;
-        int i = 0;
+    updated_gameservers.clear();
 
-        if (r.callbacks) {
-            for (auto &g : r.gameservers_filtered) {
-                PRINT_DEBUG("REQUESTS server responded cb %p\n", r.id);
-                r.callbacks->ServerResponded(r.id, i);
-                ++i;
-            }
+    //the game can make or release requests from these callbacks so nothing from requests is kept across them
+    for (auto &e : events) {
+        struct Steam_Matchmaking_Request *r = get_request(e.id);
+        if (!r || r->cancelled) continue;
 
-            if (i) {
-                r.callbacks->RefreshComplete(r.id, eServerResponded);
-            } else {
-                r.callbacks->RefreshComplete(r.id, eNoServersListedOnMasterServer);
-            }
-        }
-
-        if (r.old_callbacks) {
-            for (auto &g : r.gameservers_filtered) {
-                PRINT_DEBUG("old REQUESTS server responded cb %p\n", r.id);
-                r.old_callbacks->ServerResponded(i);
-                ++i;
-            }
-
-            if (i) {
-                r.old_callbacks->RefreshComplete(eServerResponded);
-            } else {
-                r.old_callbacks->RefreshComplete(eNoServersListedOnMasterServer);
-            }
+        ISteamMatchmakingServerListResponse *callbacks = r->callbacks;
+        ISteamMatchmakingServerListResponse001 *old_callbacks = r->old_callbacks;
+        if (e.complete) {
+            PRINT_DEBUG("REQUESTS refresh complete %p %u\n", e.id, e.response);
+            if (callbacks) callbacks->RefreshComplete(e.id, e.response);
+            if (old_callbacks) old_callbacks->RefreshComplete(e.response);
+        } else {
+            PRINT_DEBUG("REQUESTS server responded cb %p %i\n", e.id, e.server);
+            if (callbacks) callbacks->ServerResponded(e.id, e.server);
+            if (old_callbacks) old_callbacks->ServerResponded(e.server);
         }
     }
 
@@ -536,18 +770,19 @@ void Steam_Matchmaking_Servers::RunCallbacks()
 
     for (auto &r : direct_ip_requests_temp) {
         PRINT_DEBUG("dip request: %lu:%hu\n", r.ip, r.port);
-        for (auto &g : gameservers) {
-            PRINT_DEBUG("server: %lu:%hu\n", g.server.ip(), g.server.query_port());
-            uint16 query_port = g.server.query_port();
+        for (auto &gs : gameservers) {
+            Gameserver &g = *gs.second.server;
+            PRINT_DEBUG("server: %lu:%hu\n", g.ip(), g.query_port());
+            uint16 query_port = g.query_port();
             if (query_port == 0xFFFF) {
-                query_port = g.server.port();
+                query_port = g.port();
             }
 
-            if (query_port == r.port && g.server.ip() == r.ip) {
+            if (query_port == r.port && g.ip() == r.ip) {
                 if (r.rules_response) {
-                    int number_rules = g.server.values().size();
+                    int number_rules = g.values().size();
                     PRINT_DEBUG("rules: %lu\n", number_rules);
-                    auto rule = g.server.values().begin();
+                    auto rule = g.values().begin();
                     for (int i = 0; i < number_rules; ++i) {
                         PRINT_DEBUG("RULE %s %s\n", rule->first.c_str(), rule->second.c_str());
                         r.rules_response->RulesResponded(rule->first.c_str(), rule->second.c_str());
@@ -560,7 +795,7 @@ void Steam_Matchmaking_Servers::RunCallbacks()
 
                 if (r.ping_response) {
                     gameserveritem_t server;
-                    server_details(&(g.server), &server);
+                    server_details(&g, &server);
                     r.ping_response->ServerResponded(server);
                     r.ping_response = NULL;
                 }
@@ -579,31 +814,38 @@ void Steam_Matchmaking_Servers::Callback(Common_Message *msg)
 {
     if (msg->has_gameserver()) {
         PRINT_DEBUG("got SERVER %llu, offline:%u\n", msg->gameserver().id(), msg->gameserver().offline());
+        auto g = gameservers.find(msg->gameserver().id());
         if (msg->gameserver().offline()) {
-            for (auto &g : gameservers) {
-                if (g.server.id() == msg->gameserver().id()) {
-                    g.last_recv = std::chrono::high_resolution_clock::time_point();
-                }
+            if (g != gameservers.end()) {
+                g->second.last_recv = std::chrono::high_resolution_clock::time_point();
             }
         } else {
-            bool already = false;
-            for (auto &g : gameservers) {
-                if (g.server.id() == msg->gameserver().id()) {
-                    g.last_recv = std::chrono::high_resolution_clock::now();
-                    g.server = msg->gameserver();
-                    g.server.set_ip(msg->source_ip());
-                    already = true;
-                }
-            }
+            std::shared_ptr<Gameserver> server = std::make_shared<Gameserver>(msg->gameserver());
+            server->set_ip(msg->source_ip());
 
-            if (!already) {
-                struct Steam_Matchmaking_Servers_Gameserver g;
-                g.last_recv = std::chrono::high_resolution_clock::now();
-                g.server = msg->gameserver();
-                g.server.set_ip(msg->source_ip());
-                gameservers.push_back(g);
+            if (g == gameservers.end()) {
+                g = gameservers.insert(std::make_pair((uint64)server->id(), Steam_Matchmaking_Servers_Gameserver())).first;
                 PRINT_DEBUG("SERVER ADDED\n");
+            } else if (protobuf_message_equal(*g->second.server, *server)) {
+                //servers send their info every few seconds even if nothing changed
+                g->second.last_recv = std::chrono::high_resolution_clock::now();
+                return;
+            } else if (g->second.server->appid() != server->appid()) {
+                auto appid = gameservers_by_appid.find(g->second.server->appid());
+                if (appid != gameservers_by_appid.end()) {
+                    appid->second.erase(g->first);
+                    if (appid->second.empty()) gameservers_by_appid.erase(appid);
+                }
             }
+
+            std::vector<std::string> tags = split_filter_list(server->tags());
+            std::vector<std::string> gamedata = split_filter_list(server->gamedata());
+            g->second.tags = std::set<std::string>(tags.begin(), tags.end());
+            g->second.gamedata = std::set<std::string>(gamedata.begin(), gamedata.end());
+            g->second.server = server;
+            g->second.last_recv = std::chrono::high_resolution_clock::now();
+            gameservers_by_appid[server->appid()].insert(g->first);
+            updated_gameservers.push_back(g->first);
         }
     }
 }
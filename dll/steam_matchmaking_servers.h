@@ -19,6 +19,7 @@
 
 #define SERVER_TIMEOUT 10.0
 #define DIRECT_IP_DELAY 0.05
+#define SERVER_LIST_REFRESH_TIME 1.0 //servers that show up this long after the list was requested are still added to it
 
 struct Steam_Matchmaking_Servers_Direct_IP_Request {
 	HServerQuery id;
@@ -32,17 +33,60 @@ struct Steam_Matchmaking_Servers_Direct_IP_Request {
 };
 
 struct Steam_Matchmaking_Servers_Gameserver {
-    Gameserver server;
+    //replaced, never modified, when the server sends an update so server lists can keep pointing to it
+    std::shared_ptr<Gameserver> server;
+    std::set<std::string> tags;
+    std::set<std::string> gamedata;
     std::chrono::high_resolution_clock::time_point last_recv;
 };
 
+struct Steam_Matchmaking_Server_Filter {
+    enum Types {
+        UNKNOWN,
+        AND,
+        OR,
+        NAND,
+        NOR,
+        MAP,
+        GAMEDATA_AND,
+        GAMEDATA_OR,
+        GAMEDATA_NOR,
+        GAMETAGS_AND,
+        GAMETAGS_NOR,
+        ADDR,
+        GAMEADDR,
+        DEDICATED,
+        SECURE,
+        NOT_FULL,
+        HAS_PLAYERS,
+        NO_PLAYERS,
+        LINUX,
+    } type;
+
+    std::string value;
+    std::vector<std::string> values;
+    //number of key/value pairs that follow a boolean operation
+    unsigned size;
+    uint32 ip;
+    uint16 port;
+};
+
+struct Steam_Matchmaking_Servers_Result {
+    std::shared_ptr<Gameserver> server;
+    std::unique_ptr<gameserveritem_t> details;
+};
+
 struct Steam_Matchmaking_Request {
     AppId_t appid;
     HServerListRequest id;
     ISteamMatchmakingServerListResponse *callbacks;
 	ISteamMatchmakingServerListResponse001 *old_callbacks;
     bool completed, cancelled, released;
-    std::vector <struct Steam_Matchmaking_Servers_Gameserver> gameservers_filtered;
+    bool listed;
+    std::chrono::high_resolution_clock::time_point created;
+    std::vector<struct Steam_Matchmaking_Server_Filter> filters;
+    std::vector<struct Steam_Matchmaking_Servers_Result> gameservers_filtered;
+    std::map<uint64, unsigned> gameserver_ids; //server id -> index in gameservers_filtered
 };
 
 class Steam_Matchmaking_Servers : public ISteamMatchmakingServers,
@@ -51,10 +95,16 @@ public ISteamMatchmakingServers001
     class Settings *settings;
     class Networking *network;
 
-    std::vector <struct Steam_Matchmaking_Servers_Gameserver> gameservers;
+    std::map<uint64, struct Steam_Matchmaking_Servers_Gameserver> gameservers;
+    std::unordered_map<AppId_t, std::set<uint64>> gameservers_by_appid;
+    //servers added or changed since the last RunCallbacks, checked against the server lists that are still refreshing
+    std::vector<uint64> updated_gameservers;
     std::vector <struct Steam_Matchmaking_Request> requests;
     std::vector <struct Steam_Matchmaking_Servers_Direct_IP_Request> direct_ip_requests;
-	void RequestOldServerList(AppId_t iApp, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type);
+	void RequestOldServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse001 *pRequestServersResponse, EMatchMakingType type);
+	HServerListRequest RequestServerList(AppId_t iApp, MatchMakingKeyValuePair_t **ppchFilters, uint32 nFilters, ISteamMatchmakingServerListResponse *pRequestServersResponse);
+	struct Steam_Matchmaking_Request *get_request(HServerListRequest hRequest);
+	void remove_gameserver(std::map<uint64, struct Steam_Matchmaking_Servers_Gameserver>::iterator g);
 public:
     Steam_Matchmaking_Servers(class Settings *settings, class Networking *network);
 	// Request a new list of servers of a particular type.  These calls each correspond to one of the EMatchMakingType values.
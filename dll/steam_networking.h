@@ -31,6 +31,13 @@ struct Steam_Networking_Connection {
     std::set<int> open_channels;
 };
 
+struct Steam_Networking_Packet {
+    CSteamID source;
+    int channel;
+    uint64 time_processed;
+    std::string data;
+};
+
 struct steam_listen_socket {
     SNetListenSocket_t id;
     int nVirtualP2PPort;
@@ -71,12 +78,16 @@ public ISteamNetworking
     class SteamCallBacks *callbacks;
     class RunEveryRunCB *run_every_runcb;
 
-    std::recursive_mutex messages_mutex;
-    std::list<Common_Message> messages;
-    std::list<Common_Message> unprocessed_messages;
+    Tracked_Mutex messages_mutex{"Steam_Networking messages", 1};
+    //packets from users we have a session with, per channel in the order they should be read
+    std::map<int, std::deque<struct Steam_Networking_Packet>> ready_packets;
+    //packets from users without a session, they become readable if the session gets accepted
+    std::map<CSteamID, std::deque<struct Steam_Networking_Packet>> orphaned_packets;
+    std::vector<struct Steam_Networking_Packet> unprocessed_packets;
 
-    std::recursive_mutex connections_edit_mutex;
-    std::vector<struct Steam_Networking_Connection> connections;
+    //lock messages_mutex before this one
+    Tracked_Mutex connections_edit_mutex{"Steam_Networking connections", 2};
+    std::unordered_map<uint64, struct Steam_Networking_Connection> connections;
 
     std::vector<struct steam_listen_socket> listen_sockets;
     std::vector<struct steam_connection_socket> connection_sockets;
@@ -86,63 +97,59 @@ public ISteamNetworking
 
 bool connection_exists(CSteamID id)
 {
-    std::lock_guard<std::recursive_mutex> lock(connections_edit_mutex);
-    return std::find_if(connections.begin(), connections.end(), [&id](struct Steam_Networking_Connection const& conn) { return conn.remote == id;}) != connections.end();
+    std::lock_guard<Tracked_Mutex> lock(connections_edit_mutex);
+    return connections.count(id.ConvertToUint64()) != 0;
 }
 
 struct Steam_Networking_Connection *get_or_create_connection(CSteamID id)
 {
-    std::lock_guard<std::recursive_mutex> lock(connections_edit_mutex);
-    auto conn = std::find_if(connections.begin(), connections.end(), [&id](struct Steam_Networking_Connection const& conn) { return conn.remote == id;});
-
-    if (connections.end() == conn) {
-        struct Steam_Networking_Connection connection;
-        connection.remote = id;
-        connections.push_back(connection);
-        return &(connections[connections.size() - 1]);
-    } else {
-        return &(*conn);
+    std::lock_guard<Tracked_Mutex> lock_messages(messages_mutex);
+    std::lock_guard<Tracked_Mutex> lock(connections_edit_mutex);
+    auto conn = connections.find(id.ConvertToUint64());
+    if (connections.end() != conn) {
+        return &(conn->second);
+    }
+
+    struct Steam_Networking_Connection &connection = connections[id.ConvertToUint64()];
+    connection.remote = id;
+
+    auto orphans = orphaned_packets.find(id);
+    if (orphans != orphaned_packets.end()) {
+        for (auto &packet : orphans->second) {
+            ready_packets[packet.channel].push_back(std::move(packet));
+        }
+
+        orphaned_packets.erase(orphans);
     }
+
+    return &connection;
 }
 
-void remove_connection(CSteamID id)
+void remove_packets_from(CSteamID id, bool unprocessed)
 {
-    {
-        std::lock_guard<std::recursive_mutex> lock(connections_edit_mutex);
-        auto conn = std::begin(connections);
-        while (conn != std::end(connections)) {
-            if (conn->remote == id) {
-
-                conn = connections.erase(conn);
-            } else {
-                ++conn;
-            }
-        }
+    std::lock_guard<Tracked_Mutex> lock(messages_mutex);
+    for (auto &channel : ready_packets) {
+        auto &queue = channel.second;
+        queue.erase(std::remove_if(queue.begin(), queue.end(), [&id](struct Steam_Networking_Packet const& packet) { return packet.source == id; }), queue.end());
     }
 
-    //pretty sure steam also clears the entire queue of messages for that connection
-    {
-        std::lock_guard<std::recursive_mutex> lock(messages_mutex);
-        auto msg = std::begin(messages);
-        while (msg != std::end(messages)) {
-            if (msg->source_id() == id.ConvertToUint64()) {
-                msg = messages.erase(msg);
-            } else {
-                ++msg;
-            }
-        }
+    orphaned_packets.erase(id);
+
+    if (unprocessed) {
+        unprocessed_packets.erase(std::remove_if(unprocessed_packets.begin(), unprocessed_packets.end(), [&id](struct Steam_Networking_Packet const& packet) { return packet.source == id; }), unprocessed_packets.end());
     }
+}
 
+void remove_connection(CSteamID id)
+{
+    std::lock_guard<Tracked_Mutex> lock(messages_mutex);
     {
-        auto msg = std::begin(unprocessed_messages);
-        while (msg != std::end(unprocessed_messages)) {
-            if (msg->source_id() == id.ConvertToUint64()) {
-                msg = unprocessed_messages.erase(msg);
-            } else {
-                ++msg;
-            }
-        }
+        std::lock_guard<Tracked_Mutex> lock(connections_edit_mutex);
+        connections.erase(id.ConvertToUint64());
     }
+
+    //pretty sure steam also clears the entire queue of messages for that connection
+    remove_packets_from(id, true);
 }
 
 SNetSocket_t create_connection_socket(CSteamID target, int nVirtualPort, uint32 nIP, uint16 nPort, SNetListenSocket_t id=0, enum steam_socket_connection_status status=SOCKET_CONNECTING, SNetSocket_t other_id=0)
@@ -246,7 +253,7 @@ Steam_Networking(class Settings *settings, class Networking *network, class Stea
 
     this->callbacks = callbacks;
 
-    PRINT_DEBUG("steam_networking_contructor %llu messages: %p\n", settings->get_local_steam_id().ConvertToUint64(), &messages);
+    PRINT_DEBUG("steam_networking_contructor %llu messages: %p\n", settings->get_local_steam_id().ConvertToUint64(), &ready_packets);
 }
 
 ~Steam_Networking()
@@ -271,7 +278,7 @@ Steam_Networking(class Settings *settings, class Networking *network, class Stea
 bool SendP2PPacket( CSteamID steamIDRemote, const void *pubData, uint32 cubData, EP2PSend eP2PSendType, int nChannel)
 {
     PRINT_DEBUG("Steam_Networking::SendP2PPacket len %u sendtype: %u channel: %u to: %llu\n", cubData, eP2PSendType, nChannel, steamIDRemote.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     bool reliable = false;
     if (eP2PSendType == k_EP2PSendReliable || eP2PSendType == k_EP2PSendReliableWithBuffering) reliable = true;
     Common_Message msg;
@@ -306,20 +313,18 @@ bool SendP2PPacket( CSteamID steamIDRemote, const void *pubData, uint32 cubData,
 bool IsP2PPacketAvailable( uint32 *pcubMsgSize, int nChannel)
 {
     PRINT_DEBUG("Steam_Networking::IsP2PPacketAvailable channel: %i\n", nChannel);
-    std::lock_guard<std::recursive_mutex> lock(messages_mutex);
+    std::lock_guard<Tracked_Mutex> lock(messages_mutex);
     //Not sure if this should be here because it slightly screws up games that don't like such low "pings"
     //Commenting it out for now because it looks like it causes a bug where 20xx gets stuck in an infinite receive packet loop
     //this->network->Run();
     //RunCallbacks();
 
-    PRINT_DEBUG("Messages %zu %p\n", messages.size(), &messages);
-    for (auto &msg : messages) {
-        if (connection_exists((uint64)msg.source_id()) && msg.mutable_network()->channel() == nChannel && msg.network().processed()) {
-            uint32 size = msg.mutable_network()->data().size();
-            if (pcubMsgSize) *pcubMsgSize = size;
-            PRINT_DEBUG("available with size: %lu\n", size);
-            return true;
-        }
+    auto queue = ready_packets.find(nChannel);
+    if (queue != ready_packets.end() && !queue->second.empty()) {
+        uint32 size = queue->second.front().data.size();
+        if (pcubMsgSize) *pcubMsgSize = size;
+        PRINT_DEBUG("available with size: %lu\n", size);
+        return true;
     }
 
     PRINT_DEBUG("Not available\n");
@@ -340,34 +345,29 @@ bool IsP2PPacketAvailable( uint32 *pcubMsgSize)
 bool ReadP2PPacket( void *pubDest, uint32 cubDest, uint32 *pcubMsgSize, CSteamID *psteamIDRemote, int nChannel)
 {
     PRINT_DEBUG("Steam_Networking::ReadP2PPacket %u %i\n", cubDest, nChannel);
-    std::lock_guard<std::recursive_mutex> lock(messages_mutex);
+    std::lock_guard<Tracked_Mutex> lock(messages_mutex);
     //Not sure if this should be here because it slightly screws up games that don't like such low "pings"
     //Commenting it out for now because it looks like it causes a bug where 20xx gets stuck in an infinite receive packet loop
     //this->network->Run();
     //RunCallbacks();
 
-    bool read = false;
-    PRINT_DEBUG("Number messages %zu\n", messages.size());
-    auto msg = std::begin(messages);
-    while (msg != std::end(messages)) {
-        if (connection_exists((uint64)msg->source_id()) && msg->network().channel() == nChannel && msg->network().processed()) {
-            uint32 msg_size = msg->network().data().size();
-            if (msg_size > cubDest) msg_size = cubDest;
-            if (pcubMsgSize) *pcubMsgSize = msg_size;
-            memcpy(pubDest, msg->network().data().data(), msg_size);
+    auto queue = ready_packets.find(nChannel);
+    if (queue != ready_packets.end() && !queue->second.empty()) {
+        struct Steam_Networking_Packet &packet = queue->second.front();
+        uint32 msg_size = packet.data.size();
+        if (msg_size > cubDest) msg_size = cubDest;
+        if (pcubMsgSize) *pcubMsgSize = msg_size;
+        memcpy(pubDest, packet.data.data(), msg_size);
 
 #ifndef EMU_RELEASE_BUILD
-            for (int i = 0; i < msg_size; ++i) {
-                PRINT_DEBUG("%02hhX", ((char*)pubDest)[i]);
-            }PRINT_DEBUG("\n");
+        for (int i = 0; i < msg_size; ++i) {
+            PRINT_DEBUG("%02hhX", ((char*)pubDest)[i]);
+        }PRINT_DEBUG("\n");
 #endif
-            *psteamIDRemote = CSteamID((uint64)msg->source_id());
-            PRINT_DEBUG("Steam_Networking::ReadP2PPacket len %u channel: %u from: %llu\n", msg_size, nChannel, msg->source_id());
-            msg = messages.erase(msg);
-            return true;
-        }
-
-        ++msg;
+        *psteamIDRemote = packet.source;
+        PRINT_DEBUG("Steam_Networking::ReadP2PPacket len %u channel: %u from: %llu\n", msg_size, nChannel, packet.source.ConvertToUint64());
+        queue->second.pop_front();
+        return true;
     }
 
     if (pcubMsgSize) *pcubMsgSize = 0;
@@ -390,7 +390,7 @@ bool ReadP2PPacket( void *pubDest, uint32 cubDest, uint32 *pcubMsgSize, CSteamID
 bool AcceptP2PSessionWithUser( CSteamID steamIDRemote )
 {
     PRINT_DEBUG("Steam_Networking::AcceptP2PSessionWithUser %llu\n", steamIDRemote.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Steam_Networking_Connection *conn = get_or_create_connection(steamIDRemote);
     if (conn) new_connection_times.erase(steamIDRemote);
     return !!conn;
@@ -402,7 +402,7 @@ bool AcceptP2PSessionWithUser( CSteamID steamIDRemote )
 bool CloseP2PSessionWithUser( CSteamID steamIDRemote )
 {
     PRINT_DEBUG("Steam_Networking::CloseP2PSessionWithUser %llu\n", steamIDRemote.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!connection_exists(steamIDRemote)) {
         
         return false;
@@ -420,7 +420,7 @@ bool CloseP2PSessionWithUser( CSteamID steamIDRemote )
 bool CloseP2PChannelWithUser( CSteamID steamIDRemote, int nChannel )
 {
     PRINT_DEBUG("Steam_Networking::CloseP2PChannelWithUser\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!connection_exists(steamIDRemote)) {
         return false;
     }
@@ -442,7 +442,7 @@ bool CloseP2PChannelWithUser( CSteamID steamIDRemote, int nChannel )
 bool GetP2PSessionState( CSteamID steamIDRemote, P2PSessionState_t *pConnectionState )
 {
     PRINT_DEBUG("Steam_Networking::GetP2PSessionState %llu\n", steamIDRemote.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!connection_exists(steamIDRemote) && (steamIDRemote != settings->get_local_steam_id())) {
         if (pConnectionState) {
             pConnectionState->m_bConnectionActive = false;
@@ -509,7 +509,7 @@ SNetListenSocket_t socket_number = 0;
 SNetListenSocket_t CreateListenSocket( int nVirtualP2PPort, uint32 nIP, uint16 nPort, bool bAllowUseOfPacketRelay )
 {
     PRINT_DEBUG("Steam_Networking::CreateListenSocket old %i %u %hu %u\n", nVirtualP2PPort, nIP, nPort, bAllowUseOfPacketRelay);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     for (auto & c : listen_sockets) {
         if (c.nVirtualP2PPort == nVirtualP2PPort || c.nPort == nPort)
             return 0;
@@ -547,7 +547,7 @@ SNetListenSocket_t CreateListenSocket( int nVirtualP2PPort, uint32 nIP, uint16 n
 SNetSocket_t CreateP2PConnectionSocket( CSteamID steamIDTarget, int nVirtualPort, int nTimeoutSec, bool bAllowUseOfPacketRelay )
 {
     PRINT_DEBUG("Steam_Networking::CreateP2PConnectionSocket %llu %i %i %u\n", steamIDTarget.ConvertToUint64(), nVirtualPort, nTimeoutSec, bAllowUseOfPacketRelay);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //TODO: nTimeoutSec
     return create_connection_socket(steamIDTarget, nVirtualPort, 0, 0);
 }
@@ -561,7 +561,7 @@ SNetSocket_t CreateP2PConnectionSocket( CSteamID steamIDTarget, int nVirtualPort
 SNetSocket_t CreateConnectionSocket( uint32 nIP, uint16 nPort, int nTimeoutSec )
 {
     PRINT_DEBUG("Steam_Networking::CreateConnectionSocket_old %u %hu %i\n", nIP, nPort, nTimeoutSec);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //TODO: nTimeoutSec
     return create_connection_socket((uint64)0, 0, nIP, nPort);
 }
@@ -579,7 +579,7 @@ SNetSocket_t CreateConnectionSocket( SteamIPAddress_t nIP, uint16 nPort, int nTi
 bool DestroySocket( SNetSocket_t hSocket, bool bNotifyRemoteEnd )
 {
     PRINT_DEBUG("Steam_Networking::DestroySocket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct steam_connection_socket *socket = get_connection_socket(hSocket);
     if (!socket || socket->status == SOCKET_KILLED) return false;
     socket->status = SOCKET_KILLED;
@@ -590,7 +590,7 @@ bool DestroySocket( SNetSocket_t hSocket, bool bNotifyRemoteEnd )
 bool DestroyListenSocket( SNetListenSocket_t hSocket, bool bNotifyRemoteEnd )
 {
     PRINT_DEBUG("Steam_Networking::DestroyListenSocket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto c = std::begin(listen_sockets);
     while (c != std::end(listen_sockets)) {
         if (c->id == hSocket) {
@@ -618,7 +618,7 @@ bool DestroyListenSocket( SNetListenSocket_t hSocket, bool bNotifyRemoteEnd )
 bool SendDataOnSocket( SNetSocket_t hSocket, void *pubData, uint32 cubData, bool bReliable )
 {
     PRINT_DEBUG("Steam_Networking::SendDataOnSocket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct steam_connection_socket *socket = get_connection_socket(hSocket);
     if (!socket || socket->status != SOCKET_CONNECTED) return false;
 
@@ -639,7 +639,7 @@ bool SendDataOnSocket( SNetSocket_t hSocket, void *pubData, uint32 cubData, bool
 bool IsDataAvailableOnSocket( SNetSocket_t hSocket, uint32 *pcubMsgSize )
 {
     PRINT_DEBUG("Steam_Networking::IsDataAvailableOnSocket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct steam_connection_socket *socket = get_connection_socket(hSocket);
     if (!socket) {
         if (pcubMsgSize) *pcubMsgSize = 0;
@@ -659,7 +659,7 @@ bool IsDataAvailableOnSocket( SNetSocket_t hSocket, uint32 *pcubMsgSize )
 bool RetrieveDataFromSocket( SNetSocket_t hSocket, void *pubDest, uint32 cubDest, uint32 *pcubMsgSize )
 {
     PRINT_DEBUG("Steam_Networking::RetrieveDataFromSocket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct steam_connection_socket *socket = get_connection_socket(hSocket);
     if (!socket || socket->data_packets.size() == 0) return false;
 
@@ -684,7 +684,7 @@ bool RetrieveDataFromSocket( SNetSocket_t hSocket, void *pubDest, uint32 cubDest
 bool IsDataAvailable( SNetListenSocket_t hListenSocket, uint32 *pcubMsgSize, SNetSocket_t *phSocket )
 {
     PRINT_DEBUG("Steam_Networking::IsDataAvailable\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!hListenSocket) return false;
 
     for (auto & socket : connection_sockets) {
@@ -708,7 +708,7 @@ bool IsDataAvailable( SNetListenSocket_t hListenSocket, uint32 *pcubMsgSize, SNe
 bool RetrieveData( SNetListenSocket_t hListenSocket, void *pubDest, uint32 cubDest, uint32 *pcubMsgSize, SNetSocket_t *phSocket )
 {
     PRINT_DEBUG("Steam_Networking::RetrieveData\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!hListenSocket) return false;
 
     for (auto & socket : connection_sockets) {
@@ -734,7 +734,7 @@ bool RetrieveData( SNetListenSocket_t hListenSocket, void *pubDest, uint32 cubDe
 bool GetSocketInfo( SNetSocket_t hSocket, CSteamID *pSteamIDRemote, int *peSocketStatus, uint32 *punIPRemote, uint16 *punPortRemote )
 {
     PRINT_DEBUG("Steam_Networking::GetSocketInfo_old\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct steam_connection_socket *socket = get_connection_socket(hSocket);
     if (!socket) return false;
     if (pSteamIDRemote) *pSteamIDRemote = socket->target;
@@ -780,7 +780,7 @@ bool GetSocketInfo( SNetSocket_t hSocket, CSteamID *pSteamIDRemote, int *peSocke
 bool GetListenSocketInfo( SNetListenSocket_t hListenSocket, uint32 *pnIP, uint16 *pnPort )
 {
     PRINT_DEBUG("Steam_Networking::GetListenSocketInfo_old\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto conn = std::find_if(listen_sockets.begin(), listen_sockets.end(), [&hListenSocket](struct steam_listen_socket const& conn) { return conn.id == hListenSocket;});
     if (conn == listen_sockets.end()) return false;
     if (pnIP) *pnIP = conn->nIP;
@@ -809,7 +809,7 @@ bool GetListenSocketInfo( SNetListenSocket_t hListenSocket, SteamIPAddress_t *pn
 ESNetSocketConnectionType GetSocketConnectionType( SNetSocket_t hSocket )
 {
     PRINT_DEBUG("Steam_Networking::GetSocketConnectionType\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct steam_connection_socket *socket = get_connection_socket(hSocket);
     if (!socket || socket->status != SOCKET_CONNECTED) return k_ESNetSocketConnectionTypeNotConnected;
     else return k_ESNetSocketConnectionTypeUDP;
@@ -828,44 +828,38 @@ void RunCallbacks()
     uint64 current_time = std::chrono::duration_cast<std::chrono::duration<uint64>>(std::chrono::system_clock::now().time_since_epoch()).count();
 
     {
-    std::lock_guard<std::recursive_mutex> lock(messages_mutex);
-
-    {
-        auto msg = std::begin(unprocessed_messages);
-        while (msg != std::end(unprocessed_messages)) {
-            CSteamID source_id((uint64)msg->source_id());
-            if (!connection_exists(source_id)) {
-                if (new_connection_times.find(source_id) == new_connection_times.end()) {
-                    new_connections_to_call_cb.push(source_id);
-                    new_connection_times[source_id] = std::chrono::high_resolution_clock::now();
-                }
-            } else {
-                struct Steam_Networking_Connection *conn = get_or_create_connection(source_id);
-                conn->open_channels.insert(msg->network().channel());
+    std::lock_guard<Tracked_Mutex> lock(messages_mutex);
+
+    for (auto &packet : unprocessed_packets) {
+        CSteamID source_id = packet.source;
+        packet.time_processed = current_time;
+        if (!connection_exists(source_id)) {
+            if (new_connection_times.find(source_id) == new_connection_times.end()) {
+                new_connections_to_call_cb.push(source_id);
+                new_connection_times[source_id] = std::chrono::high_resolution_clock::now();
             }
 
-            msg->mutable_network()->set_processed(true);
-            msg->mutable_network()->set_time_processed(current_time);
-            messages.push_back(*msg);
-            msg = unprocessed_messages.erase(msg);
+            orphaned_packets[source_id].push_back(std::move(packet));
+        } else {
+            struct Steam_Networking_Connection *conn = get_or_create_connection(source_id);
+            conn->open_channels.insert(packet.channel);
+            ready_packets[packet.channel].push_back(std::move(packet));
         }
     }
 
-    auto msg = std::begin(messages);
-    while (msg != std::end(messages)) {
-        bool deleted = false;
-        if (msg->network().processed()) {
-            if (!connection_exists((uint64)msg->source_id())) {
-                if (msg->network().time_processed() + ORPHANED_PACKET_TIMEOUT < current_time) {
-                    deleted = true;
-                }
-            }
+    unprocessed_packets.clear();
+
+    auto orphans = std::begin(orphaned_packets);
+    while (orphans != std::end(orphaned_packets)) {
+        auto &queue = orphans->second;
+        while (!queue.empty() && queue.front().time_processed + ORPHANED_PACKET_TIMEOUT < current_time) {
+            queue.pop_front();
         }
 
-        if (deleted) {
-            msg = messages.erase(msg);
+        if (queue.empty()) {
+            orphans = orphaned_packets.erase(orphans);
         } else {
-            ++msg;
+            ++orphans;
         }
     }
 
@@ -907,27 +901,25 @@ void Callback(Common_Message *msg)
 {
     if (msg->has_network()) {
 #ifndef EMU_RELEASE_BUILD
-        PRINT_DEBUG("Steam_Networking: got msg from: %llu to: %llu size %zu type %u | messages %p: %zu\n", msg->source_id(), msg->dest_id(), msg->network().data().size(), msg->network().type(), &messages, messages.size());
+        PRINT_DEBUG("Steam_Networking: got msg from: %llu to: %llu size %zu type %u | unprocessed: %zu\n", msg->source_id(), msg->dest_id(), msg->network().data().size(), msg->network().type(), unprocessed_packets.size());
         for (int i = 0; i < msg->network().data().size(); ++i) {
             PRINT_DEBUG("%02hhX", msg->network().data().data()[i]);
         }PRINT_DEBUG("\n");
 #endif
 
         if (msg->network().type() == Network_pb::DATA) {
-            unprocessed_messages.push_back(Common_Message(*msg));
+            std::lock_guard<Tracked_Mutex> lock(messages_mutex);
+            struct Steam_Networking_Packet packet;
+            packet.source = (uint64)msg->source_id();
+            packet.channel = msg->network().channel();
+            packet.time_processed = 0;
+            packet.data = msg->network().data();
+            unprocessed_packets.push_back(std::move(packet));
         }
 
         if (msg->network().type() == Network_pb::NEW_CONNECTION) {
-            std::lock_guard<std::recursive_mutex> lock(messages_mutex);
-            auto msg_temp = std::begin(messages);
-            while (msg_temp != std::end(messages)) {
-                //only delete processed to handle unreliable message arriving at the same time.
-                if (msg_temp->source_id() == msg->source_id() && msg_temp->network().processed()) {
-                    msg_temp = messages.erase(msg_temp);
-                } else {
-                    ++msg_temp;
-                }
-            }
+            //only delete processed to handle unreliable message arriving at the same time.
+            remove_packets_from((uint64)msg->source_id(), false);
         }
     }
 
@@ -170,7 +170,7 @@ std::map<CSteamID, Steam_Message_Connection>::iterator find_or_create_message_co
 EResult SendMessageToUser( const SteamNetworkingIdentity &identityRemote, const void *pubData, uint32 cubData, int nSendFlags, int nRemoteChannel )
 {
     PRINT_DEBUG("Steam_Networking_Messages::SendMessageToUser\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     const SteamNetworkingIPAddr *ip = identityRemote.GetIPAddr();
     bool reliable = false;
     if (nSendFlags & k_nSteamNetworkingSend_Reliable) {
@@ -211,18 +211,6 @@ EResult SendMessageToUser( const SteamNetworkingIdentity &identityRemote, const
     return k_EResultOK;
 }
 
-static void free_steam_message_data(SteamNetworkingMessage_t *pMsg)
-{
-    free(pMsg->m_pData);
-    pMsg->m_pData = NULL;
-}
-
-static void delete_steam_message(SteamNetworkingMessage_t *pMsg)
-{
-    if (pMsg->m_pfnFreeData) pMsg->m_pfnFreeData(pMsg);
-    delete pMsg;
-}
-
 /// Reads the next message that has been sent from another user via SendMessageToUser() on the given channel.
 /// Returns number of messages returned into your list.  (0 if no message are available on that channel.)
 ///
@@ -230,17 +218,15 @@ static void delete_steam_message(SteamNetworkingMessage_t *pMsg)
 int ReceiveMessagesOnChannel( int nLocalChannel, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
 {
     PRINT_DEBUG("Steam_Networking_Messages::ReceiveMessagesOnChannel\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     int message_counter = 0;
 
     for (auto & conn : connections) {
         auto chan = conn.second.data.find(nLocalChannel);
         if (chan != conn.second.data.end()) {
             while (!chan->second.empty() && message_counter < nMaxMessages) {
-                SteamNetworkingMessage_t *pMsg = new SteamNetworkingMessage_t(); //TODO size is wrong
                 unsigned long size = chan->second.front().size();
-                pMsg->m_pData = malloc(size);
-                pMsg->m_cbSize = size;
+                SteamNetworkingMessage_t *pMsg = allocate_steam_message(size);
                 memcpy(pMsg->m_pData, chan->second.front().data(), size);
                 pMsg->m_conn = conn.second.id;
                 pMsg->m_identityPeer = conn.second.remote_identity;
@@ -250,8 +236,6 @@ int ReceiveMessagesOnChannel( int nLocalChannel, SteamNetworkingMessage_t **ppOu
                 // pMsg->m_nMessageNumber = connect_socket->second.packet_receive_counter;
                 // ++connect_socket->second.packet_receive_counter;
 
-                pMsg->m_pfnFreeData = &free_steam_message_data;
-                pMsg->m_pfnRelease = &delete_steam_message;
                 pMsg->m_nChannel = nLocalChannel;
                 ppOutMessages[message_counter] = pMsg;
                 ++message_counter;
@@ -278,7 +262,7 @@ int ReceiveMessagesOnChannel( int nLocalChannel, SteamNetworkingMessage_t **ppOu
 bool AcceptSessionWithUser( const SteamNetworkingIdentity &identityRemote )
 {
     PRINT_DEBUG("Steam_Networking_Messages::AcceptSessionWithUser\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto conn = connections.find(identityRemote.GetSteamID());
     if (conn == connections.end()) {
         return false;
@@ -296,7 +280,7 @@ bool AcceptSessionWithUser( const SteamNetworkingIdentity &identityRemote )
 bool CloseSessionWithUser( const SteamNetworkingIdentity &identityRemote )
 {
     PRINT_DEBUG("Steam_Networking_Messages::CloseSessionWithUser\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto conn = connections.find(identityRemote.GetSteamID());
     if (conn == connections.end()) {
         return false;
@@ -322,7 +306,7 @@ bool CloseSessionWithUser( const SteamNetworkingIdentity &identityRemote )
 bool CloseChannelWithUser( const SteamNetworkingIdentity &identityRemote, int nLocalChannel )
 {
     PRINT_DEBUG("Steam_Networking_Messages::CloseChannelWithUser\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //TODO
     return false;
 }
@@ -339,7 +323,7 @@ bool CloseChannelWithUser( const SteamNetworkingIdentity &identityRemote, int nL
 ESteamNetworkingConnectionState GetSessionConnectionInfo( const SteamNetworkingIdentity &identityRemote, SteamNetConnectionInfo_t *pConnectionInfo, SteamNetConnectionRealTimeStatus_t *pQuickStatus )
 {
     PRINT_DEBUG("Steam_Networking_Messages::GetSessionConnectionInfo\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto conn = connections.find(identityRemote.GetSteamID());
     if (conn == connections.end()) {
         return k_ESteamNetworkingConnectionState_None;
@@ -362,7 +346,8 @@ ESteamNetworkingConnectionState GetSessionConnectionInfo( const SteamNetworkingI
     if (pQuickStatus) {
         memset(pQuickStatus, 0, sizeof(SteamNetConnectionRealTimeStatus_t));
         pQuickStatus->m_eState = state;
-        pQuickStatus->m_nPing = 10; //TODO: calculate real numbers?
+        int ping = network->getPing(conn->first);
+        pQuickStatus->m_nPing = ping < 0 ? 10 : ping;
         pQuickStatus->m_flConnectionQualityLocal = 1.0;
         pQuickStatus->m_flConnectionQualityRemote = 1.0;
         //TODO
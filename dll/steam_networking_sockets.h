@@ -35,13 +35,98 @@ enum connect_socket_status {
     CONNECT_SOCKET_TIMEDOUT
 };
 
-struct compare_snm_for_queue {
-    bool operator()(Networking_Sockets &left, Networking_Sockets &right) {
-        return left.message_number() > right.message_number();
+//max number of missing message numbers between received ones, there is no limit on in order messages
+#define CONNECT_SOCKET_MAX_REORDER_HOLES (1 << 16)
+
+enum connect_socket_push_result {
+    CONNECT_SOCKET_PUSH_ADDED,
+    CONNECT_SOCKET_PUSH_DUPLICATE,
+    CONNECT_SOCKET_PUSH_TOO_MANY_HOLES
+};
+
+//Messages received on a connection waiting to be read, indexed by message_number - base in a ring.
+//In order arrivals are a single append, late ones fill their hole and duplicates are dropped.
+//Missing numbers never hold back delivery: the slot at head is always filled when the ring isn't empty.
+struct Connect_Socket_Data {
+    struct Slot {
+        bool present = false;
+        std::string data;
+    };
+
+    std::vector<Slot> slots;
+    size_t head = 0;
+    size_t span = 0;
+    //slots in the span that are still waiting for their message
+    size_t holes = 0;
+    uint64 base = 0;
+
+    bool empty() const { return span == 0; }
+    size_t size() const { return span; }
+    uint64 front_number() const { return base; }
+    std::string &front() { return at(0).data; }
+
+    Slot &at(size_t offset) {
+        return slots[(head + offset) & (slots.size() - 1)];
+    }
+
+    void grow(size_t needed) {
+        size_t capacity = slots.empty() ? 16 : slots.size();
+        while (capacity < needed) capacity *= 2;
+        if (capacity == slots.size()) return;
+
+        std::vector<Slot> new_slots(capacity);
+        for (size_t i = 0; i < span; ++i) {
+            new_slots[i].present = at(i).present;
+            new_slots[i].data.swap(at(i).data);
+        }
+
+        slots.swap(new_slots);
+        head = 0;
+    }
+
+    //takes the payload out of data
+    enum connect_socket_push_result push(uint64 message_number, std::string *data) {
+        if (empty()) base = message_number;
+
+        if (message_number < base) {
+            size_t extra = base - message_number;
+            if (holes + extra - 1 > CONNECT_SOCKET_MAX_REORDER_HOLES) return CONNECT_SOCKET_PUSH_TOO_MANY_HOLES;
+            grow(span + extra);
+            head = (head - extra) & (slots.size() - 1);
+            span += extra;
+            holes += extra;
+            base = message_number;
+        } else if (message_number - base >= span) {
+            size_t extra = message_number - base - span + 1;
+            if (holes + extra - 1 > CONNECT_SOCKET_MAX_REORDER_HOLES) return CONNECT_SOCKET_PUSH_TOO_MANY_HOLES;
+            grow(span + extra);
+            span += extra;
+            holes += extra;
+        }
+
+        Slot &slot = at(message_number - base);
+        if (slot.present) return CONNECT_SOCKET_PUSH_DUPLICATE;
+        slot.present = true;
+        slot.data.swap(*data);
+        --holes;
+        return CONNECT_SOCKET_PUSH_ADDED;
+    }
+
+    void pop() {
+        do {
+            Slot &slot = at(0);
+            slot.present = false;
+            slot.data.clear();
+            head = (head + 1) & (slots.size() - 1);
+            ++base;
+            --span;
+            if (span && !at(0).present) --holes;
+        } while (span && !at(0).present);
     }
 };
 
 struct Connect_Socket {
+    HSteamNetConnection socket_id;
     int virtual_port;
     int real_port;
 
@@ -53,8 +138,12 @@ struct Connect_Socket {
     enum connect_socket_status status;
     int64 user_data;
 
-    std::priority_queue<Networking_Sockets, std::vector<Networking_Sockets>, compare_snm_for_queue> data;
+    Connect_Socket_Data data;
     HSteamNetPollGroup poll_group;
+    //links in the ready list of the poll group, only set while data is pending
+    struct Connect_Socket *ready_prev;
+    struct Connect_Socket *ready_next;
+    bool ready;
 
     unsigned long long packet_send_counter;
     CSteamID created_by;
@@ -63,10 +152,16 @@ struct Connect_Socket {
     unsigned connect_requests_sent;
 };
 
+struct Poll_Group {
+    //connections of the group that have pending messages, oldest first
+    struct Connect_Socket *ready_head = NULL;
+    struct Connect_Socket *ready_tail = NULL;
+};
+
 struct shared_between_client_server {
     std::vector<struct Listen_Socket> listen_sockets;
     std::map<HSteamNetConnection, struct Connect_Socket> connect_sockets;
-    std::map<HSteamNetPollGroup, std::list<HSteamNetConnection>> poll_groups;
+    std::map<HSteamNetPollGroup, struct Poll_Group> poll_groups;
     unsigned used;
 };
 
@@ -214,6 +309,31 @@ bool send_packet_new_connection(HSteamNetConnection m_hConn)
     return false;
 }
 
+void set_connection_ready(struct Connect_Socket &connect_socket, bool ready)
+{
+    if (connect_socket.ready == ready) return;
+    if (connect_socket.poll_group == k_HSteamNetPollGroup_Invalid) return;
+    auto group = s->poll_groups.find(connect_socket.poll_group);
+    if (group == s->poll_groups.end()) return;
+
+    Poll_Group &poll_group = group->second;
+    if (ready) {
+        connect_socket.ready_prev = poll_group.ready_tail;
+        connect_socket.ready_next = NULL;
+        if (poll_group.ready_tail) poll_group.ready_tail->ready_next = &connect_socket;
+        else poll_group.ready_head = &connect_socket;
+        poll_group.ready_tail = &connect_socket;
+    } else {
+        if (connect_socket.ready_prev) connect_socket.ready_prev->ready_next = connect_socket.ready_next;
+        else poll_group.ready_head = connect_socket.ready_next;
+        if (connect_socket.ready_next) connect_socket.ready_next->ready_prev = connect_socket.ready_prev;
+        else poll_group.ready_tail = connect_socket.ready_prev;
+        connect_socket.ready_prev = connect_socket.ready_next = NULL;
+    }
+
+    connect_socket.ready = ready;
+}
+
 HSteamNetConnection new_connect_socket(SteamNetworkingIdentity remote_identity, int virtual_port, int real_port, enum connect_socket_status status=CONNECT_SOCKET_CONNECTING, HSteamListenSocket listen_socket_id=k_HSteamListenSocket_Invalid, HSteamNetConnection remote_id=k_HSteamNetConnection_Invalid)
 {
     Connect_Socket socket = {};
@@ -232,6 +352,7 @@ HSteamNetConnection new_connect_socket(SteamNetworkingIdentity remote_identity,
 
     HSteamNetConnection socket_id = get_socket_id();
     if (socket_id == k_HSteamNetConnection_Invalid) ++socket_id;
+    socket.socket_id = socket_id;
 
     if (s->connect_sockets.insert(std::make_pair(socket_id, socket)).second == false) {
         return k_HSteamNetConnection_Invalid;
@@ -272,6 +393,20 @@ void set_steamnetconnectioninfo(std::map<HSteamNetConnection, Connect_Socket>::i
     //keep this in mind in future interface updates
 }
 
+void receive_data(std::map<HSteamNetConnection, Connect_Socket>::iterator connect_socket, Common_Message *msg)
+{
+    enum connect_socket_push_result result = connect_socket->second.data.push(msg->networking_sockets().message_number(), msg->mutable_networking_sockets()->mutable_data());
+    if (result == CONNECT_SOCKET_PUSH_ADDED) {
+        set_connection_ready(connect_socket->second, true);
+    } else if (result == CONNECT_SOCKET_PUSH_TOO_MANY_HOLES) {
+        //messages can't be dropped silently, fail the connection instead
+        PRINT_DEBUG("Steam_Networking_Sockets: too many missing messages on connection %u, closing\n", connect_socket->first);
+        enum connect_socket_status old_status = connect_socket->second.status;
+        connect_socket->second.status = CONNECT_SOCKET_TIMEDOUT;
+        launch_callback(connect_socket->first, old_status);
+    }
+}
+
 void launch_callback(HSteamNetConnection m_hConn, enum connect_socket_status old_status)
 {
     auto connect_socket = s->connect_sockets.find(m_hConn);
@@ -311,7 +446,7 @@ void launch_callback(HSteamNetConnection m_hConn, enum connect_socket_status old
 HSteamListenSocket CreateListenSocket( int nSteamConnectVirtualPort, uint32 nIP, uint16 nPort )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateListenSocket %i %u %u\n", nSteamConnectVirtualPort, nIP, nPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(nSteamConnectVirtualPort, nPort);
 }
 
@@ -332,21 +467,21 @@ HSteamListenSocket CreateListenSocket( int nSteamConnectVirtualPort, uint32 nIP,
 HSteamListenSocket CreateListenSocketIP( const SteamNetworkingIPAddr &localAddress )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateListenSocketIP old\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(SNS_DISABLED_PORT, localAddress.m_port);
 }
 
 HSteamListenSocket CreateListenSocketIP( const SteamNetworkingIPAddr *localAddress )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateListenSocketIP old1\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(SNS_DISABLED_PORT, localAddress->m_port);
 }
 
 HSteamListenSocket CreateListenSocketIP( const SteamNetworkingIPAddr &localAddress, int nOptions, const SteamNetworkingConfigValue_t *pOptions )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateListenSocketIP\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(SNS_DISABLED_PORT, localAddress.m_port);
 }
 
@@ -371,7 +506,7 @@ HSteamListenSocket CreateListenSocketIP( const SteamNetworkingIPAddr &localAddre
 HSteamNetConnection ConnectByIPAddress( const SteamNetworkingIPAddr &address )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::ConnectByIPAddress old\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     SteamNetworkingIdentity ip_id;
     ip_id.SetIPAddr(address);
     HSteamNetConnection socket = new_connect_socket(ip_id, SNS_DISABLED_PORT, address.m_port);
@@ -382,7 +517,7 @@ HSteamNetConnection ConnectByIPAddress( const SteamNetworkingIPAddr &address )
 HSteamNetConnection ConnectByIPAddress( const SteamNetworkingIPAddr *address )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::ConnectByIPAddress old1\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     SteamNetworkingIdentity ip_id;
     ip_id.SetIPAddr(*address);
     HSteamNetConnection socket = new_connect_socket(ip_id, SNS_DISABLED_PORT, address->m_port);
@@ -393,7 +528,7 @@ HSteamNetConnection ConnectByIPAddress( const SteamNetworkingIPAddr *address )
 HSteamNetConnection ConnectByIPAddress( const SteamNetworkingIPAddr &address, int nOptions, const SteamNetworkingConfigValue_t *pOptions )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::ConnectByIPAddress %X\n", address.GetIPv4());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     SteamNetworkingIdentity ip_id;
     ip_id.SetIPAddr(address);
     HSteamNetConnection socket = new_connect_socket(ip_id, SNS_DISABLED_PORT, address.m_port);
@@ -414,7 +549,7 @@ HSteamNetConnection ConnectByIPAddress( const SteamNetworkingIPAddr &address, in
 HSteamListenSocket CreateListenSocketP2P( int nVirtualPort )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateListenSocketP2P old %i\n", nVirtualPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT);
 }
 
@@ -422,7 +557,7 @@ HSteamListenSocket CreateListenSocketP2P( int nVirtualPort, int nOptions, const
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateListenSocketP2P %i\n", nVirtualPort);
     //TODO config options
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT);
 }
 
@@ -440,7 +575,7 @@ HSteamListenSocket CreateListenSocketP2P( int nVirtualPort, int nOptions, const
 HSteamNetConnection ConnectP2P( const SteamNetworkingIdentity &identityRemote, int nVirtualPort )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::ConnectP2P old %i\n", nVirtualPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     const SteamNetworkingIPAddr *ip = identityRemote.GetIPAddr();
 
@@ -531,7 +666,7 @@ HSteamNetConnection ConnectByIPv4Address( uint32 nIP, uint16 nPort )
 EResult AcceptConnection( HSteamNetConnection hConn )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::AcceptConnection %u\n", hConn);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto connect_socket = s->connect_sockets.find(hConn);
     if (connect_socket == s->connect_sockets.end()) return k_EResultInvalidParam;
@@ -568,7 +703,7 @@ EResult AcceptConnection( HSteamNetConnection hConn )
 bool CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDebug, bool bEnableLinger )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CloseConnection %u\n", hPeer);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto connect_socket = s->connect_sockets.find(hPeer);
     if (connect_socket == s->connect_sockets.end()) return false;
@@ -587,6 +722,7 @@ bool CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDeb
         network->sendTo(&msg, true);
     }
 
+    set_connection_ready(connect_socket->second, false);
     s->connect_sockets.erase(connect_socket);
     return true;
 }
@@ -612,7 +748,7 @@ bool CloseListenSocket( HSteamListenSocket hSocket, const char *pszNotifyRemoteR
 bool CloseListenSocket( HSteamListenSocket hSocket )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CloseListenSocket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto conn = std::find_if(s->listen_sockets.begin(), s->listen_sockets.end(), [&hSocket](struct Listen_Socket const& conn) { return conn.socket_id == hSocket;});
     if (conn == s->listen_sockets.end()) return false;
@@ -641,7 +777,7 @@ bool CloseListenSocket( HSteamListenSocket hSocket )
 bool SetConnectionUserData( HSteamNetConnection hPeer, int64 nUserData )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::SetConnectionUserData\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto connect_socket = s->connect_sockets.find(hPeer);
     if (connect_socket == s->connect_sockets.end()) return false;
     connect_socket->second.user_data = nUserData;
@@ -654,7 +790,7 @@ bool SetConnectionUserData( HSteamNetConnection hPeer, int64 nUserData )
 int64 GetConnectionUserData( HSteamNetConnection hPeer )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::GetConnectionUserData\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto connect_socket = s->connect_sockets.find(hPeer);
     if (connect_socket == s->connect_sockets.end()) return -1;
     return connect_socket->second.user_data;
@@ -746,7 +882,7 @@ EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, u
 EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::SendMessageToConnection %u, len %u, flags %i\n", hConn, cbData, nSendFlags);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto connect_socket = s->connect_sockets.find(hConn);
     if (connect_socket == s->connect_sockets.end()) return k_EResultInvalidParam;
@@ -830,7 +966,6 @@ void SendMessages( int nMessages, SteamNetworkingMessage_t *const *pMessages, in
             }
         }
 
-        pMessages[i]->m_pfnFreeData(pMessages[i]);
         pMessages[i]->Release();
     }
 }
@@ -848,41 +983,32 @@ EResult FlushMessagesOnConnection( HSteamNetConnection hConn )
     return k_EResultOK;
 }
 
-static void free_steam_message_data(SteamNetworkingMessage_t *pMsg)
+int get_steam_messages_connection(HSteamNetConnection hConn, struct Connect_Socket &connect_socket, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages)
 {
-    free(pMsg->m_pData);
-    pMsg->m_pData = NULL;
-}
-
-static void delete_steam_message(SteamNetworkingMessage_t *pMsg)
-{
-    if (pMsg->m_pfnFreeData) pMsg->m_pfnFreeData(pMsg);
-    delete pMsg;
-}
+    int messages = 0;
+    if (connect_socket.data.empty()) return messages;
+
+    SteamNetworkingMicroseconds time_received = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - created).count();
+    while (messages < nMaxMessages && !connect_socket.data.empty()) {
+        std::string &data = connect_socket.data.front();
+        unsigned long size = data.size();
+        SteamNetworkingMessage_t *pMsg = allocate_steam_message(size);
+        if (size) memcpy(pMsg->m_pData, data.data(), size);
+        pMsg->m_conn = hConn;
+        pMsg->m_identityPeer = connect_socket.remote_identity;
+        pMsg->m_nConnUserData = connect_socket.user_data;
+        pMsg->m_usecTimeReceived = time_received;
+        //TODO: check where messagenumber starts
+        pMsg->m_nMessageNumber = connect_socket.data.front_number();
+        pMsg->m_nChannel = 0;
+        connect_socket.data.pop();
+        PRINT_DEBUG("get_steam_messages_connection %u %lu, %llu\n", hConn, size, pMsg->m_nMessageNumber);
+        ppOutMessages[messages] = pMsg;
+        ++messages;
+    }
 
-SteamNetworkingMessage_t *get_steam_message_connection(HSteamNetConnection hConn)
-{
-    auto connect_socket = s->connect_sockets.find(hConn);
-    if (connect_socket == s->connect_sockets.end()) return NULL;
-    if (connect_socket->second.data.empty()) return NULL;
-    SteamNetworkingMessage_t *pMsg = new SteamNetworkingMessage_t();
-    unsigned long size = connect_socket->second.data.top().data().size();
-    pMsg->m_pData = malloc(size);
-    pMsg->m_cbSize = size;
-    memcpy(pMsg->m_pData, connect_socket->second.data.top().data().data(), size);
-    pMsg->m_conn = hConn;
-    pMsg->m_identityPeer = connect_socket->second.remote_identity;
-    pMsg->m_nConnUserData = connect_socket->second.user_data;
-    pMsg->m_usecTimeReceived = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - created).count();
-    //TODO: check where messagenumber starts
-    pMsg->m_nMessageNumber = connect_socket->second.data.top().message_number();
-
-    pMsg->m_pfnFreeData = &free_steam_message_data;
-    pMsg->m_pfnRelease = &delete_steam_message;
-    pMsg->m_nChannel = 0;
-    connect_socket->second.data.pop();
-    PRINT_DEBUG("get_steam_message_connection %u %u, %u\n", hConn, size, pMsg->m_nMessageNumber);
-    return pMsg;
+    if (connect_socket.data.empty()) set_connection_ready(connect_socket, false);
+    return messages;
 }
 
 /// Fetch the next available message(s) from the connection, if any.
@@ -905,13 +1031,11 @@ int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessa
     PRINT_DEBUG("Steam_Networking_Sockets::ReceiveMessagesOnConnection %u %i\n", hConn, nMaxMessages);
     if (!ppOutMessages || !nMaxMessages) return 0;
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    SteamNetworkingMessage_t *msg = NULL;
-    int messages = 0;
-    while (messages < nMaxMessages && (msg = get_steam_message_connection(hConn))) {
-        ppOutMessages[messages] = msg;
-        ++messages;
-    }
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    auto connect_socket = s->connect_sockets.find(hConn);
+    if (connect_socket == s->connect_sockets.end()) return -1;
+
+    int messages = get_steam_messages_connection(hConn, connect_socket->second, ppOutMessages, nMaxMessages);
 
     PRINT_DEBUG("messages %u\n", messages);
     return messages;
@@ -930,17 +1054,13 @@ int ReceiveMessagesOnListenSocket( HSteamListenSocket hSocket, SteamNetworkingMe
     PRINT_DEBUG("Steam_Networking_Sockets::ReceiveMessagesOnListenSocket %u %i\n", hSocket, nMaxMessages);
     if (!ppOutMessages || !nMaxMessages) return 0;
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    SteamNetworkingMessage_t *msg = NULL;
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     int messages = 0;
 
     auto socket_conn = std::begin(s->connect_sockets);
     while (socket_conn != std::end(s->connect_sockets) && messages < nMaxMessages) {
         if (socket_conn->second.listen_socket_id == hSocket) {
-            while (messages < nMaxMessages && (msg = get_steam_message_connection(socket_conn->first))) {
-                ppOutMessages[messages] = msg;
-                ++messages;
-            }
+            messages += get_steam_messages_connection(socket_conn->first, socket_conn->second, ppOutMessages + messages, nMaxMessages - messages);
         }
 
         ++socket_conn;
@@ -956,7 +1076,7 @@ bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pIn
     if (!pInfo)
         return false;
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto connect_socket = s->connect_sockets.find(hConn);
     if (connect_socket == s->connect_sockets.end()) return false;
 
@@ -985,13 +1105,14 @@ bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pIn
 EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes )
 {
     PRINT_DEBUG("%s %u %p %i %p\n", __FUNCTION__, hConn, pStatus, nLanes, pLanes);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto connect_socket = s->connect_sockets.find(hConn);
     if (connect_socket == s->connect_sockets.end()) return k_EResultNoConnection;
 
     if (pStatus) {
         pStatus->m_eState = convert_status(connect_socket->second.status);
-        pStatus->m_nPing = 10; //TODO: calculate real numbers?
+        int ping = network->getPing(connect_socket->second.remote_identity.GetSteamID());
+        pStatus->m_nPing = ping < 0 ? 10 : ping;
         pStatus->m_flConnectionQualityLocal = 1.0;
         pStatus->m_flConnectionQualityRemote = 1.0;
         //TODO: rest
@@ -1102,7 +1223,7 @@ bool GetListenSocketAddress( HSteamListenSocket hSocket, SteamNetworkingIPAddr *
 bool GetListenSocketInfo( HSteamListenSocket hSocket, uint32 *pnIP, uint16 *pnPort )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::GetListenSocketInfo\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct Listen_Socket *socket = get_connection_socket(hSocket);
     if (!socket) return false;
     if (pnIP) *pnIP = 0;//socket->ip;
@@ -1158,7 +1279,7 @@ bool CreateSocketPair( HSteamNetConnection *pOutConnection1, HSteamNetConnection
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateSocketPair %u %p %p\n", bUseNetworkLoopback, pIdentity1, pIdentity2);
     if (!pOutConnection1 || !pOutConnection1) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     SteamNetworkingIdentity remote_identity;
     remote_identity.SetSteamID(settings->get_local_steam_id());
@@ -1241,7 +1362,7 @@ bool CreateSocketPair( HSteamNetConnection *pOutConnection1, HSteamNetConnection
 EResult ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights )
 {
     PRINT_DEBUG("TODO: %s\n", __FUNCTION__);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto connect_socket = s->connect_sockets.find(hConn);
     if (connect_socket == s->connect_sockets.end()) return k_EResultNoConnection;
     //TODO
@@ -1310,12 +1431,12 @@ ESteamNetworkingAvailability GetAuthenticationStatus( SteamNetAuthenticationStat
 HSteamNetPollGroup CreatePollGroup()
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreatePollGroup\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     static HSteamNetPollGroup poll_group_counter;
     ++poll_group_counter;
 
     HSteamNetPollGroup poll_group_number = poll_group_counter;
-    s->poll_groups[poll_group_number] = std::list<HSteamNetConnection>();
+    s->poll_groups[poll_group_number] = Poll_Group();
     return poll_group_number;
 }
 
@@ -1327,16 +1448,17 @@ HSteamNetPollGroup CreatePollGroup()
 bool DestroyPollGroup( HSteamNetPollGroup hPollGroup )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::DestroyPollGroup\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto group = s->poll_groups.find(hPollGroup);
     if (group == s->poll_groups.end()) {
         return false;
     }
 
-    for (auto c : group->second) {
-        auto connect_socket = s->connect_sockets.find(c);
-        if (connect_socket != s->connect_sockets.end()) {
-            connect_socket->second.poll_group = k_HSteamNetPollGroup_Invalid;
+    for (auto & c : s->connect_sockets) {
+        if (c.second.poll_group == hPollGroup) {
+            c.second.poll_group = k_HSteamNetPollGroup_Invalid;
+            c.second.ready_prev = c.second.ready_next = NULL;
+            c.second.ready = false;
         }
     }
 
@@ -1361,7 +1483,7 @@ bool DestroyPollGroup( HSteamNetPollGroup hPollGroup )
 bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::SetConnectionPollGroup %u %u\n", hConn, hPollGroup);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto connect_socket = s->connect_sockets.find(hConn);
     if (connect_socket == s->connect_sockets.end()) {
         return false;
@@ -1372,20 +1494,9 @@ bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPoll
         return false;
     }
 
-    HSteamNetPollGroup old_poll_group = connect_socket->second.poll_group;
-    if (old_poll_group != k_HSteamNetPollGroup_Invalid) {
-        auto group = s->poll_groups.find(hPollGroup);
-        if (group != s->poll_groups.end()) {
-            group->second.remove(hConn);
-        }
-    }
-
+    set_connection_ready(connect_socket->second, false);
     connect_socket->second.poll_group = hPollGroup;
-    if (hPollGroup == k_HSteamNetPollGroup_Invalid) {
-        return true;
-    }
-
-    group->second.push_back(hConn);
+    set_connection_ready(connect_socket->second, !connect_socket->second.data.empty());
     return true;
 }
 
@@ -1407,20 +1518,20 @@ bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPoll
 int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::ReceiveMessagesOnPollGroup %u %i\n", hPollGroup, nMaxMessages);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto group = s->poll_groups.find(hPollGroup);
     if (group == s->poll_groups.end()) {
         return 0;
     }
 
-    SteamNetworkingMessage_t *msg = NULL;
     int messages = 0;
 
-    for (auto c : group->second) {
-        while (messages < nMaxMessages && (msg = get_steam_message_connection(c))) {
-            ppOutMessages[messages] = msg;
-            ++messages;
-        }
+    //only connections with pending messages are in the ready list, they unlink themselves once drained
+    Connect_Socket *connect_socket = group->second.ready_head;
+    while (connect_socket && messages < nMaxMessages) {
+        Connect_Socket *next = connect_socket->ready_next;
+        messages += get_steam_messages_connection(connect_socket->socket_id, *connect_socket, ppOutMessages + messages, nMaxMessages - messages);
+        connect_socket = next;
     }
 
     PRINT_DEBUG("Steam_Networking_Sockets::ReceiveMessagesOnPollGroup out %i\n", messages);
@@ -1590,7 +1701,7 @@ bool GetHostedDedicatedServerAddress001( SteamDatagramHostedAddress *pRouting )
 virtual EResult GetHostedDedicatedServerAddress( SteamDatagramHostedAddress *pRouting )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::GetHostedDedicatedServerAddress %p\n", pRouting);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     pRouting->SetDevAddress(network->getOwnIP(), 27054);
     return k_EResultOK;
 }
@@ -1603,7 +1714,7 @@ virtual EResult GetHostedDedicatedServerAddress( SteamDatagramHostedAddress *pRo
 HSteamListenSocket CreateHostedDedicatedServerListenSocket( int nVirtualPort )
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateHostedDedicatedServerListenSocket old %i\n", nVirtualPort);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT);
 }
 
@@ -1620,7 +1731,7 @@ HSteamListenSocket CreateHostedDedicatedServerListenSocket( int nVirtualPort, in
 {
     PRINT_DEBUG("Steam_Networking_Sockets::CreateHostedDedicatedServerListenSocket old %i\n", nVirtualPort);
     //TODO config options
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return new_listen_socket(nVirtualPort, SNS_DISABLED_PORT);
 }
 
@@ -2087,13 +2198,13 @@ void Callback(Common_Message *msg)
             if (connect_socket != s->connect_sockets.end()) {
                 if (connect_socket->second.remote_identity.GetSteamID64() == msg->source_id() && (connect_socket->second.status == CONNECT_SOCKET_CONNECTED)) {
                     PRINT_DEBUG("Steam_Networking_Sockets: got data len %u, num %u on connection %u\n", msg->networking_sockets().data().size(), msg->networking_sockets().message_number(), connect_socket->first);
-                    connect_socket->second.data.push(msg->networking_sockets());
+                    receive_data(connect_socket, msg);
                 }
             } else {
                 connect_socket = std::find_if(s->connect_sockets.begin(), s->connect_sockets.end(), [msg](const auto &in) {return in.second.remote_identity.GetSteamID64() == msg->source_id() && (in.second.status == CONNECT_SOCKET_NOT_ACCEPTED || in.second.status == CONNECT_SOCKET_CONNECTED) && in.second.remote_id == msg->networking_sockets().connection_id_from();});
                 if (connect_socket != s->connect_sockets.end()) {
                     PRINT_DEBUG("Steam_Networking_Sockets: got data len %u, num %u on not accepted connection %u\n", msg->networking_sockets().data().size(), msg->networking_sockets().message_number(), connect_socket->first);
-                    connect_socket->second.data.push(msg->networking_sockets());
+                    receive_data(connect_socket, msg);
                 }
             }
         } else if (msg->networking_sockets().type() == Networking_Sockets::CONNECTION_END) {
@@ -77,7 +77,7 @@ void SendP2PConnectionFailure( CSteamID steamIDRemote, uint32 unConnectionIDDest
 SteamAPICall_t GetCertAsync()
 {
     PRINT_DEBUG("Steam_Networking_Sockets_Serialized::GetCertAsync\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct SteamNetworkingSocketsCert_t data = {};
     data.m_eResult = k_EResultOK;
 
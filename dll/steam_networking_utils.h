@@ -68,18 +68,6 @@ Steam_Networking_Utils(class Settings *settings, class Networking *network, clas
     this->run_every_runcb->remove(&Steam_Networking_Utils::steam_run_every_runcb, this);
 }
 
-static void free_steam_message_data(SteamNetworkingMessage_t *pMsg)
-{
-    free(pMsg->m_pData);
-    pMsg->m_pData = NULL;
-}
-
-static void delete_steam_message(SteamNetworkingMessage_t *pMsg)
-{
-    if (pMsg->m_pfnFreeData) pMsg->m_pfnFreeData(pMsg);
-    delete pMsg;
-}
-
 /// Allocate and initialize a message object.  Usually the reason
 /// you call this is to pass it to ISteamNetworkingSockets::SendMessages.
 /// The returned object will have all of the relevant fields cleared to zero.
@@ -102,17 +90,7 @@ static void delete_steam_message(SteamNetworkingMessage_t *pMsg)
 SteamNetworkingMessage_t *AllocateMessage( int cbAllocateBuffer )
 {
     PRINT_DEBUG("Steam_Networking_Utils::AllocateMessage\n");
-    SteamNetworkingMessage_t *pMsg = new SteamNetworkingMessage_t();
-    pMsg->m_pfnFreeData = &free_steam_message_data;
-    pMsg->m_pfnRelease = &delete_steam_message;
-    if (cbAllocateBuffer < 0)
-        cbAllocateBuffer = 0;
-
-    if (cbAllocateBuffer)
-        pMsg->m_pData = malloc(cbAllocateBuffer);
-
-    pMsg->m_cbSize = cbAllocateBuffer;
-    return pMsg;
+    return allocate_steam_message(cbAllocateBuffer);
 }
 
 bool InitializeRelayAccess()
@@ -144,7 +122,7 @@ SteamRelayNetworkStatus_t get_network_status()
 ESteamNetworkingAvailability GetRelayNetworkStatus( SteamRelayNetworkStatus_t *pDetails )
 {
     PRINT_DEBUG("Steam_Networking_Utils::GetRelayNetworkStatus %p\n", pDetails);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     //TODO: check if this is how real steam returns it
     SteamRelayNetworkStatus_t data = {};
@@ -159,12 +137,38 @@ ESteamNetworkingAvailability GetRelayNetworkStatus( SteamRelayNetworkStatus_t *p
     return k_ESteamNetworkingAvailability_Current;
 }
 
+//there are no data centers, a ping location is the steam id of the user that made it
+//so that the ping to it can be estimated with the ping measured to that user
+static void set_ping_location(SteamNetworkPingLocation_t &location, CSteamID id)
+{
+    memset(&location, 0, sizeof(location));
+    location.m_data[2] = 123;
+    location.m_data[8] = 67;
+    uint64 steam_id = id.ConvertToUint64();
+    memcpy(location.m_data + 16, &steam_id, sizeof(steam_id));
+}
+
+static CSteamID get_ping_location(const SteamNetworkPingLocation_t &location)
+{
+    if (location.m_data[2] != 123 || location.m_data[8] != 67) return k_steamIDNil;
+    uint64 steam_id;
+    memcpy(&steam_id, location.m_data + 16, sizeof(steam_id));
+    return CSteamID(steam_id);
+}
+
+int estimate_ping(CSteamID id)
+{
+    if (id == settings->get_local_steam_id()) return 0;
+    int ping = -1;
+    if (id.IsValid()) ping = network->getPing(id);
+    return ping < 0 ? 10 : ping;
+}
+
 float GetLocalPingLocation( SteamNetworkPingLocation_t &result )
 {
     PRINT_DEBUG("Steam_Networking_Utils::GetLocalPingLocation\n");
     if (relay_initialized) {
-        result.m_data[2] = 123;
-        result.m_data[8] = 67;
+        set_ping_location(result, settings->get_local_steam_id());
         return 2.0;
     }
 
@@ -174,6 +178,11 @@ float GetLocalPingLocation( SteamNetworkPingLocation_t &result )
 int EstimatePingTimeBetweenTwoLocations( const SteamNetworkPingLocation_t &location1, const SteamNetworkPingLocation_t &location2 )
 {
     PRINT_DEBUG("Steam_Networking_Utils::EstimatePingTimeBetweenTwoLocations\n");
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    //we only know the pings from the local user
+    CSteamID id1 = get_ping_location(location1), id2 = get_ping_location(location2);
+    if (id1 == settings->get_local_steam_id()) return estimate_ping(id2);
+    if (id2 == settings->get_local_steam_id()) return estimate_ping(id1);
     //return k_nSteamNetworkingPing_Unknown;
     return 10;
 }
@@ -182,20 +191,26 @@ int EstimatePingTimeBetweenTwoLocations( const SteamNetworkPingLocation_t &locat
 int EstimatePingTimeFromLocalHost( const SteamNetworkPingLocation_t &remoteLocation )
 {
     PRINT_DEBUG("Steam_Networking_Utils::EstimatePingTimeFromLocalHost\n");
-    return 10;
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    return estimate_ping(get_ping_location(remoteLocation));
 }
 
 
 void ConvertPingLocationToString( const SteamNetworkPingLocation_t &location, char *pszBuf, int cchBufSize )
 {
     PRINT_DEBUG("Steam_Networking_Utils::ConvertPingLocationToString\n");
-    strncpy(pszBuf, "fra=10+2", cchBufSize);
+    if (!pszBuf || cchBufSize <= 0) return;
+    snprintf(pszBuf, cchBufSize, "fra=10+2,id=%llu", (unsigned long long)get_ping_location(location).ConvertToUint64());
 }
 
 
 bool ParsePingLocationString( const char *pszString, SteamNetworkPingLocation_t &result )
 {
     PRINT_DEBUG("Steam_Networking_Utils::ParsePingLocationString\n");
+    uint64 steam_id = 0;
+    const char *id = pszString ? strstr(pszString, "id=") : NULL;
+    if (id) steam_id = strtoull(id + 3, NULL, 10);
+    set_ping_location(result, CSteamID(steam_id));
     return true;
 }
 
@@ -88,7 +88,7 @@ bool	FileWrite( const char *pchFile, const void *pvData, int32 cubData )
         return false;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     int data_stored = local_storage->store_data(Local_Storage::remote_storage_folder, pchFile, (char* )pvData, cubData);
     PRINT_DEBUG("Steam_Remote_Storage::Stored %i, %u\n", data_stored, data_stored == cubData);
     return data_stored == cubData;
@@ -98,7 +98,7 @@ int32	FileRead( const char *pchFile, void *pvData, int32 cubDataToRead )
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileRead %s %i\n", pchFile, cubDataToRead);
     if (!pchFile || !pvData || !cubDataToRead) return 0;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     int read_data = local_storage->get_data(Local_Storage::remote_storage_folder, pchFile, (char* )pvData, cubDataToRead);
     if (read_data < 0) read_data = 0;
     PRINT_DEBUG("Read %i\n", read_data);
@@ -113,7 +113,7 @@ SteamAPICall_t FileWriteAsync( const char *pchFile, const void *pvData, uint32 c
         return k_uAPICallInvalid;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     bool success = local_storage->store_data(Local_Storage::remote_storage_folder, pchFile, (char* )pvData, cubData) == cubData;
     RemoteStorageFileWriteAsyncComplete_t data;
     data.m_eResult = success ? k_EResultOK : k_EResultFail;
@@ -127,7 +127,7 @@ SteamAPICall_t FileReadAsync( const char *pchFile, uint32 nOffset, uint32 cubToR
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileReadAsync\n");
     if (!pchFile) return k_uAPICallInvalid;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     unsigned int size = local_storage->file_size(Local_Storage::remote_storage_folder, pchFile);
 
@@ -155,7 +155,7 @@ bool	FileReadAsyncComplete( SteamAPICall_t hReadCall, void *pvBuffer, uint32 cub
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileReadAsyncComplete\n");
     if (!pvBuffer) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     auto a_read = std::find_if(async_reads.begin(), async_reads.end(), [&hReadCall](Async_Read const& item) { return item.api_call == hReadCall; });
     if (async_reads.end() == a_read)
@@ -195,7 +195,7 @@ SteamAPICall_t FileShare( const char *pchFile )
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileShare\n");
     if (!pchFile) return k_uAPICallInvalid;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     RemoteStorageFileShareResult_t data = {};
     if (local_storage->file_exists(Local_Storage::remote_storage_folder, pchFile)) {
         data.m_eResult = k_EResultOK;
@@ -220,7 +220,7 @@ bool	SetSyncPlatforms( const char *pchFile, ERemoteStoragePlatform eRemoteStorag
 UGCFileWriteStreamHandle_t FileWriteStreamOpen( const char *pchFile )
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileWriteStreamOpen\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     static UGCFileWriteStreamHandle_t handle;
     ++handle;
     struct Stream_Write stream_write;
@@ -233,7 +233,7 @@ UGCFileWriteStreamHandle_t FileWriteStreamOpen( const char *pchFile )
 bool FileWriteStreamWriteChunk( UGCFileWriteStreamHandle_t writeHandle, const void *pvData, int32 cubData )
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileWriteStreamWriteChunk\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto request = std::find_if(stream_writes.begin(), stream_writes.end(), [&writeHandle](struct Stream_Write const& item) { return item.write_stream_handle == writeHandle; });
     if (stream_writes.end() == request)
         return false;
@@ -245,7 +245,7 @@ bool FileWriteStreamWriteChunk( UGCFileWriteStreamHandle_t writeHandle, const vo
 bool FileWriteStreamClose( UGCFileWriteStreamHandle_t writeHandle )
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileWriteStreamClose\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto request = std::find_if(stream_writes.begin(), stream_writes.end(), [&writeHandle](struct Stream_Write const& item) { return item.write_stream_handle == writeHandle; });
     if (stream_writes.end() == request)
         return false;
@@ -258,7 +258,7 @@ bool FileWriteStreamClose( UGCFileWriteStreamHandle_t writeHandle )
 bool FileWriteStreamCancel( UGCFileWriteStreamHandle_t writeHandle )
 {
     PRINT_DEBUG("Steam_Remote_Storage::FileWriteStreamCancel\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto request = std::find_if(stream_writes.begin(), stream_writes.end(), [&writeHandle](struct Stream_Write const& item) { return item.write_stream_handle == writeHandle; });
     if (stream_writes.end() == request)
         return false;
@@ -607,7 +607,7 @@ SteamAPICall_t	GetPublishedFileDetails( PublishedFileId_t unPublishedFileId, uin
     //TODO: check what this function really returns
     return 0;
 /*
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     RemoteStorageGetPublishedFileDetailsResult_t data = {};
     data.m_eResult = k_EResultFail;
     data.m_nPublishedFileId = unPublishedFileId;
@@ -634,7 +634,7 @@ STEAM_CALL_RESULT( RemoteStorageEnumerateUserPublishedFilesResult_t )
 SteamAPICall_t	EnumerateUserPublishedFiles( uint32 unStartIndex )
 {
     PRINT_DEBUG("Steam_Remote_Storage::EnumerateUserPublishedFiles\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     RemoteStorageEnumerateUserPublishedFilesResult_t data;
     data.m_eResult = k_EResultOK;
     data.m_nResultsReturned = 0;
@@ -654,7 +654,7 @@ STEAM_CALL_RESULT( RemoteStorageEnumerateUserSubscribedFilesResult_t )
 SteamAPICall_t	EnumerateUserSubscribedFiles( uint32 unStartIndex )
 {
     PRINT_DEBUG("Steam_Remote_Storage::EnumerateUserSubscribedFiles\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     RemoteStorageEnumerateUserSubscribedFilesResult_t data;
     data.m_eResult = k_EResultOK;
     data.m_nResultsReturned = 0;
@@ -702,7 +702,7 @@ STEAM_CALL_RESULT( RemoteStorageEnumerateUserPublishedFilesResult_t )
 SteamAPICall_t	EnumerateUserSharedWorkshopFiles( CSteamID steamId, uint32 unStartIndex, SteamParamStringArray_t *pRequiredTags, SteamParamStringArray_t *pExcludedTags )
 {
     PRINT_DEBUG("Steam_Remote_Storage::EnumerateUserSharedWorkshopFiles\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     RemoteStorageEnumerateUserPublishedFilesResult_t data;
     data.m_eResult = k_EResultOK;
     data.m_nResultsReturned = 0;
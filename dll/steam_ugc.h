@@ -53,7 +53,7 @@ public ISteamUGC
 
 UGCQueryHandle_t new_ugc_query(bool return_all_subscribed = false, std::set<PublishedFileId_t> return_only = std::set<PublishedFileId_t>())
 {
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     struct UGC_query query;
     ++handle;
     query.handle = handle;
@@ -131,7 +131,7 @@ STEAM_CALL_RESULT( SteamUGCQueryCompleted_t )
 SteamAPICall_t SendQueryUGCRequest( UGCQueryHandle_t handle )
 {
     PRINT_DEBUG("Steam_UGC::SendQueryUGCRequest\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto request = std::find_if(ugc_queries.begin(), ugc_queries.end(), [&handle](struct UGC_query const& item) { return item.handle == handle; });
     if (ugc_queries.end() == request)
         return 0;
@@ -162,7 +162,7 @@ SteamAPICall_t SendQueryUGCRequest( UGCQueryHandle_t handle )
 bool GetQueryUGCResult( UGCQueryHandle_t handle, uint32 index, SteamUGCDetails_t *pDetails )
 {
     PRINT_DEBUG("Steam_UGC::GetQueryUGCResult %u\n", index);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (pDetails) {
         memset(pDetails, 0, sizeof(SteamUGCDetails_t));
         pDetails->m_eResult = k_EResultFail;
@@ -284,7 +284,7 @@ uint32 GetQueryUGCContentDescriptors( UGCQueryHandle_t handle, uint32 index, EUG
 bool ReleaseQueryUGCRequest( UGCQueryHandle_t handle )
 {
     PRINT_DEBUG("Steam_UGC::ReleaseQueryUGCRequest\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     auto request = std::find_if(ugc_queries.begin(), ugc_queries.end(), [&handle](struct UGC_query const& item) { return item.handle == handle; });
     if (ugc_queries.end() == request)
         return false;
@@ -664,7 +664,7 @@ STEAM_CALL_RESULT( RemoteStorageSubscribePublishedFileResult_t )
 SteamAPICall_t SubscribeItem( PublishedFileId_t nPublishedFileID )
 {
     PRINT_DEBUG("Steam_UGC::SubscribeItem %llu\n", nPublishedFileID);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     subscribed.insert(nPublishedFileID);
 
     RemoteStorageSubscribePublishedFileResult_t data;
@@ -682,7 +682,7 @@ STEAM_CALL_RESULT( RemoteStorageUnsubscribePublishedFileResult_t )
 SteamAPICall_t UnsubscribeItem( PublishedFileId_t nPublishedFileID )
 {
     PRINT_DEBUG("Steam_UGC::UnsubscribeItem %llu\n", nPublishedFileID);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     RemoteStorageUnsubscribePublishedFileResult_t data;
     data.m_eResult = k_EResultOK;
     if (subscribed.count(nPublishedFileID) == 0) {
@@ -698,7 +698,7 @@ SteamAPICall_t UnsubscribeItem( PublishedFileId_t nPublishedFileID )
 uint32 GetNumSubscribedItems()
 {
     PRINT_DEBUG("Steam_UGC::GetNumSubscribedItems\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return subscribed.size();
 }
  // number of subscribed items 
@@ -706,7 +706,7 @@ uint32 GetNumSubscribedItems()
 uint32 GetSubscribedItems( PublishedFileId_t* pvecPublishedFileID, uint32 cMaxEntries )
 {
     PRINT_DEBUG("Steam_UGC::GetSubscribedItems\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (cMaxEntries > subscribed.size()) {
         cMaxEntries = subscribed.size();
     }
@@ -720,7 +720,7 @@ uint32 GetSubscribedItems( PublishedFileId_t* pvecPublishedFileID, uint32 cMaxEn
 uint32 GetItemState( PublishedFileId_t nPublishedFileID )
 {
     PRINT_DEBUG("Steam_UGC::GetItemState %llu\n", nPublishedFileID);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (subscribed.count(nPublishedFileID)) {
         if (settings->isModInstalled(nPublishedFileID)) {
             return k_EItemStateInstalled | k_EItemStateSubscribed;
@@ -738,7 +738,7 @@ uint32 GetItemState( PublishedFileId_t nPublishedFileID )
 bool GetItemInstallInfo( PublishedFileId_t nPublishedFileID, uint64 *punSizeOnDisk, STEAM_OUT_STRING_COUNT( cchFolderSize ) char *pchFolder, uint32 cchFolderSize, uint32 *punTimeStamp )
 {
     PRINT_DEBUG("Steam_UGC::GetItemInstallInfo\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!settings->isModInstalled(nPublishedFileID)) {
         return false;
     }
@@ -810,7 +810,7 @@ STEAM_CALL_RESULT( StartPlaytimeTrackingResult_t )
 SteamAPICall_t StartPlaytimeTracking( PublishedFileId_t *pvecPublishedFileID, uint32 unNumPublishedFileIDs )
 {
     PRINT_DEBUG("Steam_UGC::StartPlaytimeTracking\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     StopPlaytimeTrackingResult_t data;
     data.m_eResult = k_EResultOK;
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
@@ -820,7 +820,7 @@ STEAM_CALL_RESULT( StopPlaytimeTrackingResult_t )
 SteamAPICall_t StopPlaytimeTracking( PublishedFileId_t *pvecPublishedFileID, uint32 unNumPublishedFileIDs )
 {
     PRINT_DEBUG("Steam_UGC::StopPlaytimeTracking\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     StopPlaytimeTrackingResult_t data;
     data.m_eResult = k_EResultOK;
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
@@ -830,7 +830,7 @@ STEAM_CALL_RESULT( StopPlaytimeTrackingResult_t )
 SteamAPICall_t StopPlaytimeTrackingForAllItems()
 {
     PRINT_DEBUG("Steam_UGC::StopPlaytimeTrackingForAllItems\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     StopPlaytimeTrackingResult_t data;
     data.m_eResult = k_EResultOK;
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
@@ -113,7 +113,7 @@ CSteamID GetSteamID()
 int InitiateGameConnection( void *pAuthBlob, int cbMaxAuthBlob, CSteamID steamIDGameServer, uint32 unIPServer, uint16 usPortServer, bool bSecure )
 {
     PRINT_DEBUG("InitiateGameConnection %i %llu %u %u %u\n", cbMaxAuthBlob, steamIDGameServer.ConvertToUint64(), unIPServer, usPortServer, bSecure);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (cbMaxAuthBlob < INITIATE_GAME_CONNECTION_TICKET_SIZE) return 0;
     uint32 out_size = INITIATE_GAME_CONNECTION_TICKET_SIZE;
     ticket_manager->getTicketData(pAuthBlob, INITIATE_GAME_CONNECTION_TICKET_SIZE, &out_size);
@@ -309,7 +309,7 @@ HAuthTicket GetAuthSessionTicket( void *pTicket, int cbMaxTicket, uint32 *pcbTic
 HAuthTicket GetAuthSessionTicket( void *pTicket, int cbMaxTicket, uint32 *pcbTicket, const SteamNetworkingIdentity *pSteamNetworkingIdentity )
 {
     PRINT_DEBUG("Steam_User::GetAuthSessionTicket %i\n", cbMaxTicket);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     return ticket_manager->getTicket(pTicket, cbMaxTicket, pcbTicket);
 }
@@ -328,7 +328,7 @@ HAuthTicket GetAuthTicketForWebApi( const char *pchIdentity )
 EBeginAuthSessionResult BeginAuthSession( const void *pAuthTicket, int cbAuthTicket, CSteamID steamID )
 {
     PRINT_DEBUG("Steam_User::BeginAuthSession %i %llu\n", cbAuthTicket, steamID.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     return ticket_manager->beginAuth(pAuthTicket, cbAuthTicket, steamID);
 }
@@ -337,7 +337,7 @@ EBeginAuthSessionResult BeginAuthSession( const void *pAuthTicket, int cbAuthTic
 void EndAuthSession( CSteamID steamID )
 {
     PRINT_DEBUG("Steam_User::EndAuthSession\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     ticket_manager->endAuth(steamID);
 }
@@ -346,7 +346,7 @@ void EndAuthSession( CSteamID steamID )
 void CancelAuthTicket( HAuthTicket hAuthTicket )
 {
     PRINT_DEBUG("Steam_User::CancelAuthTicket\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     ticket_manager->cancelTicket(hAuthTicket);
 }
@@ -382,7 +382,7 @@ STEAM_CALL_RESULT( EncryptedAppTicketResponse_t )
 SteamAPICall_t RequestEncryptedAppTicket( void *pDataToInclude, int cbDataToInclude )
 {
     PRINT_DEBUG("Steam_User::RequestEncryptedAppTicket %i\n", cbDataToInclude);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     EncryptedAppTicketResponse_t data;
 	data.m_eResult = k_EResultOK;
 
@@ -406,7 +406,7 @@ SteamAPICall_t RequestEncryptedAppTicket( void *pDataToInclude, int cbDataToIncl
         AppId_t appid;
         bool available;
         std::string name;
-        if (!settings->getDLC(appid, appid, available, name)) break;
+        if (!settings->getDLC(i, appid, available, name)) break;
         ticket.TicketV4.AppIDs.emplace_back(appid);
     }
 
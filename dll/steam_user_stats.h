@@ -21,6 +21,11 @@
 #include "base.h"
 #include "../overlay_experimental/steam_overlay.h"
 
+//seconds between the first unsaved stat or achievement change and it getting written to disk
+#define STATS_SAVE_DELAY 5.0
+//results of DownloadLeaderboardEntries kept around for GetDownloadedLeaderboardEntry
+#define MAX_LEADERBOARD_DOWNLOADS 64
+
 struct Steam_Leaderboard_Score {
     CSteamID steam_id;
     int32 score = 0;
@@ -31,7 +36,47 @@ struct Steam_Leaderboard {
     std::string name;
     ELeaderboardSortMethod sort_method;
     ELeaderboardDisplayType display_type;
-    Steam_Leaderboard_Score self_score;
+
+    //every score in the leaderboard file, best first, so a rank is just an index
+    std::vector<Steam_Leaderboard_Score> entries;
+    //steam id -> score, to find someone in entries with a binary search
+    std::unordered_map<uint64, int32> user_scores;
+    file_stamp_t file_stamp;
+
+    bool better(int32 score, uint64 steam_id, int32 other_score, uint64 other_steam_id) const {
+        if (score != other_score) {
+            if (sort_method == k_ELeaderboardSortMethodAscending) return score < other_score;
+            return score > other_score;
+        }
+
+        return steam_id < other_steam_id;
+    }
+
+    std::vector<Steam_Leaderboard_Score>::iterator position(int32 score, uint64 steam_id) {
+        return std::lower_bound(entries.begin(), entries.end(), score, [this, steam_id](const Steam_Leaderboard_Score &entry, int32 score) {
+            return better(entry.score, entry.steam_id.ConvertToUint64(), score, steam_id);
+        });
+    }
+
+    //0 based rank of the user or -1 if they have no score
+    int find_rank(CSteamID steam_id) {
+        auto user = user_scores.find(steam_id.ConvertToUint64());
+        if (user == user_scores.end()) return -1;
+        return position(user->second, steam_id.ConvertToUint64()) - entries.begin();
+    }
+
+    void set_score(Steam_Leaderboard_Score const& score) {
+        uint64 steam_id = score.steam_id.ConvertToUint64();
+        int rank = find_rank(score.steam_id);
+        if (rank >= 0) entries.erase(entries.begin() + rank);
+        entries.insert(position(score.score, steam_id), score);
+        user_scores[steam_id] = score.score;
+    }
+};
+
+struct Steam_Leaderboard_Entry {
+    int rank;
+    Steam_Leaderboard_Score score;
 };
 
 struct achievement_trigger {
@@ -71,6 +116,7 @@ public ISteamUserStats
 {
 public:
     static constexpr auto achievements_user_file = "achievements.json";
+    static constexpr auto stats_user_file = "stats.bin";
 
 private:
 
@@ -78,15 +124,26 @@ private:
     Settings *settings;
     SteamCallResults *callback_results;
     class SteamCallBacks *callbacks;
+    class RunEveryRunCB *run_every_runcb;
     class Steam_Overlay* overlay;
 
     std::vector<struct Steam_Leaderboard> leaderboards;
+    std::map<SteamLeaderboardEntries_t, std::vector<Steam_Leaderboard_Entry>> downloaded_entries;
+    SteamLeaderboardEntries_t last_downloaded_entries = 0;
 
     nlohmann::json defined_achievements;
     nlohmann::json user_achievements;
+    bool user_achievements_dirty = false;
+    std::chrono::high_resolution_clock::time_point user_achievements_modified;
     std::vector<std::string> sorted_achievement_names;
-    std::map<std::string, int32> stats_cache_int;
-    std::map<std::string, float> stats_cache_float;
+    //lowercase achievement name -> entry in defined_achievements, which isn't resized after the constructor
+    std::unordered_map<std::string, nlohmann::detail::iter_impl<nlohmann::json>> achievements_index;
+    //icon file -> image handle, the images are only decoded when the game gets their pixels
+    std::map<std::string, int> achievement_icons;
+    //raw value of every stat keyed by lowercase stat name, saved together in stats_user_file
+    std::map<std::string, std::string> user_stats;
+    bool user_stats_dirty = false;
+    std::chrono::high_resolution_clock::time_point user_stats_modified;
 
     std::map<std::string, std::vector<achievement_trigger>> achievement_stat_trigger;
 
@@ -103,13 +160,9 @@ unsigned int find_leaderboard(std::string name)
 
 nlohmann::detail::iter_impl<nlohmann::json> defined_achievements_find(std::string key)
 {
-    return std::find_if(defined_achievements.begin(), defined_achievements.end(), [key](nlohmann::json& item) {
-            std::string name = static_cast<std::string const&>(item["name"]);
-            return key.size() == name.size() && std::equal(name.begin(), name.end(), key.begin(),
-                                                            [](char a, char b) {
-                                                                return tolower(a) == tolower(b);
-                                                            });
-        });
+    auto it = achievements_index.find(ascii_to_lowercase(key));
+    if (it == achievements_index.end()) return defined_achievements.end();
+    return it->second;
 }
 
 void load_achievements_db()
@@ -125,36 +178,136 @@ void load_achievements()
 
 void save_achievements()
 {
-    local_storage->write_json_file("", achievements_user_file, user_achievements);
+    if (local_storage->write_json_file("", achievements_user_file, user_achievements)) {
+        user_achievements_dirty = false;
+    }
+}
+
+//unlocks are written together later, see RunCallbacks
+void achievements_modified()
+{
+    if (!user_achievements_dirty) {
+        user_achievements_dirty = true;
+        user_achievements_modified = std::chrono::high_resolution_clock::now();
+    }
 }
 
-void save_leaderboard_score(Steam_Leaderboard *leaderboard)
+void load_stats()
 {
+    std::string data;
+    if (local_storage->load_data_file("", stats_user_file, data)) {
+        //format: a list of [uint32 name size][name][uint32 value size][value]
+        size_t i = 0;
+        while (true) {
+            uint32 name_size, value_size;
+            if (i + sizeof(name_size) > data.size()) break;
+            memcpy(&name_size, data.data() + i, sizeof(name_size));
+            i += sizeof(name_size);
+            if (i + name_size > data.size()) break;
+            std::string name = data.substr(i, name_size);
+            i += name_size;
+
+            if (i + sizeof(value_size) > data.size()) break;
+            memcpy(&value_size, data.data() + i, sizeof(value_size));
+            i += sizeof(value_size);
+            if (i + value_size > data.size()) break;
+            user_stats[name] = data.substr(i, value_size);
+            i += value_size;
+        }
+
+        PRINT_DEBUG("Steam_User_Stats loaded %zu stats\n", user_stats.size());
+        return;
+    }
+
+    //old saves have one file per stat in the stats folder, they are left there untouched
+    if (local_storage->count_files(Local_Storage::stats_storage_folder) <= 0) return;
+    for (auto &name : Local_Storage::get_filenames_path(local_storage->get_path(Local_Storage::stats_storage_folder))) {
+        unsigned size = local_storage->file_size(Local_Storage::stats_storage_folder, name);
+        std::string value(size, '\0');
+        if (size && local_storage->get_data(Local_Storage::stats_storage_folder, name, &value[0], size) == size) {
+            user_stats[name] = value;
+        }
+    }
+
+    PRINT_DEBUG("Steam_User_Stats migrated %zu stats from the %s folder\n", user_stats.size(), Local_Storage::stats_storage_folder);
+    save_stats();
+}
+
+void save_stats()
+{
+    std::string data;
+    for (auto &s : user_stats) {
+        uint32 name_size = s.first.size(), value_size = s.second.size();
+        data.append((char *)&name_size, sizeof(name_size));
+        data.append(s.first);
+        data.append((char *)&value_size, sizeof(value_size));
+        data.append(s.second);
+    }
+
+    if (local_storage->store_data_file_atomic("", stats_user_file, data)) {
+        user_stats_dirty = false;
+    }
+}
+
+void set_stat_data(std::string const& stat_name, const char *data, unsigned size)
+{
+    user_stats[stat_name].assign(data, size);
+    if (!user_stats_dirty) {
+        user_stats_dirty = true;
+        user_stats_modified = std::chrono::high_resolution_clock::now();
+    }
+}
+
+bool stat_data_equals(std::string const& stat_name, const void *data, unsigned size)
+{
+    auto stat = user_stats.find(stat_name);
+    return stat != user_stats.end() && stat->second.size() == size && memcmp(stat->second.data(), data, size) == 0;
+}
+
+static void steam_user_stats_run_every_runcb(void *object)
+{
+    PRINT_DEBUG("Steam_User_Stats::steam_user_stats_run_every_runcb\n");
+
+    Steam_User_Stats *steam_user_stats = (Steam_User_Stats *)object;
+    steam_user_stats->RunCallbacks();
+}
+
+void save_leaderboard_scores(Steam_Leaderboard *leaderboard)
+{
+    //the entries are written best first so other instances sharing the folder load them without sorting
     std::vector<uint32_t> output;
-    uint64_t steam_id = leaderboard->self_score.steam_id.ConvertToUint64();
-    output.push_back(steam_id & 0xFFFFFFFF);
-    output.push_back(steam_id >> 32);
-
-    output.push_back(leaderboard->self_score.score);
-    output.push_back(leaderboard->self_score.score_details.size());
-    for (auto &s : leaderboard->self_score.score_details) {
-        output.push_back(s);
+    for (auto &score : leaderboard->entries) {
+        uint64_t steam_id = score.steam_id.ConvertToUint64();
+        output.push_back(steam_id & 0xFFFFFFFF);
+        output.push_back(steam_id >> 32);
+
+        output.push_back(score.score);
+        output.push_back(score.score_details.size());
+        for (auto &s : score.score_details) {
+            output.push_back(s);
+        }
     }
 
     std::string leaderboard_name = ascii_to_lowercase(leaderboard->name);
-    local_storage->store_data(Local_Storage::leaderboard_storage_folder, leaderboard_name, (char* )output.data(), sizeof(uint32_t) * output.size());
+    std::string data((char *)output.data(), sizeof(uint32_t) * output.size());
+    if (local_storage->store_data_file_atomic(Local_Storage::leaderboard_storage_folder, leaderboard_name, data)) {
+        leaderboard->file_stamp = local_storage->file_stamp(Local_Storage::leaderboard_storage_folder, leaderboard_name);
+    }
 }
 
-std::vector<Steam_Leaderboard_Score> load_leaderboard_scores(std::string name)
+void load_leaderboard_scores(Steam_Leaderboard *leaderboard)
 {
-    std::vector<Steam_Leaderboard_Score> out;
+    std::string leaderboard_name = ascii_to_lowercase(leaderboard->name);
+    leaderboard->file_stamp = local_storage->file_stamp(Local_Storage::leaderboard_storage_folder, leaderboard_name);
+    leaderboard->entries.clear();
+    leaderboard->user_scores.clear();
 
-    std::string leaderboard_name = ascii_to_lowercase(name);
-    unsigned size = local_storage->file_size(Local_Storage::leaderboard_storage_folder, leaderboard_name);
-    if (size == 0 || (size % sizeof(uint32_t)) != 0) return out;
+    std::string data;
+    if (!local_storage->load_data_file(Local_Storage::leaderboard_storage_folder, leaderboard_name, data)) return;
+    if ((data.size() % sizeof(uint32_t)) != 0) return;
 
-    std::vector<uint32_t> output(size / sizeof(uint32_t));
-    if (local_storage->get_data(Local_Storage::leaderboard_storage_folder, leaderboard_name, (char* )output.data(), size) != size) return out;
+    std::vector<uint32_t> output(data.size() / sizeof(uint32_t));
+    memcpy(output.data(), data.data(), data.size());
 
     unsigned i = 0;
     while (true) {
@@ -170,16 +323,48 @@ std::vector<Steam_Leaderboard_Score> load_leaderboard_scores(std::string name)
 
         if ((i + count) > output.size()) break;
 
-        for (unsigned j = 0; j < count; ++j) {
-            score.score_details.push_back(output[i]);
-            i += 1;
-        }
+        score.score_details.assign(output.begin() + i, output.begin() + i + count);
+        i += count;
+
+        leaderboard->entries.push_back(std::move(score));
+    }
+
+    //files from older versions or written with another sort method aren't in order
+    auto compare = [leaderboard](const Steam_Leaderboard_Score &a, const Steam_Leaderboard_Score &b) {
+        return leaderboard->better(a.score, a.steam_id.ConvertToUint64(), b.score, b.steam_id.ConvertToUint64());
+    };
+
+    if (!std::is_sorted(leaderboard->entries.begin(), leaderboard->entries.end(), compare)) {
+        std::sort(leaderboard->entries.begin(), leaderboard->entries.end(), compare);
+    }
+
+    //only keep the best score of every user
+    auto last = std::remove_if(leaderboard->entries.begin(), leaderboard->entries.end(), [leaderboard](const Steam_Leaderboard_Score &score) {
+        return !leaderboard->user_scores.emplace(score.steam_id.ConvertToUint64(), score.score).second;
+    });
+    leaderboard->entries.erase(last, leaderboard->entries.end());
 
-        PRINT_DEBUG("loaded leaderboard score %llu %u\n", score.steam_id.ConvertToUint64(), score.score);
-        out.push_back(score);
+    PRINT_DEBUG("loaded %zu scores for leaderboard %s\n", leaderboard->entries.size(), leaderboard->name.c_str());
+}
+
+//another instance sharing the leaderboard folder might have written new scores
+void reload_leaderboard_if_changed(Steam_Leaderboard *leaderboard)
+{
+    std::string leaderboard_name = ascii_to_lowercase(leaderboard->name);
+    if (local_storage->file_stamp(Local_Storage::leaderboard_storage_folder, leaderboard_name) != leaderboard->file_stamp) {
+        load_leaderboard_scores(leaderboard);
+    }
+}
+
+SteamLeaderboardEntries_t add_downloaded_entries(std::vector<Steam_Leaderboard_Entry> entries)
+{
+    ++last_downloaded_entries;
+    downloaded_entries[last_downloaded_entries] = std::move(entries);
+    while (downloaded_entries.size() > MAX_LEADERBOARD_DOWNLOADS) {
+        downloaded_entries.erase(downloaded_entries.begin());
     }
 
-    return out;
+    return last_downloaded_entries;
 }
 
 std::string get_value_for_language(nlohmann::json &json, std::string key, std::string language)
@@ -219,17 +404,20 @@ std::string get_value_for_language(nlohmann::json &json, std::string key, std::s
 }
 
 public:
-Steam_User_Stats(Settings *settings, Local_Storage *local_storage, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, Steam_Overlay* overlay):
+Steam_User_Stats(Settings *settings, Local_Storage *local_storage, class SteamCallResults *callback_results, class SteamCallBacks *callbacks, class RunEveryRunCB *run_every_runcb, Steam_Overlay* overlay):
     settings(settings),
     local_storage(local_storage),
     callback_results(callback_results),
     callbacks(callbacks),
+    run_every_runcb(run_every_runcb),
     defined_achievements(nlohmann::json::object()),
     user_achievements(nlohmann::json::object()),
     overlay(overlay)
 {
     load_achievements_db(); // achievements db
     load_achievements(); // achievements per user
+    load_stats();
+    this->run_every_runcb->add(&Steam_User_Stats::steam_user_stats_run_every_runcb, this);
 
     auto x = defined_achievements.begin();
     while (x != defined_achievements.end()) {
@@ -267,6 +455,13 @@ Steam_User_Stats(Settings *settings, Local_Storage *local_storage, class SteamCa
         it["description"] = get_value_for_language(it, "description", settings->get_language());
     }
 
+    for (auto it = defined_achievements.begin(); it != defined_achievements.end(); ++it) {
+        try {
+            //emplace keeps the first one if two names only differ in case
+            achievements_index.emplace(ascii_to_lowercase(static_cast<std::string const&>((*it)["name"])), it);
+        } catch (...) {}
+    }
+
     //TODO: not sure if the sort is actually case insensitive, ach names seem to be treated by steam as case insensitive so I assume they are.
     //need to find a game with achievements of different case names to confirm
     std::sort(sorted_achievement_names.begin(), sorted_achievement_names.end(), [](const std::string lhs, const std::string rhs){
@@ -275,12 +470,41 @@ Steam_User_Stats(Settings *settings, Local_Storage *local_storage, class SteamCa
     );
 }
 
+~Steam_User_Stats()
+{
+    this->run_every_runcb->remove(&Steam_User_Stats::steam_user_stats_run_every_runcb, this);
+}
+
+void RunCallbacks()
+{
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    if (user_stats_dirty && check_timedout(user_stats_modified, STATS_SAVE_DELAY)) {
+        save_stats();
+    }
+
+    if (user_achievements_dirty && check_timedout(user_achievements_modified, STATS_SAVE_DELAY)) {
+        save_achievements();
+    }
+}
+
+void flush_stats()
+{
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    if (user_stats_dirty) {
+        save_stats();
+    }
+
+    if (user_achievements_dirty) {
+        save_achievements();
+    }
+}
+
 // Ask the server to send down this user's data and achievements for this game
 STEAM_CALL_BACK( UserStatsReceived_t )
 bool RequestCurrentStats()
 {
     PRINT_DEBUG("Steam_User_Stats::RequestCurrentStats\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     UserStatsReceived_t data;
     data.m_nGameID = settings->get_local_game_id().ToUint64();
@@ -298,29 +522,20 @@ bool GetStat( const char *pchName, int32 *pData )
     if (!pchName || !pData) return false;
     std::string stat_name = ascii_to_lowercase(pchName);
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    auto stats_config = settings->getStats();
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    auto &stats_config = settings->getStats();
     auto stats_data = stats_config.find(stat_name);
     if (stats_data != stats_config.end()) {
         if (stats_data->second.type != Stat_Type::STAT_TYPE_INT) return false;
     }
 
-    auto cached_stat = stats_cache_int.find(stat_name);
-    if (cached_stat != stats_cache_int.end()) {
-        *pData = cached_stat->second;
-        return true;
-    }
-
-    int32 output = 0;
-    int read_data = local_storage->get_data(Local_Storage::stats_storage_folder, stat_name, (char* )&output, sizeof(output));
-    if (read_data == sizeof(int32)) {
-        stats_cache_int[stat_name] = output;
-        *pData = output;
+    auto stat = user_stats.find(stat_name);
+    if (stat != user_stats.end() && stat->second.size() >= sizeof(int32)) {
+        memcpy(pData, stat->second.data(), sizeof(int32));
         return true;
     }
 
     if (stats_data != stats_config.end()) {
-        stats_cache_int[stat_name] = stats_data->second.default_value_int;
         *pData = stats_data->second.default_value_int;
         return true;
     }
@@ -334,29 +549,20 @@ bool GetStat( const char *pchName, float *pData )
     if (!pchName || !pData) return false;
     std::string stat_name = ascii_to_lowercase(pchName);
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    auto stats_config = settings->getStats();
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    auto &stats_config = settings->getStats();
     auto stats_data = stats_config.find(stat_name);
     if (stats_data != stats_config.end()) {
         if (stats_data->second.type == Stat_Type::STAT_TYPE_INT) return false;
     }
 
-    auto cached_stat = stats_cache_float.find(stat_name);
-    if (cached_stat != stats_cache_float.end()) {
-        *pData = cached_stat->second;
-        return true;
-    }
-
-    float output = 0.0;
-    int read_data = local_storage->get_data(Local_Storage::stats_storage_folder, stat_name, (char* )&output, sizeof(output));
-    if (read_data == sizeof(float)) {
-        stats_cache_float[stat_name] = output;
-        *pData = output;
+    auto stat = user_stats.find(stat_name);
+    if (stat != user_stats.end() && stat->second.size() >= sizeof(float)) {
+        memcpy(pData, stat->second.data(), sizeof(float));
         return true;
     }
 
     if (stats_data != stats_config.end()) {
-        stats_cache_float[stat_name] = stats_data->second.default_value_float;
         *pData = stats_data->second.default_value_float;
         return true;
     }
@@ -372,11 +578,8 @@ bool SetStat( const char *pchName, int32 nData )
     if (!pchName) return false;
     std::string stat_name = ascii_to_lowercase(pchName);
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    auto cached_stat = stats_cache_int.find(stat_name);
-    if (cached_stat != stats_cache_int.end()) {
-        if (cached_stat->second == nData) return true;
-    }
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    if (stat_data_equals(stat_name, &nData, sizeof(nData))) return true;
 
     auto stat_trigger = achievement_stat_trigger.find(stat_name);
     if (stat_trigger != achievement_stat_trigger.end()) {
@@ -387,12 +590,8 @@ bool SetStat( const char *pchName, int32 nData )
         }
     }
 
-    if (local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, (char* )&nData, sizeof(nData)) == sizeof(nData)) {
-        stats_cache_int[stat_name] = nData;
-        return true;
-    }
-
-    return false;
+    set_stat_data(stat_name, (char* )&nData, sizeof(nData));
+    return true;
 }
 
 bool SetStat( const char *pchName, float fData )
@@ -401,11 +600,8 @@ bool SetStat( const char *pchName, float fData )
     if (!pchName) return false;
     std::string stat_name = ascii_to_lowercase(pchName);
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    auto cached_stat = stats_cache_float.find(stat_name);
-    if (cached_stat != stats_cache_float.end()) {
-        if (cached_stat->second == fData) return true;
-    }
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    if (stat_data_equals(stat_name, &fData, sizeof(fData))) return true;
 
     auto stat_trigger = achievement_stat_trigger.find(stat_name);
     if (stat_trigger != achievement_stat_trigger.end()) {
@@ -416,12 +612,8 @@ bool SetStat( const char *pchName, float fData )
         }
     }
 
-    if (local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, (char* )&fData, sizeof(fData)) == sizeof(fData)) {
-        stats_cache_float[stat_name] = fData;
-        return true;
-    }
-
-    return false;
+    set_stat_data(stat_name, (char* )&fData, sizeof(fData));
+    return true;
 }
 
 bool UpdateAvgRateStat( const char *pchName, float flCountThisSession, double dSessionLength )
@@ -430,15 +622,16 @@ bool UpdateAvgRateStat( const char *pchName, float flCountThisSession, double dS
     if (!pchName) return false;
     std::string stat_name = ascii_to_lowercase(pchName);
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
+    //average, count, session length
     char data[sizeof(float) + sizeof(float) + sizeof(double)];
-    int read_data = local_storage->get_data(Local_Storage::stats_storage_folder, stat_name, (char* )data, sizeof(*data));
     float oldcount = 0;
     double oldsessionlength = 0;
-    if (read_data == sizeof(data)) {
-        memcpy(&oldcount, data + sizeof(float), sizeof(oldcount));
-        memcpy(&oldsessionlength, data + sizeof(float) + sizeof(double), sizeof(oldsessionlength));
+    auto stat = user_stats.find(stat_name);
+    if (stat != user_stats.end() && stat->second.size() == sizeof(data)) {
+        memcpy(&oldcount, stat->second.data() + sizeof(float), sizeof(oldcount));
+        memcpy(&oldsessionlength, stat->second.data() + sizeof(float) * 2, sizeof(oldsessionlength));
     }
 
     oldcount += flCountThisSession;
@@ -449,12 +642,8 @@ bool UpdateAvgRateStat( const char *pchName, float flCountThisSession, double dS
     memcpy(data + sizeof(float), &oldcount, sizeof(oldcount));
     memcpy(data + sizeof(float) * 2, &oldsessionlength, sizeof(oldsessionlength));
 
-    if (local_storage->store_data(Local_Storage::stats_storage_folder, stat_name, data, sizeof(data)) == sizeof(data)) {
-        stats_cache_float[stat_name] = average;
-        return true;
-    }
-
-    return false;
+    set_stat_data(stat_name, data, sizeof(data));
+    return true;
 }
 
 
@@ -463,7 +652,7 @@ bool GetAchievement( const char *pchName, bool *pbAchieved )
 {
     PRINT_DEBUG("GetAchievement %s\n", pchName);
     if (pchName == nullptr) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     try {
         auto it = defined_achievements_find(pchName);
@@ -486,7 +675,7 @@ bool SetAchievement( const char *pchName )
 {
     PRINT_DEBUG("SetAchievement %s\n", pchName);
     if (pchName == nullptr) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     try {
         auto it = defined_achievements_find(pchName);
@@ -500,7 +689,7 @@ bool SetAchievement( const char *pchName )
 #ifdef EMU_OVERLAY
                 overlay->AddAchievementNotification(it.value());
 #endif
-                save_achievements();
+                achievements_modified();
             }
 
             return true;
@@ -514,7 +703,7 @@ bool ClearAchievement( const char *pchName )
 {
     PRINT_DEBUG("ClearAchievement %s\n", pchName);
     if (pchName == nullptr) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     try {
         auto it = defined_achievements_find(pchName);
@@ -524,7 +713,7 @@ bool ClearAchievement( const char *pchName )
         if (it != defined_achievements.end()) {
             user_achievements[pch_name]["earned"] = false;
             user_achievements[pch_name]["earned_time"] = static_cast<uint32>(0);
-            save_achievements();
+            achievements_modified();
             return true;
         }
     } catch (...) {}
@@ -540,7 +729,7 @@ bool GetAchievementAndUnlockTime( const char *pchName, bool *pbAchieved, uint32
 {
     PRINT_DEBUG("GetAchievementAndUnlockTime\n");
     if (pchName == nullptr) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     try {
         auto it = defined_achievements_find(pchName);
@@ -571,7 +760,8 @@ bool GetAchievementAndUnlockTime( const char *pchName, bool *pbAchieved, uint32
 bool StoreStats()
 {
     PRINT_DEBUG("StoreStats\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    flush_stats();
 
     UserStatsStored_t data;
     data.m_nGameID = settings->get_local_game_id().ToUint64();
@@ -591,7 +781,28 @@ int GetAchievementIcon( const char *pchName )
 {
     PRINT_DEBUG("GetAchievementIcon\n");
     if (pchName == nullptr) return 0;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+
+    try {
+        auto it = defined_achievements_find(pchName);
+        if (it == defined_achievements.end()) return 0;
+        std::string pch_name = it->value("name", std::string());
+
+        bool achieved = false;
+        auto ach = user_achievements.find(pch_name);
+        if (ach != user_achievements.end()) achieved = ach->value("earned", false);
+
+        std::string icon = it->value(achieved ? "icon" : "icongray", std::string());
+        if (icon.empty()) icon = it->value("icon", std::string());
+        if (icon.empty()) return 0;
+
+        auto image = achievement_icons.find(icon);
+        if (image != achievement_icons.end()) return image->second;
+
+        int handle = settings->add_image_file(Local_Storage::get_game_settings_path() + icon);
+        achievement_icons[icon] = handle;
+        return handle;
+    } catch (...) {}
 
     return 0;
 }
@@ -606,7 +817,7 @@ const char * GetAchievementDisplayAttribute( const char *pchName, const char *pc
     if (pchName == nullptr) return "";
     if (pchKey == nullptr) return "";
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (strcmp (pchKey, "name") == 0) {
         try {
@@ -645,7 +856,7 @@ bool IndicateAchievementProgress( const char *pchName, uint32 nCurProgress, uint
 {
     PRINT_DEBUG("IndicateAchievementProgress %s\n", pchName);
     if (pchName == nullptr) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     try {
         auto it = defined_achievements_find(pchName);
@@ -675,7 +886,7 @@ bool IndicateAchievementProgress( const char *pchName, uint32 nCurProgress, uint
                 data.m_nMaxProgress = nMaxProgress;
             }
 
-            save_achievements();
+            achievements_modified();
             callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
             return true;
         }
@@ -690,7 +901,7 @@ bool IndicateAchievementProgress( const char *pchName, uint32 nCurProgress, uint
 uint32 GetNumAchievements()
 {
     PRINT_DEBUG("GetNumAchievements\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     return defined_achievements.size();
 }
 
@@ -716,7 +927,7 @@ STEAM_CALL_RESULT( UserStatsReceived_t )
 SteamAPICall_t RequestUserStats( CSteamID steamIDUser )
 {
     PRINT_DEBUG("Steam_User_Stats::RequestUserStats %llu\n", steamIDUser.ConvertToUint64());
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     // Enable this to allow hot reload achievements status
     //if (steamIDUser == settings->get_local_steam_id()) {
@@ -738,7 +949,7 @@ bool GetUserStat( CSteamID steamIDUser, const char *pchName, int32 *pData )
     PRINT_DEBUG("GetUserStat %s %llu\n", pchName, steamIDUser.ConvertToUint64());
     if (pchName == nullptr) return false;
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (steamIDUser == settings->get_local_steam_id()) {
         GetStat(pchName, pData);
@@ -754,7 +965,7 @@ bool GetUserStat( CSteamID steamIDUser, const char *pchName, float *pData )
     PRINT_DEBUG("GetUserStat %s %llu\n", pchName, steamIDUser.ConvertToUint64());
     if (pchName == nullptr) return false;
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (steamIDUser == settings->get_local_steam_id()) {
         GetStat(pchName, pData);
@@ -769,7 +980,7 @@ bool GetUserAchievement( CSteamID steamIDUser, const char *pchName, bool *pbAchi
 {
     PRINT_DEBUG("GetUserAchievement %s\n", pchName);
     if (pchName == nullptr) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (steamIDUser == settings->get_local_steam_id()) {
         return GetAchievement(pchName, pbAchieved);
@@ -783,7 +994,7 @@ bool GetUserAchievementAndUnlockTime( CSteamID steamIDUser, const char *pchName,
 {
     PRINT_DEBUG("GetUserAchievementAndUnlockTime %s\n", pchName);
     if (pchName == nullptr) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (steamIDUser == settings->get_local_steam_id()) {
         return GetAchievementAndUnlockTime(pchName, pbAchieved, punUnlockTime);
@@ -796,7 +1007,7 @@ bool GetUserAchievementAndUnlockTime( CSteamID steamIDUser, const char *pchName,
 bool ResetAllStats( bool bAchievementsToo )
 {
     PRINT_DEBUG("ResetAllStats\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     //TODO
     if (bAchievementsToo) {
         std::for_each(user_achievements.begin(), user_achievements.end(), [](nlohmann::json& v) {
@@ -817,7 +1028,7 @@ STEAM_CALL_RESULT(LeaderboardFindResult_t)
 SteamAPICall_t FindOrCreateLeaderboard( const char *pchLeaderboardName, ELeaderboardSortMethod eLeaderboardSortMethod, ELeaderboardDisplayType eLeaderboardDisplayType )
 {
     PRINT_DEBUG("FindOrCreateLeaderboard %s\n", pchLeaderboardName);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!pchLeaderboardName) {
         LeaderboardFindResult_t data;
         data.m_hSteamLeaderboard = 0;
@@ -831,15 +1042,9 @@ SteamAPICall_t FindOrCreateLeaderboard( const char *pchLeaderboardName, ELeaderb
         leaderboard.name = std::string(pchLeaderboardName);
         leaderboard.sort_method = eLeaderboardSortMethod;
         leaderboard.display_type = eLeaderboardDisplayType;
+        load_leaderboard_scores(&leaderboard);
 
-        std::vector<Steam_Leaderboard_Score> scores = load_leaderboard_scores(pchLeaderboardName);
-        for (auto &s : scores) {
-            if (s.steam_id == settings->get_local_steam_id()) {
-                leaderboard.self_score = s;
-            }
-        }
-
-        leaderboards.push_back(leaderboard);
+        leaderboards.push_back(std::move(leaderboard));
         leader = leaderboards.size();
     }
 
@@ -856,7 +1061,7 @@ STEAM_CALL_RESULT( LeaderboardFindResult_t )
 SteamAPICall_t FindLeaderboard( const char *pchLeaderboardName )
 {
     PRINT_DEBUG("FindLeaderboard %s\n", pchLeaderboardName);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!pchLeaderboardName) {
         LeaderboardFindResult_t data;
         data.m_hSteamLeaderboard = 0;
@@ -883,7 +1088,7 @@ SteamAPICall_t FindLeaderboard( const char *pchLeaderboardName )
 const char * GetLeaderboardName( SteamLeaderboard_t hSteamLeaderboard )
 {
     PRINT_DEBUG("GetLeaderboardName\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
     if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) return "";
     return leaderboards[hSteamLeaderboard - 1].name.c_str();
@@ -894,7 +1099,9 @@ const char * GetLeaderboardName( SteamLeaderboard_t hSteamLeaderboard )
 int GetLeaderboardEntryCount( SteamLeaderboard_t hSteamLeaderboard )
 {
     PRINT_DEBUG("GetLeaderboardEntryCount\n");
-    return 0;
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) return 0;
+    return leaderboards[hSteamLeaderboard - 1].entries.size();
 }
 
 
@@ -902,7 +1109,7 @@ int GetLeaderboardEntryCount( SteamLeaderboard_t hSteamLeaderboard )
 ELeaderboardSortMethod GetLeaderboardSortMethod( SteamLeaderboard_t hSteamLeaderboard )
 {
     PRINT_DEBUG("GetLeaderboardSortMethod\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) return k_ELeaderboardSortMethodNone;
     return leaderboards[hSteamLeaderboard - 1].sort_method; 
 }
@@ -912,7 +1119,7 @@ ELeaderboardSortMethod GetLeaderboardSortMethod( SteamLeaderboard_t hSteamLeader
 ELeaderboardDisplayType GetLeaderboardDisplayType( SteamLeaderboard_t hSteamLeaderboard )
 {
     PRINT_DEBUG("GetLeaderboardDisplayType\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) return k_ELeaderboardDisplayTypeNone;
     return leaderboards[hSteamLeaderboard - 1].display_type; 
 }
@@ -930,13 +1137,44 @@ STEAM_CALL_RESULT( LeaderboardScoresDownloaded_t )
 SteamAPICall_t DownloadLeaderboardEntries( SteamLeaderboard_t hSteamLeaderboard, ELeaderboardDataRequest eLeaderboardDataRequest, int nRangeStart, int nRangeEnd )
 {
     PRINT_DEBUG("DownloadLeaderboardEntries %llu %i %i %i\n", hSteamLeaderboard, eLeaderboardDataRequest, nRangeStart, nRangeEnd);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) return k_uAPICallInvalid; //might return callresult even if hSteamLeaderboard is invalid
 
+    Steam_Leaderboard *leaderboard = &(leaderboards[hSteamLeaderboard - 1]);
+    reload_leaderboard_if_changed(leaderboard);
+
+    //ranges are inclusive, converted here to 0 based [start, end)
+    int start = 0, end = 0;
+    if (eLeaderboardDataRequest == k_ELeaderboardDataRequestGlobal) {
+        start = nRangeStart - 1;
+        end = nRangeEnd;
+    } else if (eLeaderboardDataRequest == k_ELeaderboardDataRequestGlobalAroundUser) {
+        int rank = leaderboard->find_rank(settings->get_local_steam_id());
+        if (rank >= 0) {
+            start = rank + nRangeStart;
+            end = rank + nRangeEnd + 1;
+        }
+    } else if (eLeaderboardDataRequest == k_ELeaderboardDataRequestFriends) {
+        //TODO: friends, only the current user for now
+        int rank = leaderboard->find_rank(settings->get_local_steam_id());
+        if (rank >= 0) {
+            start = rank;
+            end = rank + 1;
+        }
+    }
+
+    start = std::max(start, 0);
+    end = std::min(end, (int)leaderboard->entries.size());
+
+    std::vector<Steam_Leaderboard_Entry> entries;
+    for (int i = start; i < end; ++i) {
+        entries.push_back({i + 1, leaderboard->entries[i]});
+    }
+
     LeaderboardScoresDownloaded_t data;
     data.m_hSteamLeaderboard = hSteamLeaderboard;
-    data.m_hSteamLeaderboardEntries = hSteamLeaderboard;
-    data.m_cEntryCount = leaderboards[hSteamLeaderboard - 1].self_score.steam_id.IsValid();
+    data.m_cEntryCount = entries.size();
+    data.m_hSteamLeaderboardEntries = add_downloaded_entries(std::move(entries));
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
 }
 
@@ -949,20 +1187,24 @@ SteamAPICall_t DownloadLeaderboardEntriesForUsers( SteamLeaderboard_t hSteamLead
                                                             STEAM_ARRAY_COUNT_D(cUsers, Array of users to retrieve) CSteamID *prgUsers, int cUsers )
 {
     PRINT_DEBUG("DownloadLeaderboardEntriesForUsers %i %llu\n", cUsers, cUsers > 0 ? prgUsers[0].ConvertToUint64() : 0);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) return k_uAPICallInvalid; //might return callresult even if hSteamLeaderboard is invalid
 
-    bool get_for_current_id = false;
+    Steam_Leaderboard *leaderboard = &(leaderboards[hSteamLeaderboard - 1]);
+    reload_leaderboard_if_changed(leaderboard);
+
+    std::vector<Steam_Leaderboard_Entry> entries;
     for (int i = 0; i < cUsers; ++i) {
-        if (prgUsers[i] == settings->get_local_steam_id()) {
-            get_for_current_id = true;
+        int rank = leaderboard->find_rank(prgUsers[i]);
+        if (rank >= 0) {
+            entries.push_back({rank + 1, leaderboard->entries[rank]});
         }
     }
 
     LeaderboardScoresDownloaded_t data;
     data.m_hSteamLeaderboard = hSteamLeaderboard;
-    data.m_hSteamLeaderboardEntries = hSteamLeaderboard;
-    data.m_cEntryCount = get_for_current_id && leaderboards[hSteamLeaderboard - 1].self_score.steam_id.IsValid();
+    data.m_cEntryCount = entries.size();
+    data.m_hSteamLeaderboardEntries = add_downloaded_entries(std::move(entries));
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
 }
 
@@ -984,19 +1226,22 @@ SteamAPICall_t DownloadLeaderboardEntriesForUsers( SteamLeaderboard_t hSteamLead
 bool GetDownloadedLeaderboardEntry( SteamLeaderboardEntries_t hSteamLeaderboardEntries, int index, LeaderboardEntry_t *pLeaderboardEntry, int32 *pDetails, int cDetailsMax )
 {
     PRINT_DEBUG("GetDownloadedLeaderboardEntry\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
-    if (hSteamLeaderboardEntries > leaderboards.size() || hSteamLeaderboardEntries <= 0) return false;
-    if (index > 0) return false;
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
+    auto entries = downloaded_entries.find(hSteamLeaderboardEntries);
+    if (entries == downloaded_entries.end()) return false;
+    if (index < 0 || (size_t)index >= entries->second.size()) return false;
 
+    Steam_Leaderboard_Entry &downloaded = entries->second[index];
     LeaderboardEntry_t entry = {};
-    entry.m_steamIDUser = leaderboards[hSteamLeaderboardEntries - 1].self_score.steam_id;
-    entry.m_nGlobalRank = 1;
-    entry.m_nScore = leaderboards[hSteamLeaderboardEntries - 1].self_score.score;
-    for (int i = 0; i < leaderboards[hSteamLeaderboardEntries - 1].self_score.score_details.size() && i < cDetailsMax; ++i) {
-        pDetails[i] = leaderboards[hSteamLeaderboardEntries - 1].self_score.score_details[i];
+    entry.m_steamIDUser = downloaded.score.steam_id;
+    entry.m_nGlobalRank = downloaded.rank;
+    entry.m_nScore = downloaded.score.score;
+    entry.m_cDetails = downloaded.score.score_details.size();
+    for (int i = 0; i < downloaded.score.score_details.size() && i < cDetailsMax; ++i) {
+        pDetails[i] = downloaded.score.score_details[i];
     }
 
-    *pLeaderboardEntry = entry;
+    if (pLeaderboardEntry) *pLeaderboardEntry = entry;
     return true;
 }
 
@@ -1009,7 +1254,7 @@ STEAM_CALL_RESULT( LeaderboardScoreUploaded_t )
 SteamAPICall_t UploadLeaderboardScore( SteamLeaderboard_t hSteamLeaderboard, ELeaderboardUploadScoreMethod eLeaderboardUploadScoreMethod, int32 nScore, const int32 *pScoreDetails, int cScoreDetailsCount )
 {
     PRINT_DEBUG("UploadLeaderboardScore %i\n", nScore);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) return k_uAPICallInvalid; //TODO: might return callresult even if hSteamLeaderboard is invalid
 
     Steam_Leaderboard_Score score;
@@ -1019,29 +1264,44 @@ SteamAPICall_t UploadLeaderboardScore( SteamLeaderboard_t hSteamLeaderboard, ELe
         score.score_details.push_back(pScoreDetails[i]);
     }
 
+    Steam_Leaderboard *leaderboard = &(leaderboards[hSteamLeaderboard - 1]);
+    //other instances sharing the leaderboard folder upload too: re-read the file and write it back
+    //with this score merged in while holding its lock so neither side overwrites the other's scores
+    file_lock_t file_lock;
+    bool locked = local_storage->lock_data_file(Local_Storage::leaderboard_storage_folder, ascii_to_lowercase(leaderboard->name), file_lock);
+    reload_leaderboard_if_changed(leaderboard);
+
+    int previous_rank = leaderboard->find_rank(score.steam_id);
     bool changed = false;
-    if (eLeaderboardUploadScoreMethod == k_ELeaderboardUploadScoreMethodKeepBest) {
-        if (leaderboards[hSteamLeaderboard - 1].self_score.score <= score.score) {
-            leaderboards[hSteamLeaderboard - 1].self_score = score;
-            changed = true;
+    bool update = true;
+    if (previous_rank >= 0) {
+        Steam_Leaderboard_Score &previous = leaderboard->entries[previous_rank];
+        changed = previous.score != score.score;
+        if (eLeaderboardUploadScoreMethod == k_ELeaderboardUploadScoreMethodKeepBest) {
+            update = !leaderboard->better(previous.score, 0, score.score, 0);
         }
     } else {
-        if (leaderboards[hSteamLeaderboard - 1].self_score.score != score.score) changed = true;
-        leaderboards[hSteamLeaderboard - 1].self_score = score;
+        changed = true;
     }
 
-    if (changed) {
-        save_leaderboard_score(&(leaderboards[hSteamLeaderboard - 1]));
+    if (update) {
+        //details can change even when the score doesn't
+        leaderboard->set_score(score);
+        save_leaderboard_scores(leaderboard);
+    } else {
+        changed = false;
     }
 
+    if (locked) local_storage->unlock_data_file(file_lock);
+
     LeaderboardScoreUploaded_t data;
     data.m_bSuccess = 1; //needs to be success or DOA6 freezes when uploading score.
     //data.m_bSuccess = 0;
     data.m_hSteamLeaderboard = hSteamLeaderboard;
     data.m_nScore = nScore;
     data.m_bScoreChanged = changed;
-    data.m_nGlobalRankNew = 1;
-    data.m_nGlobalRankPrevious = 0;
+    data.m_nGlobalRankNew = leaderboard->find_rank(score.steam_id) + 1;
+    data.m_nGlobalRankPrevious = previous_rank + 1;
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
 }
 
@@ -1059,7 +1319,7 @@ STEAM_CALL_RESULT( LeaderboardUGCSet_t )
 SteamAPICall_t AttachLeaderboardUGC( SteamLeaderboard_t hSteamLeaderboard, UGCHandle_t hUGC )
 {
     PRINT_DEBUG("AttachLeaderboardUGC\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     LeaderboardUGCSet_t data = {};
     if (hSteamLeaderboard > leaderboards.size() || hSteamLeaderboard <= 0) {
         data.m_eResult = k_EResultFail;
@@ -1078,7 +1338,7 @@ STEAM_CALL_RESULT( NumberOfCurrentPlayers_t )
 SteamAPICall_t GetNumberOfCurrentPlayers()
 {
     PRINT_DEBUG("GetNumberOfCurrentPlayers\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     NumberOfCurrentPlayers_t data;
     data.m_bSuccess = 1;
     data.m_cPlayers = 69;
@@ -1133,7 +1393,7 @@ STEAM_CALL_RESULT( GlobalStatsReceived_t )
 SteamAPICall_t RequestGlobalStats( int nHistoryDays )
 {
     PRINT_DEBUG("RequestGlobalStats %i\n", nHistoryDays);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     GlobalStatsReceived_t data;
     data.m_nGameID = settings->get_local_game_id().ToUint64();
     data.m_eResult = k_EResultOK;
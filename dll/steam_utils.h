@@ -90,13 +90,13 @@ bool GetImageSize( int iImage, uint32 *pnWidth, uint32 *pnHeight )
 {
     PRINT_DEBUG("GetImageSize %i\n", iImage);
     if (!iImage || !pnWidth || !pnHeight) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
-    auto image = settings->images.find(iImage);
-    if (image == settings->images.end()) return false;
+    struct Image_Data *image = settings->get_image(iImage);
+    if (!image) return false;
 
-    *pnWidth = image->second.width;
-    *pnHeight = image->second.height;
+    *pnWidth = image->width;
+    *pnHeight = image->height;
     return true;
 }
 
@@ -107,14 +107,19 @@ bool GetImageRGBA( int iImage, uint8 *pubDest, int nDestBufferSize )
 {
     PRINT_DEBUG("GetImageRGBA %i\n", iImage);
     if (!iImage || !pubDest || !nDestBufferSize) return false;
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
 
-    auto image = settings->images.find(iImage);
-    if (image == settings->images.end()) return false;
+    struct Image_Data *image = settings->get_image(iImage);
+    if (!image) return false;
+
+    if (image->data.empty()) {
+        unsigned size = image->width * image->height * 4;
+        if (nDestBufferSize < size) size = nDestBufferSize;
+        memset(pubDest, 0, size);
+    } else {
+        image->data.copy((char *)pubDest, nDestBufferSize);
+    }
 
-    unsigned size = image->second.data.size();
-    if (nDestBufferSize < size) size = nDestBufferSize;
-    image->second.data.copy((char *)pubDest, nDestBufferSize);
     return true;
 }
 
@@ -161,7 +166,7 @@ bool IsAPICallCompleted( SteamAPICall_t hSteamAPICall, bool *pbFailed )
         return true;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (!callback_results->exists(hSteamAPICall)) return false;
     if (pbFailed) *pbFailed = false;
     return true; //all api calls "complete" right away
@@ -176,7 +181,7 @@ ESteamAPICallFailure GetAPICallFailureReason( SteamAPICall_t hSteamAPICall )
 bool GetAPICallResult( SteamAPICall_t hSteamAPICall, void *pCallback, int cubCallback, int iCallbackExpected, bool *pbFailed )
 {
     PRINT_DEBUG("GetAPICallResult %llu %i %i %p\n", hSteamAPICall, cubCallback, iCallbackExpected, pbFailed);
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     if (callback_results->callback_result(hSteamAPICall, pCallback, cubCallback)) {
         if (pbFailed) *pbFailed = false;
         PRINT_DEBUG("GetAPICallResult Succeeded\n");
@@ -254,7 +259,7 @@ STEAM_CALL_RESULT( CheckFileSignature_t )
 SteamAPICall_t CheckFileSignature( const char *szFileName )
 {
     PRINT_DEBUG("CheckFileSignature\n");
-    std::lock_guard<std::recursive_mutex> lock(global_mutex);
+    std::lock_guard<Tracked_Mutex> lock(global_mutex);
     CheckFileSignature_t data;
     data.m_eCheckFileSignature = k_ECheckFileSignatureValidSignature;
     return callback_results->addCallResult(data.k_iCallback, &data, sizeof(data));
@@ -0,0 +1,190 @@
+/* Copyright (C) 2019 Mr Goldberg
+   This file is part of the Goldberg Emulator
+
+   The Goldberg Emulator is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   The Goldberg Emulator is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the Goldberg Emulator; if not, see
+   <http://www.gnu.org/licenses/>.  */
+
+/*
+Loopback microbenchmark for the linux udp paths in dll/network.cpp: one sendto/recvfrom per packet
+against batches of UDP_BATCH_SIZE with sendmmsg/recvmmsg, set up the same way the emu does it.
+Send and receive are timed separately: sends go to a socket nobody reads, receives drain a socket
+that was filled beforehand.
+
+g++ -O2 -std=c++14 scripts/udp_batch_benchmark.cpp -o udp_batch_benchmark
+./udp_batch_benchmark [packet size] [rounds]
+*/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+//same values as dll/network.h
+#define MAX_UDP_SIZE 16384
+#define UDP_BATCH_SIZE 16
+
+//packets queued before each receive pass, must fit in the receive buffer
+#define FILL_PACKETS 4096
+#define SEND_PACKETS 65536
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int bound_socket(struct sockaddr_in *addr)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int buffer_size = 64 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(*addr);
+    bind(sock, (struct sockaddr *)addr, length);
+    getsockname(sock, (struct sockaddr *)addr, &length);
+    return sock;
+}
+
+static int send_batch(int sock, struct sockaddr_in *to, char *data, unsigned size, unsigned count)
+{
+    struct mmsghdr msgs[UDP_BATCH_SIZE];
+    struct iovec iovecs[UDP_BATCH_SIZE];
+    struct sockaddr_in addrs[UDP_BATCH_SIZE];
+    memset(msgs, 0, sizeof(msgs));
+    memset(addrs, 0, sizeof(addrs));
+    for (unsigned i = 0; i < count; ++i) {
+        addrs[i].sin_family = AF_INET;
+        addrs[i].sin_addr = to->sin_addr;
+        addrs[i].sin_port = to->sin_port;
+        iovecs[i].iov_base = data;
+        iovecs[i].iov_len = size;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+
+    return sendmmsg(sock, msgs, count, MSG_NOSIGNAL);
+}
+
+static int receive_single(int sock, std::vector<char> &buffers)
+{
+    int count = 0;
+    while (count < UDP_BATCH_SIZE) {
+        struct sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        int ret = recvfrom(sock, &buffers[count * MAX_UDP_SIZE], MAX_UDP_SIZE, MSG_DONTWAIT, (struct sockaddr *)&addr, &addrlen);
+        if (ret < 0) break;
+        ++count;
+    }
+
+    return count;
+}
+
+static int receive_batch(int sock, std::vector<char> &buffers)
+{
+    struct mmsghdr msgs[UDP_BATCH_SIZE] = {};
+    struct iovec iovecs[UDP_BATCH_SIZE];
+    struct sockaddr_in addrs[UDP_BATCH_SIZE];
+    for (unsigned i = 0; i < UDP_BATCH_SIZE; ++i) {
+        iovecs[i].iov_base = &buffers[i * MAX_UDP_SIZE];
+        iovecs[i].iov_len = MAX_UDP_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+
+    int ret = recvmmsg(sock, msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+    return ret < 0 ? 0 : ret;
+}
+
+static double bench_send(bool batched, int sock, struct sockaddr_in *to, unsigned size)
+{
+    std::vector<char> data(size, 'x');
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned sent = 0; sent < SEND_PACKETS; sent += UDP_BATCH_SIZE) {
+        if (batched) {
+            send_batch(sock, to, data.data(), size, UDP_BATCH_SIZE);
+        } else {
+            for (unsigned i = 0; i < UDP_BATCH_SIZE; ++i) {
+                sendto(sock, data.data(), size, MSG_NOSIGNAL, (struct sockaddr *)to, sizeof(*to));
+            }
+        }
+    }
+
+    return SEND_PACKETS / seconds_since(start);
+}
+
+static double bench_receive(bool batched, int sock, int sender, struct sockaddr_in *addr, unsigned size)
+{
+    std::vector<char> data(size, 'x');
+    std::vector<char> buffers(UDP_BATCH_SIZE * MAX_UDP_SIZE);
+    for (unsigned sent = 0; sent < FILL_PACKETS; sent += UDP_BATCH_SIZE) {
+        send_batch(sender, addr, data.data(), size, UDP_BATCH_SIZE);
+    }
+
+    unsigned received = 0;
+    int count;
+    auto start = std::chrono::steady_clock::now();
+    while ((count = batched ? receive_batch(sock, buffers) : receive_single(sock, buffers)) > 0) {
+        received += count;
+    }
+
+    return received / seconds_since(start);
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char **argv)
+{
+    unsigned size = argc > 1 ? atoi(argv[1]) : 100;
+    unsigned rounds = argc > 2 ? atoi(argv[2]) : 15;
+
+    struct sockaddr_in sink_addr, receiver_addr, sender_addr;
+    int sink = bound_socket(&sink_addr);
+    int receiver = bound_socket(&receiver_addr);
+    int sender = bound_socket(&sender_addr);
+
+    //rounds are interleaved so that both paths see the same machine noise
+    std::vector<double> sendto_pps, sendmmsg_pps, recvfrom_pps, recvmmsg_pps;
+    for (unsigned round = 0; round < rounds; ++round) {
+        sendto_pps.push_back(bench_send(false, sender, &sink_addr, size));
+        sendmmsg_pps.push_back(bench_send(true, sender, &sink_addr, size));
+        //the sink is never read, empty it so that its buffer doesn't change the send cost
+        close(sink);
+        sink = bound_socket(&sink_addr);
+
+        recvfrom_pps.push_back(bench_receive(false, receiver, sender, &receiver_addr, size));
+        recvmmsg_pps.push_back(bench_receive(true, receiver, sender, &receiver_addr, size));
+    }
+
+    printf("%u byte packets, batches of %u, median of %u rounds\n", size, UDP_BATCH_SIZE, rounds);
+    printf("send:    sendto   %10.0f pps   sendmmsg %10.0f pps   x%.2f\n", median(sendto_pps), median(sendmmsg_pps), median(sendmmsg_pps) / median(sendto_pps));
+    printf("receive: recvfrom %10.0f pps   recvmmsg %10.0f pps   x%.2f\n", median(recvfrom_pps), median(recvmmsg_pps), median(recvmmsg_pps) / median(recvfrom_pps));
+    return 0;
+}